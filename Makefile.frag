@@ -0,0 +1,38 @@
+
+BENCH_PHP = $(PHP_EXECUTABLE) -n -d extension_dir=$(top_builddir)/modules -d extension=yaml.$(SHLIB_SUFFIX_NAME)
+BENCH_ARGS =
+BENCH_SHAPES = wide deep literal anchors tagged multidoc
+BENCH_SIZES = 1K 64K 1M
+BENCH_CORPUS = $(top_builddir)/bench/corpus
+GENCORPUS = $(top_builddir)/bench/gencorpus
+
+$(GENCORPUS): $(top_srcdir)/bench/gencorpus.c
+	@mkdir -p $(top_builddir)/bench
+	$(CC) $(CFLAGS) -o $@ $(top_srcdir)/bench/gencorpus.c
+
+bench-corpus: $(GENCORPUS)
+	@mkdir -p $(BENCH_CORPUS)
+	@for shape in $(BENCH_SHAPES); do \
+	  for size in $(BENCH_SIZES); do \
+	    file=$(BENCH_CORPUS)/$$shape-$$size.yaml; \
+	    if test ! -f $$file -o $(GENCORPUS) -nt $$file; then \
+	      echo "generating $$file"; \
+	      $(GENCORPUS) -t $$shape -s $$size -o $$file || exit 1; \
+	    fi; \
+	  done; \
+	done
+
+RESOLVER_BENCH = $(top_builddir)/bench/resolver_bench
+RESOLVER_BENCH_ARGS =
+
+$(RESOLVER_BENCH): $(top_srcdir)/bench/resolver_bench.c $(top_srcdir)/bench/resolver_stubs.h $(top_srcdir)/resolver.c $(top_srcdir)/resolver.h
+	@mkdir -p $(top_builddir)/bench
+	$(CC) $(CFLAGS) -DPHP_YAML_RESOLVER_STANDALONE -I$(top_srcdir) -o $@ $(top_srcdir)/bench/resolver_bench.c $(top_srcdir)/resolver.c -lm
+
+bench-resolver: $(RESOLVER_BENCH)
+	$(RESOLVER_BENCH) $(RESOLVER_BENCH_ARGS)
+
+bench: all bench-corpus
+	$(BENCH_PHP) $(top_srcdir)/bench/bench.php --corpus=$(BENCH_CORPUS) $(BENCH_ARGS)
+
+.PHONY: bench bench-corpus bench-resolver
@@ -0,0 +1,199 @@
+<?php
+/**
+ * Parse/emit benchmark driver
+ *
+ * Runs yaml_parse (), yaml_parse_file () and yaml_emit () over a fixed
+ * corpus of YAML files with warm-up and repetitions and reports
+ * throughput per file. Results can additionally be written as JSON so
+ * runs of different versions can be compared mechanically.
+ *
+ * Usage:
+ *   php bench.php [--corpus=DIR] [--warmup=N] [--reps=N]
+ *                 [--only=parse,parse_file,emit] [--json=FILE]
+ *
+ * @package     php-yaml
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+extension_loaded ('yaml') || dl ('yaml.so') || exit (1);
+
+$options = array ('corpus' => dirname (__FILE__).'/../examples',
+                  'warmup' => 3,
+                  'reps'   => 20,
+                  'only'   => 'parse,parse_file,emit',
+                  'json'   => null);
+
+foreach (array_slice ($_SERVER['argv'], 1) as $arg)
+  {
+    if (!preg_match ('/^--([a-z_]+)=(.*)$/', $arg, $m) || !array_key_exists ($m[1], $options))
+      {
+        fwrite (STDERR, "unknown argument: $arg\n");
+        exit (1);
+      }
+    $options[$m[1]] = $m[2];
+  }
+
+$warmup = max (0, (int) $options['warmup']);
+$reps = max (1, (int) $options['reps']);
+$only = array_flip (explode (',', $options['only']));
+
+$files = glob (rtrim ($options['corpus'], '/').'/*.yaml');
+if (!$files)
+  {
+    fwrite (STDERR, "no *.yaml files in {$options['corpus']}\n");
+    exit (1);
+  }
+natsort ($files);
+
+/* {{{ bench_count_nodes ()
+ * Counts the scalars and collections of a parse result, which gives
+ * the number of node events libyaml produced for it. */
+function bench_count_nodes ($data, &$scalars, &$collections)
+{
+  if (is_array ($data))
+    {
+      $collections++;
+      foreach ($data as $value)
+        bench_count_nodes ($value, $scalars, $collections);
+    }
+  else
+    $scalars++;
+}
+/* }}} */
+
+/* {{{ bench_run ()
+ * Calls $func with $arg $warmup + $reps times and returns the sorted
+ * wall times of the measured repetitions in nanoseconds, and the peak
+ * memory of one call over what was in use before it in $peak.
+ *
+ * The process peak only ever grows unless memory_reset_peak_usage ()
+ * (PHP 8.2) resets it, so a call that does not raise it only gives an
+ * upper bound, the earlier peak less the usage before the call. $exact
+ * tells whether any call raised it and so gave its own peak. */
+function bench_run ($func, $arg, $warmup, $reps, &$peak, &$exact)
+{
+  $times = array ();
+  $reset = function_exists ('memory_reset_peak_usage');
+  $peak = null;
+  $exact = false;
+
+  for ($i = 0; $i < $warmup + $reps; $i++)
+    {
+      if ($reset)
+        memory_reset_peak_usage ();
+      $before = memory_get_usage ();
+      $prev_peak = memory_get_peak_usage ();
+
+      $start = microtime (true);
+      $func ($arg, -1);
+      $elapsed = (microtime (true) - $start) * 1e9;
+
+      $after_peak = memory_get_peak_usage ();
+      if ($after_peak > $prev_peak)
+        {
+          if (!$exact || $after_peak - $before > $peak)
+            $peak = $after_peak - $before;
+          $exact = true;
+        }
+      else if (!$exact && ($peak === null || $prev_peak - $before < $peak))
+        $peak = $prev_peak - $before;
+
+      if ($i >= $warmup)
+        $times[] = $elapsed;
+    }
+
+  sort ($times);
+  return $times;
+}
+/* }}} */
+
+function bench_emit ($data)
+{
+  return yaml_emit ($data);
+}
+
+$results = array ();
+
+printf ("%-24s %-10s %10s %12s %12s %12s\n",
+        'file', 'op', 'MB/s', 'events/s', 'ns/scalar', 'peak KB');
+
+foreach ($files as $file)
+  {
+    $input = file_get_contents ($file);
+    $data = @yaml_parse ($input, -1, $ndocs);
+
+    if ($data === false)
+      {
+        fwrite (STDERR, basename ($file).": does not parse, skipped\n");
+        continue;
+      }
+
+    if (function_exists ('yaml_last_stats'))
+      {
+        $stats = yaml_last_stats ();
+        $events = array_sum ($stats['events']);
+        $scalars = $stats['events']['scalar'];
+      }
+    else
+      {
+        $scalars = 0;
+        $collections = 0;
+        bench_count_nodes ($data, $scalars, $collections);
+        $collections--; /* the document list itself is not a node */
+
+        /* stream start/end, document start/end, collection start/end */
+        $events = 2 + 2 * $ndocs + 2 * $collections + $scalars;
+      }
+
+    $ops = array ();
+    if (isset ($only['parse']))
+      $ops['parse'] = array ('yaml_parse', $input, strlen ($input));
+    if (isset ($only['parse_file']))
+      $ops['parse_file'] = array ('yaml_parse_file', $file, strlen ($input));
+    if (isset ($only['emit']))
+      {
+        $output = yaml_emit ($data);
+        $ops['emit'] = array ('bench_emit', $data, strlen ($output));
+      }
+
+    foreach ($ops as $op => $spec)
+      {
+        list ($func, $arg, $bytes) = $spec;
+
+        $times = bench_run ($func, $arg, $warmup, $reps, $peak, $exact);
+        $median = $times[(int) (count ($times) / 2)];
+        $seconds = max ($median, 1) / 1e9;
+
+        $result = array ('file'       => basename ($file),
+                         'op'         => $op,
+                         'bytes'      => $bytes,
+                         'events'     => $events,
+                         'scalars'    => $scalars,
+                         'reps'       => $reps,
+                         'min_ns'     => $times[0],
+                         'median_ns'  => $median,
+                         'max_ns'     => $times[count ($times) - 1],
+                         'mb_per_s'   => $bytes / $seconds / (1024 * 1024),
+                         'events_per_s' => $events / $seconds,
+                         'ns_per_scalar' => $scalars ? $median / $scalars : 0,
+                         'peak_memory' => $peak,
+                         'peak_memory_exact' => $exact);
+        $results[] = $result;
+
+        printf ("%-24s %-10s %10.2f %12.0f %12.1f %12s\n",
+                $result['file'], $op, $result['mb_per_s'], $result['events_per_s'],
+                $result['ns_per_scalar'], ($exact ? '' : '<=').(int) ($peak / 1024));
+      }
+  }
+
+if ($options['json'] !== null)
+  {
+    $report = array ('php_version'  => PHP_VERSION,
+                     'yaml_version' => phpversion ('yaml'),
+                     'warmup'       => $warmup,
+                     'reps'         => $reps,
+                     'results'      => $results);
+
+    if (file_put_contents ($options['json'], json_encode ($report)) === false)
+      exit (1);
+  }
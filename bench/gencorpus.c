@@ -0,0 +1,452 @@
+/**
+ * Synthetic YAML corpus generator
+ *
+ * Copyright (C) 2008  Alexander Kahl
+ *
+ * This file is part of php-yaml.
+ * php-yaml is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * php-yaml is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with php-yaml.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Writes deterministic YAML documents of a given shape and approximate
+ * size to stdout or a file. The same shape, size and seed always give
+ * byte-identical output, so every benchmark run sees the same data.
+ *
+ * Usage: gencorpus [-t shape] [-s size] [-S seed] [-d depth] [-o file]
+ *
+ *   shape  wide, deep, literal, anchors, tagged or multidoc
+ *   size   target size in bytes, with an optional K, M or G suffix
+ *
+ * @package     php-yaml
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct _gen_state
+{
+  FILE *out;
+  unsigned long long size;    /* bytes written so far */
+  unsigned long long target;  /* stop once this many bytes are out */
+  unsigned long long rng;
+  unsigned int depth;
+} gen_state;
+
+typedef void (*gen_func_t) (gen_state *state);
+
+static const char *words[] = {
+  "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+  "hotel", "india", "juliett", "kilo", "lima", "mike", "november",
+  "oscar", "papa", "quebec", "romeo", "sierra", "tango", "uniform",
+  "victor", "whiskey", "xray", "yankee", "zulu"
+};
+#define WORD_COUNT (sizeof (words) / sizeof (words[0]))
+
+/* {{{ gen_rand ()
+ * xorshift64*, good enough for varied but reproducible data. */
+static unsigned long long
+gen_rand (gen_state *state)
+{
+  state->rng ^= state->rng >> 12;
+  state->rng ^= state->rng << 25;
+  state->rng ^= state->rng >> 27;
+  return state->rng * 2685821657736338717ULL;
+}
+/* }}} */
+
+static unsigned int
+gen_range (gen_state *state, unsigned int n)
+{
+  return (unsigned int) (gen_rand (state) % n);
+}
+
+static void
+gen_printf (gen_state *state, const char *format, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+static void
+gen_printf (gen_state *state, const char *format, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, format);
+  n = vfprintf (state->out, format, ap);
+  va_end (ap);
+
+  if (n > 0)
+    state->size += n;
+}
+
+static void
+gen_indent (gen_state *state, unsigned int level)
+{
+  gen_printf (state, "%*s", level * 2, "");
+}
+
+static const char *
+gen_word (gen_state *state)
+{
+  return words[gen_range (state, WORD_COUNT)];
+}
+
+/* {{{ gen_scalar ()
+ * One plain scalar of a randomly chosen implicit type. */
+static void
+gen_scalar (gen_state *state)
+{
+  switch (gen_range (state, 8))
+    {
+    case 0:
+      gen_printf (state, "%u", gen_range (state, 1000000));
+      break;
+    case 1:
+      gen_printf (state, "%u.%02u", gen_range (state, 10000), gen_range (state, 100));
+      break;
+    case 2:
+      gen_printf (state, "%s", gen_range (state, 2) ? "true" : "false");
+      break;
+    case 3:
+      gen_printf (state, "~");
+      break;
+    case 4:
+      gen_printf (state, "20%02u-%02u-%02u", gen_range (state, 30),
+                  gen_range (state, 12) + 1, gen_range (state, 28) + 1);
+      break;
+    case 5:
+      gen_printf (state, "\"%s %s\"", gen_word (state), gen_word (state));
+      break;
+    default:
+      gen_printf (state, "%s %s %s", gen_word (state), gen_word (state), gen_word (state));
+      break;
+    }
+}
+/* }}} */
+
+/* {{{ gen_wide ()
+ * One flat mapping with as many keys as fit. */
+static void
+gen_wide (gen_state *state)
+{
+  unsigned long long n = 0;
+
+  while (state->size < state->target)
+    {
+      gen_printf (state, "%s_%llu: ", gen_word (state), n++);
+      gen_scalar (state);
+      gen_printf (state, "\n");
+    }
+}
+/* }}} */
+
+/* {{{ gen_deep ()
+ * Top-level keys each holding a chain of nested mappings and
+ * sequences down to the configured depth; the last chain stops short,
+ * without a leaf, where the target size is reached. */
+static void
+gen_deep (gen_state *state)
+{
+  unsigned long long n = 0;
+  unsigned int level;
+
+  while (state->size < state->target)
+    {
+      gen_printf (state, "root_%llu:\n", n++);
+
+      for (level = 1; level <= state->depth && (level == 1 || state->size < state->target); level++)
+        {
+          gen_indent (state, level);
+          if (level % 2)
+            gen_printf (state, "%s_%u:\n", gen_word (state), level);
+          else
+            gen_printf (state, "- id: %u\n", level);
+        }
+
+      if (level <= state->depth)
+        break;
+
+      gen_indent (state, level);
+      gen_printf (state, "leaf: ");
+      gen_scalar (state);
+      gen_printf (state, "\n");
+    }
+}
+/* }}} */
+
+/* {{{ gen_literal ()
+ * A mapping of long literal block scalars, the last one cut short
+ * at the target size. */
+static void
+gen_literal (gen_state *state)
+{
+  unsigned long long n = 0;
+  unsigned int lines, line, words_per_line, w;
+
+  while (state->size < state->target)
+    {
+      gen_printf (state, "text_%llu: |\n", n++);
+      lines = 20 + gen_range (state, 200);
+
+      for (line = 0; line < lines && (line == 0 || state->size < state->target); line++)
+        {
+          gen_printf (state, "  ");
+          words_per_line = 4 + gen_range (state, 10);
+          for (w = 0; w < words_per_line; w++)
+            gen_printf (state, w ? " %s" : "%s", gen_word (state));
+          gen_printf (state, "\n");
+        }
+    }
+}
+/* }}} */
+
+/* {{{ gen_anchors ()
+ * A sequence of records where most members alias earlier anchored
+ * records, forming a dense reference graph. */
+static void
+gen_anchors (gen_state *state)
+{
+  unsigned long long n = 0;
+
+  while (state->size < state->target)
+    {
+      if (n == 0 || gen_range (state, 4) == 0)
+        {
+          gen_printf (state, "- &node%llu\n", n);
+          gen_printf (state, "  name: %s\n", gen_word (state));
+          gen_printf (state, "  weight: %u\n", gen_range (state, 1000));
+          gen_printf (state, "  tags: [%s, %s]\n", gen_word (state), gen_word (state));
+          n++;
+        }
+      else if (gen_range (state, 2))
+        gen_printf (state, "- *node%llu\n", gen_rand (state) % n);
+      else
+        {
+          gen_printf (state, "- first: *node%llu\n", gen_rand (state) % n);
+          gen_printf (state, "  second: *node%llu\n", gen_rand (state) % n);
+        }
+    }
+}
+/* }}} */
+
+/* {{{ gen_tagged ()
+ * A sequence of explicitly tagged scalars, including the standard
+ * types and application-local tags. */
+static void
+gen_tagged (gen_state *state)
+{
+  while (state->size < state->target)
+    {
+      switch (gen_range (state, 9))
+        {
+        case 0:
+          gen_printf (state, "- !!int \"%u\"\n", gen_range (state, 100000));
+          break;
+        case 1:
+          gen_printf (state, "- !!float %u.%u\n", gen_range (state, 1000), gen_range (state, 1000));
+          break;
+        case 2:
+          gen_printf (state, "- !!str %u\n", gen_range (state, 100000));
+          break;
+        case 3:
+          gen_printf (state, "- !!bool %s\n", gen_range (state, 2) ? "yes" : "no");
+          break;
+        case 4:
+          gen_printf (state, "- !!timestamp 20%02u-%02u-%02uT%02u:%02u:%02uZ\n",
+                      gen_range (state, 30), gen_range (state, 12) + 1,
+                      gen_range (state, 28) + 1, gen_range (state, 24),
+                      gen_range (state, 60), gen_range (state, 60));
+          break;
+        case 5:
+          gen_printf (state, "- !!binary R0lGODlhDAAMAIQAAP//9/X17unp5WZmZgAAAOfn515eXvPz7Y6OjuDg4J\n");
+          break;
+        case 6:
+          gen_printf (state, "- !app/money \"%u.%02u EUR\"\n", gen_range (state, 10000), gen_range (state, 100));
+          break;
+        case 7:
+          gen_printf (state, "- !app/uuid %08x-%04x-%04x-%04x-%08x%04x\n",
+                      (unsigned int) gen_rand (state), gen_range (state, 65536),
+                      gen_range (state, 65536), gen_range (state, 65536),
+                      (unsigned int) gen_rand (state), gen_range (state, 65536));
+          break;
+        default:
+          gen_printf (state, "- !!null ''\n");
+          break;
+        }
+    }
+}
+/* }}} */
+
+/* {{{ gen_multidoc ()
+ * A log of small, independent documents. */
+static void
+gen_multidoc (gen_state *state)
+{
+  static const char *levels[] = { "debug", "info", "notice", "warning", "error" };
+  unsigned long long n = 0;
+  unsigned int i, fields;
+
+  while (state->size < state->target)
+    {
+      gen_printf (state, "---\n");
+      gen_printf (state, "seq: %llu\n", n++);
+      gen_printf (state, "time: 2008-09-%02uT%02u:%02u:%02uZ\n",
+                  gen_range (state, 28) + 1, gen_range (state, 24),
+                  gen_range (state, 60), gen_range (state, 60));
+      gen_printf (state, "level: %s\n", levels[gen_range (state, 5)]);
+      gen_printf (state, "message: %s %s %s\n",
+                  gen_word (state), gen_word (state), gen_word (state));
+      gen_printf (state, "fields:\n");
+      fields = 1 + gen_range (state, 6);
+      for (i = 0; i < fields && (i == 0 || state->size < state->target); i++)
+        {
+          gen_printf (state, "  %s: ", gen_word (state));
+          gen_scalar (state);
+          gen_printf (state, "\n");
+        }
+      gen_printf (state, "...\n");
+    }
+}
+/* }}} */
+
+static const struct
+{
+  const char *name;
+  gen_func_t func;
+} shapes[] = {
+  { "wide",     gen_wide },
+  { "deep",     gen_deep },
+  { "literal",  gen_literal },
+  { "anchors",  gen_anchors },
+  { "tagged",   gen_tagged },
+  { "multidoc", gen_multidoc },
+  { NULL, NULL }
+};
+
+/* {{{ parse_size ()
+ * Parses "64", "64K", "64M" or "1G" into bytes; 0 on error. */
+static unsigned long long
+parse_size (const char *arg)
+{
+  char *end = NULL;
+  unsigned long long size = strtoull (arg, &end, 10);
+
+  switch (*end)
+    {
+    case 'G': case 'g':
+      size *= 1024;
+      /* fall through */
+    case 'M': case 'm':
+      size *= 1024;
+      /* fall through */
+    case 'K': case 'k':
+      size *= 1024;
+      end++;
+      break;
+    default:
+      break;
+    }
+
+  return *end ? 0 : size;
+}
+/* }}} */
+
+static void
+usage (const char *prog)
+{
+  int i;
+
+  fprintf (stderr, "usage: %s [-t shape] [-s size] [-S seed] [-d depth] [-o file]\n", prog);
+  fprintf (stderr, "shapes:");
+  for (i = 0; shapes[i].name; i++)
+    fprintf (stderr, " %s", shapes[i].name);
+  fprintf (stderr, "\n");
+  exit (2);
+}
+
+int
+main (int argc, char **argv)
+{
+  gen_state state = {0};
+  const char *shape = "wide";
+  const char *output = NULL;
+  gen_func_t func = NULL;
+  int opt, i;
+
+  state.target = 1024;
+  state.rng = 0x5eed;
+  state.depth = 32;
+
+  while ((opt = getopt (argc, argv, "t:s:S:d:o:")) != -1)
+    {
+      switch (opt)
+        {
+        case 't':
+          shape = optarg;
+          break;
+        case 's':
+          if ((state.target = parse_size (optarg)) == 0)
+            usage (argv[0]);
+          break;
+        case 'S':
+          state.rng = strtoull (optarg, NULL, 0);
+          if (state.rng == 0)
+            usage (argv[0]);
+          break;
+        case 'd':
+          state.depth = (unsigned int) atoi (optarg);
+          if (state.depth == 0)
+            usage (argv[0]);
+          break;
+        case 'o':
+          output = optarg;
+          break;
+        default:
+          usage (argv[0]);
+        }
+    }
+
+  for (i = 0; shapes[i].name; i++)
+    if (!strcmp (shapes[i].name, shape))
+      func = shapes[i].func;
+  if (func == NULL)
+    usage (argv[0]);
+
+  if (output == NULL)
+    state.out = stdout;
+  else if ((state.out = fopen (output, "wb")) == NULL)
+    {
+      perror (output);
+      return 1;
+    }
+
+  func (&state);
+
+  if (fclose (state.out) != 0)
+    {
+      perror (output ? output : "stdout");
+      return 1;
+    }
+
+  return 0;
+}
+
+/*
+ * Local variables:
+ * tab-width: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
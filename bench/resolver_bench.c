@@ -0,0 +1,404 @@
+/**
+ * Micro-benchmark for the scalar resolvers
+ *
+ * This file is part of php-yaml.
+ * php-yaml is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * php-yaml is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with php-yaml.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Links resolver.c against resolver_stubs.h and times
+ * php_yaml_scalar_is_numeric (), php_yaml_scalar_is_timestamp () and
+ * php_yaml_eval_sexagesimal_l/d () over a large array of representative
+ * scalars. Before timing anything it checks the resolvers against a
+ * table of known answers and exits non-zero on a mismatch, so it doubles
+ * as a guard for resolver optimizations.
+ *
+ * Usage: resolver_bench [-n scalars] [-r rounds]
+ *
+ * Reports ns/op and, where perf events are available (Linux), branch
+ * misses per op and the branch miss rate.
+ *
+ * @package     php-yaml
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "bench/resolver_stubs.h"
+#include "resolver.h"
+
+/* {{{ known answers */
+static const struct
+{
+  const char *value;
+  int type;
+  long lval;
+  double dval;
+} checks[] = {
+  { "0",              Y_SCALAR_IS_INT | Y_SCALAR_IS_ZERO,        0,      0.0 },
+  { "12345",          Y_SCALAR_IS_INT | Y_SCALAR_IS_DECIMAL,     12345,  0.0 },
+  { "-12_345",        Y_SCALAR_IS_INT | Y_SCALAR_IS_DECIMAL,     -12345, 0.0 },
+  { "1,000",          Y_SCALAR_IS_INT | Y_SCALAR_IS_DECIMAL,     1000,   0.0 },
+  { "0b1010",         Y_SCALAR_IS_INT | Y_SCALAR_IS_BINARY,      10,     0.0 },
+  { "0x1F",           Y_SCALAR_IS_INT | Y_SCALAR_IS_HEXADECIMAL, 31,     0.0 },
+  { "017",            Y_SCALAR_IS_INT | Y_SCALAR_IS_OCTAL,       15,     0.0 },
+  { "190:20:30",      Y_SCALAR_IS_INT | Y_SCALAR_IS_SEXAGECIMAL, 685230, 0.0 },
+  { "1.5",            Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_DECIMAL,   0,      1.5 },
+  { ".5",             Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_DECIMAL,   0,      0.5 },
+  { "6.8523015e+5",   Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_DECIMAL,   0,      685230.15 },
+  { "190:20:30.15",   Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_SEXAGECIMAL, 0,    685230.15 },
+  { "-.inf",          Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_INFINITY_N, 0,     0.0 },
+  { ".NaN",           Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_NAN,       0,      0.0 },
+  { "",               Y_SCALAR_IS_NOT_NUMERIC,                   0,      0.0 },
+  { "12ab",           Y_SCALAR_IS_NOT_NUMERIC,                   0,      0.0 },
+  { "0x",             Y_SCALAR_IS_NOT_NUMERIC,                   0,      0.0 },
+  { "hello world",    Y_SCALAR_IS_NOT_NUMERIC,                   0,      0.0 },
+  { NULL, 0, 0, 0.0 }
+};
+
+static const struct
+{
+  const char *value;
+  int is_timestamp;
+} ts_checks[] = {
+  { "2001-12-14",                  1 },
+  { "2001-12-14t21:59:43.10-05:00", 1 },
+  { "2001-12-14 21:59:43.10 -5",   1 },
+  { "2002-12-14T21:59:43Z",        1 },
+  { "2001-1-1",                    0 },
+  { "20011214",                    0 },
+  { "12:30:00",                    0 },
+  { "hello",                       0 },
+  { NULL, 0 }
+};
+/* }}} */
+
+/* {{{ representative scalars, roughly the mix of a config file */
+static const char *samples[] = {
+  "42", "-17", "3.14159", "1_000_000", "0x7FFF", "0755", "0b1010",
+  "1:30:00", "6.02e+23", ".inf", "~", "true", "example.com",
+  "2008-09-22", "2008-09-22T20:55:55Z", "Lorem ipsum dolor",
+  "user@example.org", "v1.2.3", "/var/lib/yaml", "-", "null", "en_US"
+};
+#define SAMPLE_COUNT (sizeof (samples) / sizeof (samples[0]))
+/* }}} */
+
+/* {{{ branch counters */
+typedef struct _counters
+{
+  int branches;
+  int misses;
+} counters;
+
+static void
+counters_open (counters *c)
+{
+  c->branches = c->misses = -1;
+#ifdef __linux__
+  {
+    struct perf_event_attr attr;
+
+    memset (&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+    c->branches = (int) syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    c->misses = (int) syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+    if (c->branches < 0 || c->misses < 0)
+      {
+        if (c->branches >= 0)
+          close (c->branches);
+        if (c->misses >= 0)
+          close (c->misses);
+        c->branches = c->misses = -1;
+      }
+  }
+#endif
+}
+
+static void
+counters_start (counters *c)
+{
+#ifdef __linux__
+  if (c->branches >= 0)
+    {
+      ioctl (c->branches, PERF_EVENT_IOC_RESET, 0);
+      ioctl (c->misses, PERF_EVENT_IOC_RESET, 0);
+      ioctl (c->branches, PERF_EVENT_IOC_ENABLE, 0);
+      ioctl (c->misses, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+/* returns 0 if the counters are not available */
+static int
+counters_stop (counters *c, long long *branches, long long *misses)
+{
+#ifdef __linux__
+  if (c->branches >= 0)
+    {
+      ioctl (c->branches, PERF_EVENT_IOC_DISABLE, 0);
+      ioctl (c->misses, PERF_EVENT_IOC_DISABLE, 0);
+      if (read (c->branches, branches, sizeof (*branches)) == sizeof (*branches)
+          && read (c->misses, misses, sizeof (*misses)) == sizeof (*misses))
+        return 1;
+    }
+#endif
+  return 0;
+}
+/* }}} */
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static volatile double sink;
+
+/* {{{ run_check ()
+ * Compares the resolvers with the known answers. */
+static int
+run_check (void)
+{
+  int i, type, failures = 0;
+  long lval;
+  double dval;
+
+  for (i = 0; checks[i].value; i++)
+    {
+      lval = 0;
+      dval = 0.0;
+      type = php_yaml_scalar_is_numeric (checks[i].value, strlen (checks[i].value),
+                                         &lval, &dval, NULL);
+      if (type != checks[i].type
+          || ((type & Y_SCALAR_IS_INT) && lval != checks[i].lval)
+          || ((type & Y_SCALAR_IS_FLOAT)
+              && (type & Y_SCALAR_FORMAT_MASK) < Y_SCALAR_IS_INFINITY_P
+              && (dval - checks[i].dval > 1e-9 || checks[i].dval - dval > 1e-9)))
+        {
+          fprintf (stderr, "is_numeric (\"%s\"): got %#x %ld %g, expected %#x %ld %g\n",
+                   checks[i].value, type, lval, dval,
+                   checks[i].type, checks[i].lval, checks[i].dval);
+          failures++;
+        }
+      if (type != Y_SCALAR_IS_NOT_NUMERIC
+          && !php_yaml_scalar_may_be_numeric (checks[i].value, strlen (checks[i].value)))
+        {
+          fprintf (stderr, "may_be_numeric (\"%s\"): rules out a number\n",
+                   checks[i].value);
+          failures++;
+        }
+    }
+
+  for (i = 0; ts_checks[i].value; i++)
+    {
+      type = php_yaml_scalar_is_timestamp (ts_checks[i].value, strlen (ts_checks[i].value));
+      if (type != ts_checks[i].is_timestamp)
+        {
+          fprintf (stderr, "is_timestamp (\"%s\"): got %d, expected %d\n",
+                   ts_checks[i].value, type, ts_checks[i].is_timestamp);
+          failures++;
+        }
+    }
+
+  return failures;
+}
+/* }}} */
+
+typedef double (*bench_func_t) (char **values, size_t *lengths, size_t n);
+
+static double
+bench_is_numeric (char **values, size_t *lengths, size_t n)
+{
+  double acc = 0.0;
+  long lval;
+  double dval;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      lval = 0;
+      dval = 0.0;
+      acc += php_yaml_scalar_is_numeric (values[i], lengths[i], &lval, &dval, NULL);
+      acc += (double) lval + dval;
+    }
+  return acc;
+}
+
+static double
+bench_is_timestamp (char **values, size_t *lengths, size_t n)
+{
+  double acc = 0.0;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    acc += php_yaml_scalar_is_timestamp (values[i], lengths[i]);
+  return acc;
+}
+
+static double
+bench_sexagesimal_l (char **values, size_t *lengths, size_t n)
+{
+  double acc = 0.0;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    acc += php_yaml_eval_sexagesimal_l (0, values[i], values[i] + lengths[i]);
+  return acc;
+}
+
+static double
+bench_sexagesimal_d (char **values, size_t *lengths, size_t n)
+{
+  double acc = 0.0;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    acc += php_yaml_eval_sexagesimal_d (0.0, values[i], values[i] + lengths[i]);
+  return acc;
+}
+
+/* {{{ run_bench () */
+static void
+run_bench (const char *name, bench_func_t func, char **values, size_t *lengths,
+           size_t n, int rounds, counters *c)
+{
+  long long branches = 0, misses = 0;
+  double start, best = 0.0, elapsed;
+  int r, have_counters = 0;
+
+  /* warm-up */
+  sink += func (values, lengths, n);
+
+  for (r = 0; r < rounds; r++)
+    {
+      counters_start (c);
+      start = now ();
+      sink += func (values, lengths, n);
+      elapsed = now () - start;
+      have_counters = counters_stop (c, &branches, &misses);
+
+      if (r == 0 || elapsed < best)
+        best = elapsed;
+    }
+
+  if (have_counters)
+    printf ("%-24s %10.2f %12.4f %10.2f%%\n", name, best / n,
+            (double) misses / n, branches ? 100.0 * misses / branches : 0.0);
+  else
+    printf ("%-24s %10.2f %12s %11s\n", name, best / n, "n/a", "n/a");
+}
+/* }}} */
+
+int
+main (int argc, char **argv)
+{
+  size_t n = 1000000, i;
+  int rounds = 5, opt;
+  char **values, **sexa_l, **sexa_d;
+  size_t *lengths, *sexa_l_len, *sexa_d_len;
+  unsigned int seed = 1;
+  counters c;
+
+  while ((opt = getopt (argc, argv, "n:r:")) != -1)
+    {
+      switch (opt)
+        {
+        case 'n':
+          n = (size_t) strtoul (optarg, NULL, 10);
+          break;
+        case 'r':
+          rounds = atoi (optarg);
+          break;
+        default:
+          fprintf (stderr, "usage: %s [-n scalars] [-r rounds]\n", argv[0]);
+          return 2;
+        }
+    }
+  if (n == 0 || rounds <= 0)
+    {
+      fprintf (stderr, "usage: %s [-n scalars] [-r rounds]\n", argv[0]);
+      return 2;
+    }
+
+  if (run_check () != 0)
+    return 1;
+
+  values = malloc (n * sizeof (char *));
+  lengths = malloc (n * sizeof (size_t));
+  sexa_l = malloc (n * sizeof (char *));
+  sexa_l_len = malloc (n * sizeof (size_t));
+  sexa_d = malloc (n * sizeof (char *));
+  sexa_d_len = malloc (n * sizeof (size_t));
+  if (!values || !lengths || !sexa_l || !sexa_l_len || !sexa_d || !sexa_d_len)
+    {
+      perror ("malloc");
+      return 1;
+    }
+
+  /* a fixed pseudo-random order defeats a trivially learned pattern */
+  for (i = 0; i < n; i++)
+    {
+      char buf[32];
+
+      seed = seed * 1103515245 + 12345;
+      values[i] = strdup (samples[(seed >> 16) % SAMPLE_COUNT]);
+      lengths[i] = strlen (values[i]);
+
+      /* sexagesimal input as php_yaml_scalar_is_numeric () leaves it */
+      snprintf (buf, sizeof (buf), "%u:%02u:%02u", (seed >> 8) % 200,
+                (seed >> 4) % 60, seed % 60);
+      sexa_l[i] = strdup (buf);
+      sexa_l_len[i] = strlen (buf);
+      snprintf (buf, sizeof (buf), "%u:%02u:%02u.%02u", (seed >> 8) % 200,
+                (seed >> 4) % 60, seed % 60, (seed >> 12) % 100);
+      sexa_d[i] = strdup (buf);
+      sexa_d_len[i] = strlen (buf);
+    }
+
+  counters_open (&c);
+
+  printf ("%-24s %10s %12s %11s\n", "function", "ns/op", "misses/op", "miss rate");
+  run_bench ("scalar_is_numeric", bench_is_numeric, values, lengths, n, rounds, &c);
+  run_bench ("scalar_is_timestamp", bench_is_timestamp, values, lengths, n, rounds, &c);
+  run_bench ("eval_sexagesimal_l", bench_sexagesimal_l, sexa_l, sexa_l_len, n, rounds, &c);
+  run_bench ("eval_sexagesimal_d", bench_sexagesimal_d, sexa_d, sexa_d_len, n, rounds, &c);
+
+  return 0;
+}
+
+/*
+ * Local variables:
+ * tab-width: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,19 @@
+/*
+ * Stand-ins for the few Zend/PHP symbols resolver.c needs, so that it
+ * can be built outside the extension (see resolver_bench.c).
+ */
+
+#ifndef RESOLVER_STUBS_H
+#define RESOLVER_STUBS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define emalloc(size)   malloc(size)
+#define efree(ptr)      free(ptr)
+
+#define php_get_inf()   HUGE_VAL
+#define php_get_nan()   NAN
+
+#endif
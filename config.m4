@@ -4,6 +4,9 @@ dnl config.m4 for extension yaml
 PHP_ARG_WITH(yaml, [whether to enable LibYAML support],
 [  --with-yaml[[=DIR]]       Include LibYAML support], yes, yes)
 
+PHP_ARG_ENABLE(yaml-usdt, [whether to enable USDT probes for yaml],
+[  --enable-yaml-usdt        yaml: Compile in USDT probes (needs sys/sdt.h)], no, no)
+
 if test "$PHP_YAML" != "no"; then
   if test -r "$PHP_YAML/include/yaml.h"; then
     YAML_DIR="$PHP_YAML"
@@ -38,6 +41,24 @@ if test "$PHP_YAML" != "no"; then
     -L$YAML_DIR/lib
   ])
 
-  PHP_NEW_EXTENSION(yaml, yaml.c emitter.c parser.c, $ext_shared)
+  dnl monotonic clock for yaml_last_stats() timings
+  PHP_CHECK_FUNC(clock_gettime, rt)
+
+  if test "$PHP_YAML_USDT" != "no"; then
+    AC_CHECK_HEADER([sys/sdt.h], [
+      AC_DEFINE(HAVE_YAML_USDT, 1, [Whether to compile in USDT probes])
+    ],[
+      AC_MSG_ERROR([sys/sdt.h not found, install the SystemTap SDT headers])
+    ])
+  fi
+
+  dnl worker threads for yaml.parse_threads
+  AC_CHECK_HEADER([pthread.h], [
+    PHP_ADD_LIBRARY(pthread, 1, YAML_SHARED_LIBADD)
+    AC_DEFINE(HAVE_YAML_THREADS, 1, [Whether worker threads are available])
+  ])
+
+  PHP_NEW_EXTENSION(yaml, yaml.c emitter.c parser.c resolver.c parallel.c push_parser.c fast_scanner.c lazy.c, $ext_shared)
   PHP_SUBST(YAML_SHARED_LIBADD)
+  PHP_ADD_MAKEFILE_FRAGMENT
 fi
@@ -38,8 +38,15 @@
 #include "php_yaml.h"
 #include "zval_refcount.h" /* for PHP < 5.3 */
 #include "emitter.h"
+#include "parser.h"
+#include "parallel.h"
+#include "probes.h"
 
 /* {{{ internal function prototypes */
+static int
+php_yaml_emit_event (yaml_emitter_t *emitter, php_yaml_chunk *chunk,
+                     yaml_event_t *event TSRMLS_DC);
+
 static void
 php_yaml_print_emitter_error (yaml_emitter_t *emitter TSRMLS_DC);
 
@@ -50,8 +57,54 @@ static int
 php_yaml_determine_array_depth (HashTable *table TSRMLS_DC);
      
 static int
-php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
-                       yaml_emitter_t *emitter TSRMLS_DC);
+php_yaml_mangle_key (HashTable *table, HashPosition *pointer,
+                     yaml_emitter_t *emitter, php_yaml_chunk *chunk TSRMLS_DC);
+
+static int
+php_yaml_snapshot_chunk (HashTable *table, HashPosition *pointer, int is_hash,
+                         size_t index, size_t nchunks, long encoding,
+                         yaml_emitter_t *emitter, php_yaml_chunk *chunk TSRMLS_DC);
+
+static int
+php_yaml_mangle_queue (zval *data, yaml_emitter_t *emitter,
+                       php_yaml_chunk *chunk TSRMLS_DC);
+/* }}} */
+
+/* {{{ php_yaml_emit_event ()
+ * yaml_emitter_emit () plus statistics. With chunk set, the event is
+ * added to chunk instead, to be emitted on a worker. */
+static int
+php_yaml_emit_event (yaml_emitter_t *emitter, php_yaml_chunk *chunk,
+                     yaml_event_t *event TSRMLS_DC)
+{
+  yaml_event_type_t type = event->type;
+  double start = 0.0;
+  int ok;
+
+  if (chunk != NULL)
+    {
+      if (!php_yaml_chunk_add (chunk, event))
+        {
+          emitter->error = YAML_MEMORY_ERROR;
+          return 0;
+        }
+      YAML_G (stats).events[type]++;
+      return 1;
+    }
+
+  if (YAML_G (collect_timings))
+    start = php_yaml_clock ();
+
+  ok = yaml_emitter_emit (emitter, event);
+
+  if (YAML_G (collect_timings))
+    YAML_G (stats).time_libyaml += php_yaml_clock () - start;
+
+  if (ok)
+    YAML_G (stats).events[type]++;
+
+  return ok;
+}
 /* }}} */
 
 static int
@@ -113,6 +166,8 @@ php_yaml_determine_array_depth (HashTable *table TSRMLS_DC)
 static void
 php_yaml_print_emitter_error (yaml_emitter_t *emitter TSRMLS_DC)
 {
+  YAML_PROBE2 (emitter__error, (int)emitter->error, emitter->problem);
+
   switch (emitter->error) /* TODO: Throw exceptions if configured */
     {
     case YAML_MEMORY_ERROR:
@@ -139,54 +194,275 @@ php_yaml_print_emitter_error (yaml_emitter_t *emitter TSRMLS_DC)
 }
 /* }}} */
 
+/* {{{ php_yaml_write_parallel ()
+ * php_yaml_write_impl () for a large top-level array: the entries are
+ * snapshot into chunks of events here and rendered by yaml.emit_threads
+ * workers, a batch of chunks at a time, while the next batch is being
+ * snapshot. The output goes straight to the writer of emitter. */
+static int
+php_yaml_write_parallel (yaml_emitter_t *emitter, zval *data, long encoding TSRMLS_DC)
+{
+  HashTable *table = Z_ARRVAL_P (data);
+  int is_hash = php_yaml_determine_array_type (table TSRMLS_CC) == Y_ARRAY_IS_HASH;
+  size_t total = zend_hash_num_elements (table);
+  size_t nchunks = (total + Y_PARALLEL_CHUNK_SIZE - 1) / Y_PARALLEL_CHUNK_SIZE;
+  int nthreads = (int)MIN (YAML_G (emit_threads), Y_PARALLEL_MAX_THREADS);
+  size_t batch = 2 * (size_t)nthreads;
+  size_t first, ncurrent, nnext, i;
+  php_yaml_chunk *chunks, *current, *next, *tmp;
+  php_yaml_pool *pool;
+  HashPosition pointer;
+  int ok = 1;
+
+  if ((chunks = calloc (2 * batch, sizeof (php_yaml_chunk))) == NULL)
+    {
+      emitter->error = YAML_MEMORY_ERROR;
+      php_yaml_print_emitter_error (emitter TSRMLS_CC);
+      return FAILURE;
+    }
+  for (i = 0; i < 2 * batch; i++)
+    chunks[i].config = emitter;
+  current = chunks;
+  next = chunks + batch;
+
+  zend_hash_internal_pointer_reset_ex (table, &pointer);
+
+  ncurrent = MIN (batch, nchunks);
+  for (i = 0; i < ncurrent && ok; i++)
+    ok = php_yaml_snapshot_chunk (table, &pointer, is_hash, i, nchunks, encoding,
+                                  emitter, &current[i] TSRMLS_CC) == SUCCESS;
+
+  for (first = 0; first < nchunks && ok; first += ncurrent)
+    {
+      ncurrent = MIN (batch, nchunks - first);
+      if ((pool = php_yaml_pool_start (php_yaml_emit_chunk, current, sizeof (php_yaml_chunk),
+                                       ncurrent, nthreads, 0)) == NULL)
+        {
+          emitter->error = YAML_MEMORY_ERROR;
+          ok = 0;
+          break;
+        }
+
+      nnext = MIN (batch, nchunks - first - ncurrent);
+      for (i = 0; i < nnext && ok; i++)
+        ok = php_yaml_snapshot_chunk (table, &pointer, is_hash, first + ncurrent + i, nchunks,
+                                      encoding, emitter, &next[i] TSRMLS_CC) == SUCCESS;
+
+      for (i = 0; i < ncurrent; i++)
+        {
+          php_yaml_chunk *chunk = (php_yaml_chunk *)php_yaml_pool_wait (pool, i);
+
+          if (ok && chunk->error != YAML_NO_ERROR)
+            {
+              emitter->error = chunk->error;
+              emitter->problem = chunk->problem;
+              ok = 0;
+            }
+          if (ok && !emitter->write_handler (emitter->write_handler_data,
+                                             chunk->output, chunk->length))
+            {
+              emitter->error = YAML_WRITER_ERROR;
+              emitter->problem = "write error";
+              ok = 0;
+            }
+          if (YAML_G (collect_timings))
+            YAML_G (stats).time_libyaml += chunk->time;
+
+          php_yaml_chunk_free (chunk);
+          php_yaml_pool_release (pool, i);
+        }
+      php_yaml_pool_finish (pool);
+
+      tmp = current;
+      current = next;
+      next = tmp;
+    }
+
+  for (i = 0; i < 2 * batch; i++)
+    php_yaml_chunk_free (&chunks[i]);
+  free (chunks);
+
+  if (!ok)
+    {
+      php_yaml_print_emitter_error (emitter TSRMLS_CC);
+      return FAILURE;
+    }
+
+  /* the events framing each chunk are not counted, those of the one
+     stream they make up are */
+  YAML_G (stats).events[YAML_STREAM_START_EVENT]++;
+  YAML_G (stats).events[YAML_DOCUMENT_START_EVENT]++;
+  YAML_G (stats).events[is_hash ? YAML_MAPPING_START_EVENT : YAML_SEQUENCE_START_EVENT]++;
+  YAML_G (stats).events[is_hash ? YAML_MAPPING_END_EVENT : YAML_SEQUENCE_END_EVENT]++;
+  YAML_G (stats).events[YAML_DOCUMENT_END_EVENT]++;
+  YAML_G (stats).events[YAML_STREAM_END_EVENT]++;
+
+  return SUCCESS;
+}
+/* }}} */
+
 /* {{{ php_yaml_write_impl () */
 int
 php_yaml_write_impl (yaml_emitter_t *emitter, zval *data, long encoding TSRMLS_DC)
 {
-  yaml_parser_t parser;
   yaml_event_t event;
-    
+
+  /* chunks are glued together as they are, so no byte order marks */
+  if (YAML_G (emit_threads) > 1 && !YAML_G (nomnom)
+      && (encoding == YAML_ANY_ENCODING || encoding == YAML_UTF8_ENCODING)
+      && Z_TYPE_P (data) == IS_ARRAY
+      && zend_hash_num_elements (Z_ARRVAL_P (data)) >= 2 * Y_PARALLEL_CHUNK_SIZE)
+    return php_yaml_write_parallel (emitter, data, encoding TSRMLS_CC);
+
   if (!yaml_stream_start_event_initialize (&event, (int) encoding))
     goto emitter_error;
-  if (!yaml_emitter_emit (emitter, &event))
+  if (!php_yaml_emit_event (emitter, NULL, &event TSRMLS_CC))
     goto emitter_error;
     
   if (!yaml_document_start_event_initialize (&event,
                                              NULL, NULL, NULL, 0))
     goto emitter_error;
-  if (!yaml_emitter_emit (emitter, &event))
+  if (!php_yaml_emit_event (emitter, NULL, &event TSRMLS_CC))
     goto emitter_error;
     
-  yaml_parser_initialize (&parser);
-    
-  if (php_yaml_mangle_queue (data, &parser, emitter TSRMLS_CC) == FAILURE)
+  if (php_yaml_mangle_queue (data, emitter, NULL TSRMLS_CC) == FAILURE)
     goto emitter_error;
 
   if (!yaml_document_end_event_initialize (&event, 0))
     goto emitter_error;
-  if (!yaml_emitter_emit (emitter, &event))
+  if (!php_yaml_emit_event (emitter, NULL, &event TSRMLS_CC))
     goto emitter_error;
     
   if (!yaml_stream_end_event_initialize (&event))
     goto emitter_error;
-  if (!yaml_emitter_emit (emitter, &event))
+  if (!php_yaml_emit_event (emitter, NULL, &event TSRMLS_CC))
     goto emitter_error;
 
   yaml_event_delete (&event);
-  yaml_parser_delete (&parser);
   return SUCCESS;
 
  emitter_error:
   php_yaml_print_emitter_error (emitter TSRMLS_CC);
   yaml_event_delete (&event);
-  yaml_parser_delete (&parser);
   return FAILURE;
 }
 /* }}} */
 
+/* {{{ php_yaml_mangle_key ()
+ * Emits the key of the entry of table at pointer. */
 static int
-php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
-                       yaml_emitter_t *emitter TSRMLS_DC)
+php_yaml_mangle_key (HashTable *table, HashPosition *pointer,
+                     yaml_emitter_t *emitter, php_yaml_chunk *chunk TSRMLS_DC)
+{
+  yaml_event_t event;
+  char *key;
+  unsigned int key_len;
+  unsigned long index;
+
+  if (zend_hash_get_current_key_ex (table,
+                                    &key, &key_len, &index, 0, pointer)
+      == HASH_KEY_IS_STRING)
+    {
+      if (!yaml_scalar_event_initialize (&event, NULL,
+                                         (yaml_char_t *)YAML_STR_TAG,
+                                         (yaml_char_t *)key, key_len - 1, 1, 1,
+                                         YAML_PLAIN_SCALAR_STYLE))
+        return FAILURE;
+    }
+  else
+    {
+      key_len = index ? (int)(log (index) / log (10)) + 2 : 2;
+      key = (char *)emalloc (key_len);
+      snprintf (key, key_len, "%ld", index);
+
+      if (!yaml_scalar_event_initialize (&event, NULL,
+                                         (yaml_char_t *)YAML_INT_TAG,
+                                         (yaml_char_t *)key, key_len - 1, 1, 1,
+                                         YAML_PLAIN_SCALAR_STYLE))
+        {
+          efree (key);
+          return FAILURE;
+        }
+
+      efree (key);
+    }
+
+  if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
+    return FAILURE;
+
+  return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_snapshot_chunk ()
+ * Fills chunk number index of nchunks with the events of the next
+ * Y_PARALLEL_CHUNK_SIZE entries of table from pointer on, framed so
+ * that the chunk is a stream of its own. */
+static int
+php_yaml_snapshot_chunk (HashTable *table, HashPosition *pointer, int is_hash,
+                         size_t index, size_t nchunks, long encoding,
+                         yaml_emitter_t *emitter, php_yaml_chunk *chunk TSRMLS_DC)
+{
+  yaml_event_t event;
+  zval **hash_data;
+  size_t i;
+
+  if (!yaml_stream_start_event_initialize (&event, (int) encoding)
+      || !php_yaml_chunk_add (chunk, &event))
+    goto memory_error;
+  if (!yaml_document_start_event_initialize (&event, NULL, NULL, NULL, index > 0)
+      || !php_yaml_chunk_add (chunk, &event))
+    goto memory_error;
+  if (is_hash)
+    {
+      if (!yaml_mapping_start_event_initialize (&event, NULL, (yaml_char_t *)YAML_MAP_TAG,
+                                                1, YAML_BLOCK_MAPPING_STYLE))
+        goto memory_error;
+    }
+  else if (!yaml_sequence_start_event_initialize (&event, NULL, (yaml_char_t *)YAML_SEQ_TAG,
+                                                  1, YAML_BLOCK_SEQUENCE_STYLE))
+    goto memory_error;
+  if (!php_yaml_chunk_add (chunk, &event))
+    goto memory_error;
+
+  for (i = 0;
+       i < Y_PARALLEL_CHUNK_SIZE
+         && zend_hash_get_current_data_ex (table, (void **)&hash_data, pointer) == SUCCESS;
+       i++, zend_hash_move_forward_ex (table, pointer))
+    {
+      if (is_hash && php_yaml_mangle_key (table, pointer, emitter, chunk TSRMLS_CC) == FAILURE)
+        return FAILURE;
+      if (php_yaml_mangle_queue (*hash_data, emitter, chunk TSRMLS_CC) == FAILURE)
+        return FAILURE;
+    }
+
+  if (is_hash)
+    {
+      if (!yaml_mapping_end_event_initialize (&event))
+        goto memory_error;
+    }
+  else if (!yaml_sequence_end_event_initialize (&event))
+    goto memory_error;
+  if (!php_yaml_chunk_add (chunk, &event))
+    goto memory_error;
+  if (!yaml_document_end_event_initialize (&event, index + 1 < nchunks)
+      || !php_yaml_chunk_add (chunk, &event))
+    goto memory_error;
+  if (!yaml_stream_end_event_initialize (&event)
+      || !php_yaml_chunk_add (chunk, &event))
+    goto memory_error;
+
+  return SUCCESS;
+
+ memory_error:
+  emitter->error = YAML_MEMORY_ERROR;
+  return FAILURE;
+}
+/* }}} */
+
+static int
+php_yaml_mangle_queue (zval *data, yaml_emitter_t *emitter,
+                       php_yaml_chunk *chunk TSRMLS_DC)
 {
   yaml_event_t event;
 
@@ -195,9 +471,6 @@ php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
       HashTable *table = Z_ARRVAL_P (data);
       HashPosition pointer;
       zval **hash_data;
-      char *key;
-      unsigned int key_len;
-      unsigned long index;
       yaml_mapping_style_t style;
 
       if (php_yaml_determine_array_type (table TSRMLS_CC) == Y_ARRAY_IS_HASH)
@@ -217,52 +490,24 @@ php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
                                                     1, style))
             return FAILURE;
 
-          if (!yaml_emitter_emit (emitter, &event))
+          if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
             return FAILURE;
 
           for (zend_hash_internal_pointer_reset_ex (table, &pointer);
                zend_hash_get_current_data_ex (table, (void**) &hash_data, &pointer) == SUCCESS;
                zend_hash_move_forward_ex (table, &pointer))
             {
-              if (zend_hash_get_current_key_ex (table,
-                                                &key, &key_len, &index, 0, &pointer)
-                  == HASH_KEY_IS_STRING)
-                {
-                  if (!yaml_scalar_event_initialize (&event, NULL,
-                                                     (yaml_char_t *)YAML_STR_TAG,
-                                                     (yaml_char_t *)key, key_len - 1, 1, 1,
-                                                     YAML_PLAIN_SCALAR_STYLE))
-                    return FAILURE;
-                }
-              else
-                {
-                  key_len = index ? (int)(log (index) / log (10)) + 2 : 2;
-                  key = (char *)emalloc (key_len);
-                  snprintf (key, key_len, "%ld", index);
-
-                  if (!yaml_scalar_event_initialize (&event, NULL,
-                                                     (yaml_char_t *)YAML_INT_TAG,
-                                                     (yaml_char_t *)key, key_len - 1, 1, 1,
-                                                     YAML_PLAIN_SCALAR_STYLE))
-                    {
-                      efree (key);
-                      return FAILURE;
-                    }
-
-                  efree (key);
-                }
-
-              if (!yaml_emitter_emit (emitter, &event))
+              if (php_yaml_mangle_key (table, &pointer, emitter, chunk TSRMLS_CC) == FAILURE)
                 return FAILURE;
                    
-              if (php_yaml_mangle_queue (*hash_data, parser, emitter TSRMLS_CC) == FAILURE)
+              if (php_yaml_mangle_queue (*hash_data, emitter, chunk TSRMLS_CC) == FAILURE)
                 return FAILURE;
             }
 
           if (!yaml_mapping_end_event_initialize (&event))
             return FAILURE;
             
-          if (!yaml_emitter_emit (emitter, &event))
+          if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
             return FAILURE;
         }
       else /* Y_ARRAY_IS_LIST */
@@ -282,21 +527,21 @@ php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
                                                      1, style))
             return FAILURE;
 
-          if (!yaml_emitter_emit (emitter, &event))
+          if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
             return FAILURE;
 
           for (zend_hash_internal_pointer_reset_ex (table, &pointer);
                zend_hash_get_current_data_ex (table, (void**) &hash_data, &pointer) == SUCCESS;
                zend_hash_move_forward_ex (table, &pointer))
             {                    
-              if (php_yaml_mangle_queue (*hash_data, parser, emitter TSRMLS_CC) == FAILURE)
+              if (php_yaml_mangle_queue (*hash_data, emitter, chunk TSRMLS_CC) == FAILURE)
                 return FAILURE;                            
             }
                     
           if (!yaml_sequence_end_event_initialize (&event))
             return FAILURE;
             
-          if (!yaml_emitter_emit (emitter, &event))
+          if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
             return FAILURE;
         }
   
@@ -323,8 +568,9 @@ php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
                                          YAML_PLAIN_SCALAR_STYLE))
         return FAILURE;
 
-      if (!yaml_emitter_emit (emitter, &event))
+      if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
         return FAILURE;
+      YAML_G (stats).scalars[Y_STATS_STRING]++;
       break;
 
     case IS_NULL:
@@ -334,8 +580,9 @@ php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
                                          YAML_PLAIN_SCALAR_STYLE))
         return FAILURE;
 
-      if (!yaml_emitter_emit (emitter, &event))
+      if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
         return FAILURE;
+      YAML_G (stats).scalars[Y_STATS_NULL]++;
       break;
             
     case IS_DOUBLE:
@@ -355,13 +602,14 @@ php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
           return FAILURE;
         }
 
-      if (!yaml_emitter_emit (emitter, &event))
+      if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
         {
           zval_dtor(&temp);
           return FAILURE;
         }
 
       zval_dtor(&temp);
+      YAML_G (stats).scalars[Y_STATS_FLOAT]++;
       break;
 
     case IS_BOOL:
@@ -373,9 +621,9 @@ php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
                                          YAML_PLAIN_SCALAR_STYLE))
         return FAILURE;
 
-      if (!yaml_emitter_emit (emitter, &event))
+      if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
         return FAILURE;
-
+      YAML_G (stats).scalars[Y_STATS_BOOL]++;
       break;
 
     case IS_LONG:
@@ -395,13 +643,14 @@ php_yaml_mangle_queue (zval *data, yaml_parser_t *parser,
           return FAILURE;
         }
 
-      if (!yaml_emitter_emit (emitter, &event))
+      if (!php_yaml_emit_event (emitter, chunk, &event TSRMLS_CC))
         {
           zval_dtor(&temp);
           return FAILURE;
         }
 
       zval_dtor(&temp);
+      YAML_G (stats).scalars[Y_STATS_INT]++;
       break;
             
     case IS_RESOURCE:
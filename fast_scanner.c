@@ -0,0 +1,863 @@
+/**
+ * Fast path scanner for block-style YAML
+ *
+ * This file is part of php-yaml.
+ * php-yaml is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * php-yaml is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with php-yaml.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * LibYAML decodes and checks its input one character at a time, which
+ * dominates the time spent on large block-style files. Most of those
+ * use only a small part of YAML: block collections, scalars on a
+ * single line and comments. This scanner turns such input straight into
+ * the events LibYAML would give, going over runs of ordinary bytes 16 at
+ * a time with SSE2 where the compiler has it.
+ *
+ * It works line by line: a node ends where a line with content starts
+ * in a column left of it. Anything outside the subset, from anchors and
+ * flow collections to a plain scalar that goes on over the next line,
+ * makes it give up, and the whole input is parsed by LibYAML instead,
+ * so the result never depends on which path was taken.
+ *
+ * @package     php-yaml
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <php.h>
+#include <yaml.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "php_yaml.h"
+#include "parser.h"
+#include "fast_scanner.h"
+
+/* what php_yaml_fast_line() found */
+#define Y_FAST_ERROR   -1  /* outside the subset */
+#define Y_FAST_END      0  /* end of input */
+#define Y_FAST_CONTENT  1  /* a line with content, f->p at its first byte */
+#define Y_FAST_MARKER   2  /* a "---" or "..." line */
+
+#define Y_FAST_EOL(f, q) ((q) == (f)->end || *(q) == '\n')
+#define Y_FAST_BLANK(f, q) ((q) == (f)->end || *(q) == ' ' || *(q) == '\n')
+#define Y_FAST_COLUMN(f) ((size_t)((f)->p - (f)->bol))
+
+typedef struct _php_yaml_fast {
+	const unsigned char *input;
+	const unsigned char *end;
+	const unsigned char *p;    /* current position */
+	const unsigned char *bol;  /* start of the current line */
+	size_t line;
+	int depth;
+	php_yaml_event_list *list;
+} php_yaml_fast;
+
+typedef struct _php_yaml_fast_token {
+	const unsigned char *start;  /* first byte, quotes included */
+	const unsigned char *end;    /* after the last byte */
+	yaml_scalar_style_t style;
+	yaml_char_t *value;
+	size_t length;
+} php_yaml_fast_token;
+
+static int
+php_yaml_fast_node(php_yaml_fast *f, size_t indent);
+
+/* {{{ php_yaml_fast_ctz() */
+static int
+php_yaml_fast_ctz(unsigned int mask)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(mask);
+#else
+	int n = 0;
+
+	while (!(mask & 1)) {
+		mask >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_find()
+ * The first byte from p on that is a, b or c, or end.
+ */
+static const unsigned char *
+php_yaml_fast_find(const unsigned char *p, const unsigned char *end,
+		unsigned char a, unsigned char b, unsigned char c)
+{
+#ifdef __SSE2__
+	const __m128i va = _mm_set1_epi8((char)a);
+	const __m128i vb = _mm_set1_epi8((char)b);
+	const __m128i vc = _mm_set1_epi8((char)c);
+
+	while (end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		int mask = _mm_movemask_epi8(_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+				_mm_cmpeq_epi8(v, vc)));
+
+		if (mask != 0) {
+			return p + php_yaml_fast_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && *p != a && *p != b && *p != c) {
+		p++;
+	}
+	return p;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_skip_spaces() */
+static const unsigned char *
+php_yaml_fast_skip_spaces(const unsigned char *p, const unsigned char *end)
+{
+#ifdef __SSE2__
+	const __m128i sp = _mm_set1_epi8(' ');
+
+	while (end - p >= 16) {
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128((const __m128i *)p), sp)) ^ 0xffff;
+
+		if (mask != 0) {
+			return p + php_yaml_fast_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && *p == ' ') {
+		p++;
+	}
+	return p;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_utf8()
+ * Length of the UTF-8 sequence at p, or 0 if it is invalid or a
+ * character that LibYAML does not read as a printable non-break: C1
+ * controls including NEL, U+2028, U+2029, U+FEFF, U+FFFE and U+FFFF.
+ */
+static size_t
+php_yaml_fast_utf8(const unsigned char *p, const unsigned char *end)
+{
+	size_t n = end - p;
+	unsigned char c = p[0];
+
+	if (c >= 0xc2 && c <= 0xdf) {
+		if (n < 2 || (p[1] & 0xc0) != 0x80 || (c == 0xc2 && p[1] < 0xa0)) {
+			return 0;
+		}
+		return 2;
+	}
+	if (c >= 0xe0 && c <= 0xef) {
+		if (n < 3 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80 ||
+				(c == 0xe0 && p[1] < 0xa0) ||
+				(c == 0xed && p[1] >= 0xa0) ||
+				(c == 0xe2 && p[1] == 0x80 && (p[2] == 0xa8 || p[2] == 0xa9)) ||
+				(c == 0xef && p[1] == 0xbb && p[2] == 0xbf) ||
+				(c == 0xef && p[1] == 0xbf && p[2] >= 0xbe)) {
+			return 0;
+		}
+		return 3;
+	}
+	if (c >= 0xf0 && c <= 0xf4) {
+		if (n < 4 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80 ||
+				(p[3] & 0xc0) != 0x80 ||
+				(c == 0xf0 && p[1] < 0x90) || (c == 0xf4 && p[1] >= 0x90)) {
+			return 0;
+		}
+		return 4;
+	}
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_check()
+ * Whether input has only printable ASCII, line feeds and UTF-8 taken
+ * by php_yaml_fast_utf8(). Tabs and carriage returns change how LibYAML
+ * reads indentation and line ends, so they are left to it as well.
+ */
+static int
+php_yaml_fast_check(const unsigned char *p, const unsigned char *end)
+{
+#ifdef __SSE2__
+	const __m128i low = _mm_set1_epi8(0x20);
+	const __m128i del = _mm_set1_epi8(0x7f);
+	const __m128i lf = _mm_set1_epi8('\n');
+#endif
+	size_t n;
+
+	while (p < end) {
+#ifdef __SSE2__
+		while (end - p >= 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *)p);
+			/* compared as signed, bytes from 0x80 on are below 0x20 too */
+			int mask = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(v, lf),
+					_mm_or_si128(_mm_cmplt_epi8(v, low), _mm_cmpeq_epi8(v, del))));
+
+			if (mask != 0) {
+				p += php_yaml_fast_ctz(mask);
+				break;
+			}
+			p += 16;
+		}
+		if (p == end) {
+			break;
+		}
+#endif
+		if (*p == '\n' || (*p >= 0x20 && *p < 0x7f)) {
+			p++;
+			continue;
+		}
+		if (*p < 0x80 || (n = php_yaml_fast_utf8(p, end)) == 0) {
+			return FAILURE;
+		}
+		p += n;
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_emit()
+ * Appends event, with marks at start and end of the current line.
+ */
+static int
+php_yaml_fast_emit(php_yaml_fast *f, yaml_event_t *event,
+		const unsigned char *start, const unsigned char *end)
+{
+	event->start_mark.index = start - f->input;
+	event->start_mark.line = f->line;
+	event->start_mark.column = start >= f->bol ? start - f->bol : 0;
+	event->end_mark.index = end - f->input;
+	event->end_mark.line = f->line;
+	event->end_mark.column = end >= f->bol ? end - f->bol : 0;
+
+	if (php_yaml_event_list_add(f->list, event) == FAILURE) {
+		yaml_event_delete(event);
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_event()
+ * Appends an event other than a scalar, as LibYAML makes it for block
+ * style input without anchors or tags.
+ */
+static int
+php_yaml_fast_event(php_yaml_fast *f, yaml_event_type_t type, int implicit,
+		const unsigned char *mark)
+{
+	yaml_event_t event;
+
+	memset(&event, 0, sizeof(yaml_event_t));
+	event.type = type;
+	switch (type) {
+		case YAML_STREAM_START_EVENT:
+			event.data.stream_start.encoding = YAML_UTF8_ENCODING;
+			break;
+		case YAML_DOCUMENT_START_EVENT:
+			event.data.document_start.implicit = implicit;
+			break;
+		case YAML_DOCUMENT_END_EVENT:
+			event.data.document_end.implicit = implicit;
+			break;
+		case YAML_SEQUENCE_START_EVENT:
+			event.data.sequence_start.implicit = 1;
+			event.data.sequence_start.style = YAML_BLOCK_SEQUENCE_STYLE;
+			break;
+		case YAML_MAPPING_START_EVENT:
+			event.data.mapping_start.implicit = 1;
+			event.data.mapping_start.style = YAML_BLOCK_MAPPING_STYLE;
+			break;
+		default:
+			break;
+	}
+	return php_yaml_fast_emit(f, &event, mark, mark);
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_scalar_event()
+ * Appends scalar, whose value the event takes over.
+ */
+static int
+php_yaml_fast_scalar_event(php_yaml_fast *f, php_yaml_fast_token *scalar)
+{
+	yaml_event_t event;
+
+	memset(&event, 0, sizeof(yaml_event_t));
+	event.type = YAML_SCALAR_EVENT;
+	event.data.scalar.value = scalar->value;
+	event.data.scalar.length = scalar->length;
+	event.data.scalar.plain_implicit = scalar->style == YAML_PLAIN_SCALAR_STYLE;
+	event.data.scalar.quoted_implicit = scalar->style != YAML_PLAIN_SCALAR_STYLE;
+	event.data.scalar.style = scalar->style;
+	scalar->value = NULL;
+	return php_yaml_fast_emit(f, &event, scalar->start, scalar->end);
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_empty()
+ * Appends the empty plain scalar LibYAML gives for a missing node.
+ */
+static int
+php_yaml_fast_empty(php_yaml_fast *f, const unsigned char *mark)
+{
+	php_yaml_fast_token scalar;
+
+	if ((scalar.value = malloc(1)) == NULL) {
+		return FAILURE;
+	}
+	scalar.value[0] = '\0';
+	scalar.length = 0;
+	scalar.style = YAML_PLAIN_SCALAR_STYLE;
+	scalar.start = scalar.end = mark;
+	return php_yaml_fast_scalar_event(f, &scalar);
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_line()
+ * Goes on from the start of the current line to the next line with
+ * content, over blank and comment lines.
+ */
+static int
+php_yaml_fast_line(php_yaml_fast *f)
+{
+	for (;;) {
+		const unsigned char *q = php_yaml_fast_skip_spaces(f->bol, f->end);
+
+		if (q < f->end && *q == '#') {
+			q = php_yaml_fast_find(q, f->end, '\n', '\n', '\n');
+		}
+		if (!Y_FAST_EOL(f, q)) {
+			f->p = q;
+			if (q == f->bol && f->end - q >= 3 &&
+					(memcmp(q, "---", 3) == 0 || memcmp(q, "...", 3) == 0) &&
+					Y_FAST_BLANK(f, q + 3)) {
+				return Y_FAST_MARKER;
+			}
+			return Y_FAST_CONTENT;
+		}
+		if (q == f->end) {
+			f->p = q;
+			return Y_FAST_END;
+		}
+		f->bol = q + 1;
+		f->line++;
+	}
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_next()
+ * Checks that the rest of the current line from f->p is blank or a
+ * comment and goes on to the next line with content.
+ */
+static int
+php_yaml_fast_next(php_yaml_fast *f)
+{
+	const unsigned char *q = php_yaml_fast_skip_spaces(f->p, f->end);
+
+	if (q < f->end && *q == '#' && (q == f->bol || q[-1] == ' ')) {
+		q = php_yaml_fast_find(q, f->end, '\n', '\n', '\n');
+	}
+	if (q == f->end) {
+		f->p = q;
+		return Y_FAST_END;
+	}
+	if (*q != '\n') {
+		return Y_FAST_ERROR;
+	}
+	f->bol = q + 1;
+	f->line++;
+	return php_yaml_fast_line(f);
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_plain()
+ * A plain scalar ends at the line end, at ": " or at " #".
+ */
+static int
+php_yaml_fast_plain(php_yaml_fast *f, php_yaml_fast_token *scalar)
+{
+	const unsigned char *p = f->p, *end;
+
+	for (;;) {
+		p = php_yaml_fast_find(p, f->end, '\n', ':', '#');
+		if (Y_FAST_EOL(f, p) || (*p == ':' ? Y_FAST_BLANK(f, p + 1) : p[-1] == ' ')) {
+			break;
+		}
+		p++;
+	}
+	for (end = p; end[-1] == ' '; end--);
+
+	scalar->start = f->p;
+	scalar->end = end;
+	scalar->style = YAML_PLAIN_SCALAR_STYLE;
+	scalar->length = end - f->p;
+	if ((scalar->value = malloc(scalar->length + 1)) == NULL) {
+		return FAILURE;
+	}
+	memcpy(scalar->value, f->p, scalar->length);
+	scalar->value[scalar->length] = '\0';
+	f->p = p;
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_single()
+ * A single-quoted scalar that ends on its line; '' is a quote.
+ */
+static int
+php_yaml_fast_single(php_yaml_fast *f, php_yaml_fast_token *scalar)
+{
+	const unsigned char *p = f->p + 1, *q;
+	yaml_char_t *out;
+	size_t quotes = 0;
+
+	for (;;) {
+		q = php_yaml_fast_find(p, f->end, '\'', '\n', '\n');
+		if (Y_FAST_EOL(f, q)) {
+			return FAILURE;
+		}
+		if (q + 1 < f->end && q[1] == '\'') {
+			quotes++;
+			p = q + 2;
+			continue;
+		}
+		break;
+	}
+
+	scalar->start = f->p;
+	scalar->end = q + 1;
+	scalar->style = YAML_SINGLE_QUOTED_SCALAR_STYLE;
+	scalar->length = q - f->p - 1 - quotes;
+	if ((scalar->value = malloc(scalar->length + 1)) == NULL) {
+		return FAILURE;
+	}
+	if (quotes == 0) {
+		memcpy(scalar->value, f->p + 1, scalar->length);
+	} else {
+		for (p = f->p + 1, out = scalar->value; p < q; p++) {
+			*out++ = *p;
+			if (*p == '\'') {
+				p++;
+			}
+		}
+	}
+	scalar->value[scalar->length] = '\0';
+	f->p = q + 1;
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_hex() */
+static int
+php_yaml_fast_hex(const unsigned char *p, int digits, unsigned long *value)
+{
+	int i;
+
+	*value = 0;
+	for (i = 0; i < digits; i++) {
+		unsigned char c = p[i];
+
+		if (c >= '0' && c <= '9') {
+			*value = (*value << 4) + (c - '0');
+		} else if (c >= 'a' && c <= 'f') {
+			*value = (*value << 4) + (c - 'a' + 10);
+		} else if (c >= 'A' && c <= 'F') {
+			*value = (*value << 4) + (c - 'A' + 10);
+		} else {
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_double()
+ * A double-quoted scalar that ends on its line, with the escapes of
+ * LibYAML except for escaped line breaks. Only \L and \P stand for
+ * more bytes than they take, half as many again, so the value fits in
+ * one and a half times the length of the line.
+ */
+static int
+php_yaml_fast_double(php_yaml_fast *f, php_yaml_fast_token *scalar)
+{
+	const unsigned char *p = f->p + 1, *q;
+	const unsigned char *eol = php_yaml_fast_find(p, f->end, '\n', '\n', '\n');
+	yaml_char_t *out;
+	unsigned long value;
+	int digits;
+
+	if ((scalar->value = malloc((eol - p) * 3 / 2 + 1)) == NULL) {
+		return FAILURE;
+	}
+	out = scalar->value;
+
+	for (;;) {
+		q = php_yaml_fast_find(p, eol, '"', '\\', '\\');
+		memcpy(out, p, q - p);
+		out += q - p;
+		if (q == eol) {
+			goto failure;
+		}
+		if (*q == '"') {
+			break;
+		}
+		if (q + 1 == eol) {
+			goto failure;
+		}
+
+		p = q + 2;
+		digits = 0;
+		switch (q[1]) {
+			case '0': *out++ = '\0'; break;
+			case 'a': *out++ = '\x07'; break;
+			case 'b': *out++ = '\x08'; break;
+			case 't': *out++ = '\x09'; break;
+			case 'n': *out++ = '\x0a'; break;
+			case 'v': *out++ = '\x0b'; break;
+			case 'f': *out++ = '\x0c'; break;
+			case 'r': *out++ = '\x0d'; break;
+			case 'e': *out++ = '\x1b'; break;
+			case ' ': *out++ = ' '; break;
+			case '"': *out++ = '"'; break;
+			case '/': *out++ = '/'; break;
+			case '\\': *out++ = '\\'; break;
+			case 'N': *out++ = 0xc2; *out++ = 0x85; break;
+			case '_': *out++ = 0xc2; *out++ = 0xa0; break;
+			case 'L': *out++ = 0xe2; *out++ = 0x80; *out++ = 0xa8; break;
+			case 'P': *out++ = 0xe2; *out++ = 0x80; *out++ = 0xa9; break;
+			case 'x': digits = 2; break;
+			case 'u': digits = 4; break;
+			case 'U': digits = 8; break;
+			default:
+				goto failure;
+		}
+		if (digits == 0) {
+			continue;
+		}
+
+		if (eol - p < digits || php_yaml_fast_hex(p, digits, &value) == FAILURE ||
+				(value >= 0xd800 && value <= 0xdfff) || value > 0x10ffff) {
+			goto failure;
+		}
+		p += digits;
+		if (value <= 0x7f) {
+			*out++ = (yaml_char_t)value;
+		} else if (value <= 0x7ff) {
+			*out++ = 0xc0 + (value >> 6);
+			*out++ = 0x80 + (value & 0x3f);
+		} else if (value <= 0xffff) {
+			*out++ = 0xe0 + (value >> 12);
+			*out++ = 0x80 + ((value >> 6) & 0x3f);
+			*out++ = 0x80 + (value & 0x3f);
+		} else {
+			*out++ = 0xf0 + (value >> 18);
+			*out++ = 0x80 + ((value >> 12) & 0x3f);
+			*out++ = 0x80 + ((value >> 6) & 0x3f);
+			*out++ = 0x80 + (value & 0x3f);
+		}
+	}
+
+	*out = '\0';
+	scalar->start = f->p;
+	scalar->end = q + 1;
+	scalar->style = YAML_DOUBLE_QUOTED_SCALAR_STYLE;
+	scalar->length = out - scalar->value;
+	f->p = q + 1;
+	return SUCCESS;
+
+failure:
+	free(scalar->value);
+	scalar->value = NULL;
+	return FAILURE;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_scalar()
+ * Scans the scalar at f->p, if it is in the subset.
+ */
+static int
+php_yaml_fast_scalar(php_yaml_fast *f, php_yaml_fast_token *scalar)
+{
+	switch (*f->p) {
+		case '\'':
+			return php_yaml_fast_single(f, scalar);
+		case '"':
+			return php_yaml_fast_double(f, scalar);
+		case '[': case ']': case '{': case '}': case ',': case '#':
+		case '&': case '*': case '!': case '|': case '>': case '%':
+		case '@': case '`':
+			return FAILURE;
+		case '-': case '?': case ':':
+			if (Y_FAST_BLANK(f, f->p + 1)) {
+				return FAILURE;
+			}
+			break;
+	}
+	return php_yaml_fast_plain(f, scalar);
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_key()
+ * Whether scalar, just scanned, is followed by ": " and so is a simple
+ * key. Moves f->p past the colon if it is. Returns Y_FAST_ERROR if the
+ * colon is further than Y_FAST_MAX_KEY from the start of the key.
+ */
+static int
+php_yaml_fast_key(php_yaml_fast *f, php_yaml_fast_token *scalar)
+{
+	const unsigned char *q = php_yaml_fast_skip_spaces(f->p, f->end);
+
+	if (q < f->end && *q == ':' && Y_FAST_BLANK(f, q + 1)) {
+		if (q - scalar->start > Y_FAST_MAX_KEY) {
+			return Y_FAST_ERROR;
+		}
+		f->p = q + 1;
+		return 1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_value()
+ * The node after a "- " or a key. A node that starts on a later line
+ * must be indented deeper than indent, except for a sequence under a
+ * key, which may be in the same column.
+ */
+static int
+php_yaml_fast_value(php_yaml_fast *f, size_t indent, int in_mapping)
+{
+	const unsigned char *q = php_yaml_fast_skip_spaces(f->p, f->end);
+	php_yaml_fast_token scalar;
+	int next;
+
+	if (!Y_FAST_EOL(f, q) && *q != '#') {
+		f->p = q;
+		if (!in_mapping) {
+			return php_yaml_fast_node(f, Y_FAST_COLUMN(f));
+		}
+		/* "a: - b" and "a: b: c" are errors, only a scalar can follow */
+		if (php_yaml_fast_scalar(f, &scalar) == FAILURE ||
+				php_yaml_fast_scalar_event(f, &scalar) == FAILURE) {
+			return Y_FAST_ERROR;
+		}
+		return php_yaml_fast_next(f);
+	}
+
+	next = php_yaml_fast_next(f);
+	if (next == Y_FAST_CONTENT && (Y_FAST_COLUMN(f) > indent ||
+			(in_mapping && Y_FAST_COLUMN(f) == indent &&
+			 *f->p == '-' && Y_FAST_BLANK(f, f->p + 1)))) {
+		return php_yaml_fast_node(f, Y_FAST_COLUMN(f));
+	}
+	if (next != Y_FAST_ERROR && php_yaml_fast_empty(f, q) == FAILURE) {
+		return Y_FAST_ERROR;
+	}
+	return next;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_mapping()
+ * A block mapping in column indent, whose first key has been scanned.
+ */
+static int
+php_yaml_fast_mapping(php_yaml_fast *f, size_t indent, php_yaml_fast_token *key)
+{
+	int next;
+
+	if (php_yaml_fast_event(f, YAML_MAPPING_START_EVENT, 1, key->start) == FAILURE) {
+		free(key->value);
+		return Y_FAST_ERROR;
+	}
+
+	for (;;) {
+		if (php_yaml_fast_scalar_event(f, key) == FAILURE) {
+			return Y_FAST_ERROR;
+		}
+		next = php_yaml_fast_value(f, indent, 1);
+		if (next != Y_FAST_CONTENT || Y_FAST_COLUMN(f) < indent) {
+			break;
+		}
+		if (Y_FAST_COLUMN(f) > indent || php_yaml_fast_scalar(f, key) == FAILURE) {
+			return Y_FAST_ERROR;
+		}
+		if (php_yaml_fast_key(f, key) != 1) {
+			free(key->value);
+			return Y_FAST_ERROR;
+		}
+	}
+	if (next == Y_FAST_ERROR ||
+			php_yaml_fast_event(f, YAML_MAPPING_END_EVENT, 1, f->p) == FAILURE) {
+		return Y_FAST_ERROR;
+	}
+	return next;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_sequence()
+ * A block sequence in column indent, f->p at its first "-".
+ */
+static int
+php_yaml_fast_sequence(php_yaml_fast *f, size_t indent)
+{
+	int next;
+
+	if (php_yaml_fast_event(f, YAML_SEQUENCE_START_EVENT, 1, f->p) == FAILURE) {
+		return Y_FAST_ERROR;
+	}
+
+	for (;;) {
+		f->p++;
+		next = php_yaml_fast_value(f, indent, 0);
+		if (next != Y_FAST_CONTENT || Y_FAST_COLUMN(f) < indent) {
+			break;
+		}
+		if (Y_FAST_COLUMN(f) > indent) {
+			return Y_FAST_ERROR;
+		}
+		/* a key in the same column ends a sequence under a key */
+		if (*f->p != '-' || !Y_FAST_BLANK(f, f->p + 1)) {
+			break;
+		}
+	}
+	if (next == Y_FAST_ERROR ||
+			php_yaml_fast_event(f, YAML_SEQUENCE_END_EVENT, 1, f->p) == FAILURE) {
+		return Y_FAST_ERROR;
+	}
+	return next;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_node()
+ * The node at f->p, in column indent: a sequence, a mapping or a
+ * scalar. Returns what php_yaml_fast_line() found after it.
+ */
+static int
+php_yaml_fast_node(php_yaml_fast *f, size_t indent)
+{
+	php_yaml_fast_token scalar;
+	int next;
+
+	if (++f->depth > Y_FAST_MAX_DEPTH) {
+		return Y_FAST_ERROR;
+	}
+
+	if (*f->p == '-' && Y_FAST_BLANK(f, f->p + 1)) {
+		next = php_yaml_fast_sequence(f, indent);
+	} else if (php_yaml_fast_scalar(f, &scalar) == FAILURE) {
+		next = Y_FAST_ERROR;
+	} else if ((next = php_yaml_fast_key(f, &scalar)) != 0) {
+		if (next == Y_FAST_ERROR) {
+			free(scalar.value);
+			next = Y_FAST_ERROR;
+		} else {
+			next = php_yaml_fast_mapping(f, indent, &scalar);
+		}
+	} else if (php_yaml_fast_scalar_event(f, &scalar) == FAILURE) {
+		next = Y_FAST_ERROR;
+	} else {
+		next = php_yaml_fast_next(f);
+	}
+
+	f->depth--;
+	return next;
+}
+/* }}} */
+
+/* {{{ php_yaml_fast_scan() */
+int
+php_yaml_fast_scan(const unsigned char *input, size_t length,
+		php_yaml_event_list *list)
+{
+	php_yaml_fast f;
+	const unsigned char *mark;
+	int next, implicit;
+
+	if (php_yaml_fast_check(input, input + length) == FAILURE) {
+		return FAILURE;
+	}
+
+	f.input = f.p = f.bol = input;
+	f.end = input + length;
+	f.line = 0;
+	f.depth = 0;
+	f.list = list;
+
+	if (php_yaml_fast_event(&f, YAML_STREAM_START_EVENT, 0, f.p) == FAILURE) {
+		goto failure;
+	}
+
+	next = php_yaml_fast_line(&f);
+	while (next != Y_FAST_END) {
+		mark = f.p;
+		implicit = 1;
+		if (next == Y_FAST_MARKER) {
+			/* "..." with no document before it */
+			if (*f.p == '.') {
+				goto failure;
+			}
+			implicit = 0;
+			f.p += 3;
+			next = php_yaml_fast_next(&f);
+		}
+		if (next == Y_FAST_ERROR ||
+				php_yaml_fast_event(&f, YAML_DOCUMENT_START_EVENT, implicit, mark) == FAILURE) {
+			goto failure;
+		}
+
+		if (next == Y_FAST_CONTENT) {
+			next = php_yaml_fast_node(&f, Y_FAST_COLUMN(&f));
+		} else if (php_yaml_fast_empty(&f, f.p) == FAILURE) {
+			goto failure;
+		}
+		if (next == Y_FAST_ERROR || next == Y_FAST_CONTENT) {
+			goto failure;
+		}
+
+		mark = f.p;
+		implicit = 1;
+		if (next == Y_FAST_MARKER && *f.p == '.') {
+			implicit = 0;
+			f.p += 3;
+			next = php_yaml_fast_next(&f);
+			/* a bare document after "..." */
+			if (next == Y_FAST_ERROR || next == Y_FAST_CONTENT) {
+				goto failure;
+			}
+		}
+		if (php_yaml_fast_event(&f, YAML_DOCUMENT_END_EVENT, implicit, mark) == FAILURE) {
+			goto failure;
+		}
+	}
+
+	if (php_yaml_fast_event(&f, YAML_STREAM_END_EVENT, 0, f.p) == FAILURE) {
+		goto failure;
+	}
+	return SUCCESS;
+
+failure:
+	php_yaml_event_list_free(list);
+	memset(&list->error, 0, sizeof(yaml_parser_t));
+	return FAILURE;
+}
+/* }}} */
@@ -0,0 +1,21 @@
+#ifndef FAST_SCANNER_H
+#define FAST_SCANNER_H
+
+/* deeper input is left to LibYAML */
+#define Y_FAST_MAX_DEPTH  256
+/* furthest a simple key may end from its start, below LibYAML's 1024 */
+#define Y_FAST_MAX_KEY    1000
+
+/* {{{ fast scanner
+ * Records the events LibYAML would give for input into list, if all of
+ * the input is in the subset of YAML the fast scanner knows: block
+ * mappings and sequences, plain and quoted scalars on a single line,
+ * comments and "---"/"..." lines. Returns FAILURE with list empty for
+ * anything else, which is then left to LibYAML. Uses no Zend API.
+ */
+int
+php_yaml_fast_scan(const unsigned char *input, size_t length,
+		php_yaml_event_list *list);
+/* }}} */
+
+#endif
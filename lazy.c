@@ -0,0 +1,1523 @@
+/**
+ * YamlNode, documents turned into PHP values only where they are read
+ *
+ * This file is part of php-yaml.
+ * php-yaml is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * php-yaml is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with php-yaml.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * yaml_parse_lazy() keeps a document as a flat array of nodes plus the
+ * text of its scalars instead of building zvals for it. A YamlNode is
+ * a collection in that tree. Its entries become PHP values only when
+ * they are read, through the same scalar evaluation and tag callbacks
+ * as yaml_parse(); collections come out as further YamlNode objects
+ * over the same tree, and an alias as its anchored node. The keys of a
+ * mapping are converted when its first entry is looked up.
+ *
+ * yaml_parse_document() returns the same tree as a YamlDocument, which
+ * looks up paths in it directly: at each mapping the entries are
+ * compared by the hash stored with their key and skipped by the end
+ * stored with their value. Its serialized form is the tree itself.
+ *
+ * @package     php-yaml
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <php.h>
+#include <php_ini.h>
+#include <yaml.h>
+#include <zend_interfaces.h>
+#include <ext/standard/php_smart_str.h>
+#include <ext/spl/spl_array.h>
+#include <ext/spl/spl_iterators.h>
+#include "php_yaml.h"
+#include "zval_refcount.h" /* for PHP < 5.3 */
+#include "parser.h"
+#include "lazy.h"
+
+zend_class_entry *php_yaml_node_ce;
+zend_class_entry *php_yaml_document_ce;
+
+static zend_object_handlers php_yaml_node_handlers;
+
+typedef struct _php_yaml_node {
+  zend_object std;
+  php_yaml_lazy_tree *tree;
+  size_t node;
+  size_t *entries;   /* first node of each entry, once looked up */
+  HashTable *keys;   /* entry of each key of a mapping, likewise */
+} php_yaml_node;
+
+typedef struct _php_yaml_document {
+  zend_object std;
+  php_yaml_lazy_tree *tree;
+} php_yaml_document;
+
+/* {{{ php_yaml_lazy_free () */
+static void
+php_yaml_lazy_free (php_yaml_lazy_tree *tree TSRMLS_DC)
+{
+  if (--tree->refcount > 0)
+    return;
+
+  if (tree->nodes != NULL)
+    efree (tree->nodes);
+  smart_str_free (&tree->data);
+  if (tree->callbacks != NULL)
+    {
+      php_yaml_callbacks_end (Z_ARRVAL_P (tree->callbacks) TSRMLS_CC);
+      zval_ptr_dtor (&tree->callbacks);
+    }
+  efree (tree);
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_text ()
+ * Appends a scalar or tag to the data of tree; returns its offset.
+ */
+static size_t
+php_yaml_lazy_text (php_yaml_lazy_tree *tree, const char *str, size_t length)
+{
+  size_t offset = tree->data.len;
+
+  smart_str_appendl (&tree->data, str, length);
+  smart_str_appendc (&tree->data, '\0');
+  return offset;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_tag () */
+static size_t
+php_yaml_lazy_tag (php_yaml_lazy_tree *tree, HashTable *tags, const char *tag)
+{
+  size_t *found = NULL;
+  size_t offset;
+
+  if (tag == NULL)
+    return Y_LAZY_NO_TAG;
+
+  if (zend_hash_find (tags, (char *)tag, strlen (tag) + 1, (void **)&found) == SUCCESS)
+    return *found;
+
+  offset = php_yaml_lazy_text (tree, tag, strlen (tag));
+  zend_hash_add (tags, (char *)tag, strlen (tag) + 1, &offset, sizeof (size_t), NULL);
+  return offset;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_build ()
+ * Reads document pos of source into tree, which stays empty if there
+ * is no such document.
+ */
+static int
+php_yaml_lazy_build (php_yaml_source *source, long pos, php_yaml_lazy_tree *tree TSRMLS_DC)
+{
+  yaml_event_t event = {0};
+  HashTable anchors, tags;
+  size_t *stack = NULL;
+  size_t depth = 0, size = 0;
+  long counter = 0;
+  int reading = 0;
+  int code = Y_PARSER_CONTINUE;
+
+  zend_hash_init (&anchors, 0, NULL, NULL, 0);
+  zend_hash_init (&tags, 0, NULL, NULL, 0);
+
+  do
+    {
+      php_yaml_lazy_node *node = NULL;
+      size_t index = tree->count;
+      char *anchor = NULL;
+
+      if (php_yaml_next_event (source, &event TSRMLS_CC) == FAILURE)
+        {
+          code = Y_PARSER_FAILURE;
+          break;
+        }
+
+      switch (event.type)
+        {
+        case YAML_DOCUMENT_START_EVENT:
+          reading = (counter == pos);
+          break;
+
+        case YAML_DOCUMENT_END_EVENT:
+          if (reading)
+            code = Y_PARSER_SUCCESS;
+          counter++;
+          break;
+
+        case YAML_STREAM_END_EVENT:
+          code = Y_PARSER_SUCCESS;
+          break;
+
+        case YAML_SEQUENCE_END_EVENT:
+        case YAML_MAPPING_END_EVENT:
+          if (reading)
+            tree->nodes[stack[--depth]].next = tree->count;
+          break;
+
+        case YAML_SCALAR_EVENT:
+        case YAML_SEQUENCE_START_EVENT:
+        case YAML_MAPPING_START_EVENT:
+        case YAML_ALIAS_EVENT:
+          if (!reading)
+            break;
+
+          if (tree->count == tree->size)
+            {
+              tree->size = tree->size ? tree->size * 2 : 64;
+              tree->nodes = (php_yaml_lazy_node *)safe_erealloc (tree->nodes, tree->size,
+                                                                sizeof (php_yaml_lazy_node), 0);
+            }
+          node = &tree->nodes[tree->count++];
+          memset (node, 0, sizeof (php_yaml_lazy_node));
+          node->next = index + 1;
+          node->tag = Y_LAZY_NO_TAG;
+
+          if (depth > 0)
+            {
+              php_yaml_lazy_node *parent = &tree->nodes[stack[depth - 1]];
+
+              if (parent->type == Y_LAZY_MAPPING && parent->count % 2 == 0)
+                node->flags |= Y_LAZY_KEY;
+              parent->count++;
+            }
+          break;
+
+        default:
+          break;
+        }
+
+      if (node != NULL)
+        switch (event.type)
+          {
+          case YAML_SCALAR_EVENT:
+            node->type = Y_LAZY_SCALAR;
+            node->style = (unsigned char)event.data.scalar.style;
+            if (event.data.scalar.plain_implicit)
+              node->flags |= Y_LAZY_PLAIN_IMPLICIT;
+            if (event.data.scalar.quoted_implicit)
+              node->flags |= Y_LAZY_QUOTED_IMPLICIT;
+            node->value = php_yaml_lazy_text (tree, (char *)event.data.scalar.value,
+                                              event.data.scalar.length);
+            node->length = event.data.scalar.length;
+            if (node->flags & Y_LAZY_KEY)
+              node->count = zend_inline_hash_func ((char *)event.data.scalar.value,
+                                                   (uint)event.data.scalar.length);
+            node->tag = php_yaml_lazy_tag (tree, &tags, (char *)event.data.scalar.tag);
+            anchor = (char *)event.data.scalar.anchor;
+            break;
+
+          case YAML_SEQUENCE_START_EVENT:
+          case YAML_MAPPING_START_EVENT:
+            if (event.type == YAML_SEQUENCE_START_EVENT)
+              {
+                node->type = Y_LAZY_SEQUENCE;
+                if (event.data.sequence_start.implicit)
+                  node->flags |= Y_LAZY_IMPLICIT;
+                node->tag = php_yaml_lazy_tag (tree, &tags, (char *)event.data.sequence_start.tag);
+                anchor = (char *)event.data.sequence_start.anchor;
+              }
+            else
+              {
+                node->type = Y_LAZY_MAPPING;
+                if (event.data.mapping_start.implicit)
+                  node->flags |= Y_LAZY_IMPLICIT;
+                node->tag = php_yaml_lazy_tag (tree, &tags, (char *)event.data.mapping_start.tag);
+                anchor = (char *)event.data.mapping_start.anchor;
+              }
+            node->next = 0;
+
+            if (depth == size)
+              {
+                size = size ? size * 2 : 16;
+                stack = (size_t *)safe_erealloc (stack, size, sizeof (size_t), 0);
+              }
+            stack[depth++] = index;
+            break;
+
+          case YAML_ALIAS_EVENT:
+            {
+              size_t *target = NULL;
+
+              if (zend_hash_find (&anchors, (char *)event.data.alias.anchor,
+                                  strlen ((char *)event.data.alias.anchor) + 1,
+                                  (void **)&target) == FAILURE)
+                {
+                  php_error_docref (NULL TSRMLS_CC, E_WARNING,
+                                    "alias %s is not registered", (char *)event.data.alias.anchor);
+                  code = Y_PARSER_FAILURE;
+                  break;
+                }
+              node->type = Y_LAZY_ALIAS;
+              node->value = *target;
+              if (tree->nodes[*target].next == 0)
+                node->flags |= Y_LAZY_RECURSIVE;
+            }
+            break;
+
+          default:
+            break;
+          }
+
+      if (anchor != NULL)
+        {
+          node->flags |= Y_LAZY_ANCHOR;
+          zend_hash_update (&anchors, anchor, strlen (anchor) + 1,
+                            &index, sizeof (size_t), NULL);
+        }
+
+      yaml_event_delete (&event);
+    }
+  while (code == Y_PARSER_CONTINUE);
+
+  yaml_event_delete (&event);
+  zend_hash_destroy (&anchors);
+  zend_hash_destroy (&tags);
+  if (stack != NULL)
+    efree (stack);
+
+  if (code == Y_PARSER_FAILURE)
+    return FAILURE;
+
+  /* give back what the doubling left over */
+  if (tree->count > 0 && tree->count < tree->size)
+    {
+      tree->nodes = (php_yaml_lazy_node *)erealloc (tree->nodes,
+                                                    tree->count * sizeof (php_yaml_lazy_node));
+      tree->size = tree->count;
+    }
+  if (tree->data.c != NULL && tree->data.len + 1 < tree->data.a)
+    {
+      tree->data.c = erealloc (tree->data.c, tree->data.len + 1);
+      tree->data.a = tree->data.len + 1;
+    }
+  return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_scalar () */
+static zval *
+php_yaml_lazy_scalar (php_yaml_lazy_tree *tree, size_t index TSRMLS_DC)
+{
+  php_yaml_lazy_node *node = &tree->nodes[index];
+  yaml_event_t event;
+  zval *retval;
+
+  /* an anchored key is shared as written, like php_yaml_lazy_key () */
+  if (node->flags & Y_LAZY_KEY)
+    {
+      MAKE_STD_ZVAL (retval);
+      ZVAL_STRINGL (retval, tree->data.c + node->value, node->length, 1);
+      return retval;
+    }
+
+  memset (&event, 0, sizeof (yaml_event_t));
+  event.type = YAML_SCALAR_EVENT;
+  event.data.scalar.value = (yaml_char_t *)tree->data.c + node->value;
+  event.data.scalar.length = node->length;
+  if (node->tag != Y_LAZY_NO_TAG)
+    event.data.scalar.tag = (yaml_char_t *)tree->data.c + node->tag;
+  event.data.scalar.plain_implicit = (node->flags & Y_LAZY_PLAIN_IMPLICIT) != 0;
+  event.data.scalar.quoted_implicit = (node->flags & Y_LAZY_QUOTED_IMPLICIT) != 0;
+  event.data.scalar.style = (yaml_scalar_style_t)node->style;
+
+  if (tree->callbacks != NULL)
+    return php_yaml_eval_scalar_with_callbacks (event, Z_ARRVAL_P (tree->callbacks) TSRMLS_CC);
+  return php_yaml_eval_scalar (event, NULL TSRMLS_CC);
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_filtered ()
+ * Whether index is a collection with a tag callback, which needs all
+ * of it as an array.
+ */
+static int
+php_yaml_lazy_filtered (php_yaml_lazy_tree *tree, size_t index)
+{
+  php_yaml_lazy_node *node = &tree->nodes[index];
+  const char *tag;
+
+  if (tree->callbacks == NULL || node->type == Y_LAZY_SCALAR ||
+      (node->flags & Y_LAZY_IMPLICIT) || node->tag == Y_LAZY_NO_TAG)
+    return 0;
+
+  tag = tree->data.c + node->tag;
+  return zend_hash_exists (Z_ARRVAL_P (tree->callbacks), (char *)tag, strlen (tag) + 1);
+}
+/* }}} */
+
+static char *
+php_yaml_lazy_key (php_yaml_lazy_tree *tree, size_t index, HashTable *shared TSRMLS_DC);
+
+/* {{{ php_yaml_lazy_materialize ()
+ * All of node index as yaml_parse() would give it. shared holds the
+ * anchored nodes done so far, which their aliases share.
+ */
+static zval *
+php_yaml_lazy_materialize (php_yaml_lazy_tree *tree, size_t index, HashTable *shared TSRMLS_DC)
+{
+  php_yaml_lazy_node *node = &tree->nodes[index];
+  zval *retval = NULL;
+  zval **found = NULL;
+  size_t i, child;
+
+  if (node->type == Y_LAZY_ALIAS)
+    {
+      if (node->flags & Y_LAZY_RECURSIVE)
+        {
+          php_error_docref (NULL TSRMLS_CC, E_WARNING,
+                            "alias inside the node it refers to can't be copied into an array");
+          return NULL;
+        }
+      index = node->value;
+      node = &tree->nodes[index];
+    }
+
+  if ((node->flags & Y_LAZY_ANCHOR) &&
+      zend_hash_index_find (shared, index, (void **)&found) == SUCCESS)
+    {
+      Z_ADDREF_PP (found);
+      return *found;
+    }
+
+  if (node->type == Y_LAZY_SCALAR)
+    retval = php_yaml_lazy_scalar (tree, index TSRMLS_CC);
+  else
+    {
+      MAKE_STD_ZVAL (retval);
+      array_init_size (retval, node->type == Y_LAZY_MAPPING ? node->count / 2 : node->count);
+#ifdef IS_UNICODE
+      Z_ARRVAL_P (retval)->unicode = UG (unicode);
+#endif
+      YAML_G (stats).allocations++;
+
+      for (i = 0, child = index + 1; i < node->count; i++, child = tree->nodes[child].next)
+        {
+          char *key = NULL;
+          zval *value;
+
+          if (node->type == Y_LAZY_MAPPING)
+            {
+              if ((key = php_yaml_lazy_key (tree, child, shared TSRMLS_CC)) == NULL)
+                {
+                  zval_ptr_dtor (&retval);
+                  return NULL;
+                }
+              child = tree->nodes[child].next;
+              i++;
+            }
+
+          if ((value = php_yaml_lazy_materialize (tree, child, shared TSRMLS_CC)) == NULL)
+            {
+              if (key != NULL)
+                efree (key);
+              zval_ptr_dtor (&retval);
+              return NULL;
+            }
+
+          if (key != NULL)
+            {
+              add_assoc_zval (retval, key, value);
+              efree (key);
+            }
+          else
+            add_next_index_zval (retval, value);
+        }
+
+      if (php_yaml_lazy_filtered (tree, index))
+        {
+          yaml_event_t event;
+
+          memset (&event, 0, sizeof (yaml_event_t));
+          if (node->type == Y_LAZY_MAPPING)
+            {
+              event.type = YAML_MAPPING_START_EVENT;
+              event.data.mapping_start.tag = (yaml_char_t *)tree->data.c + node->tag;
+            }
+          else
+            {
+              event.type = YAML_SEQUENCE_START_EVENT;
+              event.data.sequence_start.tag = (yaml_char_t *)tree->data.c + node->tag;
+            }
+          if (php_yaml_apply_filter (&retval, event, Z_ARRVAL_P (tree->callbacks) TSRMLS_CC)
+              == Y_FILTER_FAILURE)
+            {
+              zval_ptr_dtor (&retval);
+              return NULL;
+            }
+        }
+    }
+
+  if (retval != NULL && (node->flags & Y_LAZY_ANCHOR))
+    {
+      Z_ADDREF_P (retval);
+      zend_hash_index_update (shared, index, &retval, sizeof (zval *), NULL);
+    }
+  return retval;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_key ()
+ * The mapping key at node index, as php_yaml_read_impl() makes it.
+ */
+static char *
+php_yaml_lazy_key (php_yaml_lazy_tree *tree, size_t index, HashTable *shared TSRMLS_DC)
+{
+  php_yaml_lazy_node *node = &tree->nodes[index];
+  zval *zv;
+  char *key;
+
+  if (node->type == Y_LAZY_ALIAS && !(node->flags & Y_LAZY_RECURSIVE))
+    node = &tree->nodes[node->value];
+
+  /* a scalar that was read as a key is taken as written */
+  if (node->type == Y_LAZY_SCALAR && (node->flags & Y_LAZY_KEY))
+    return estrndup (tree->data.c + node->value, node->length);
+
+  if ((zv = php_yaml_lazy_materialize (tree, index, shared TSRMLS_CC)) == NULL)
+    return NULL;
+  key = php_yaml_convert_to_char (zv TSRMLS_CC);
+  zval_ptr_dtor (&zv);
+  return key;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_value ()
+ * Node index as a PHP value: a scalar evaluated, a collection as a
+ * YamlNode unless a tag callback wants it as an array.
+ */
+static zval *
+php_yaml_lazy_value (php_yaml_lazy_tree *tree, size_t index TSRMLS_DC)
+{
+  php_yaml_node *yn;
+  zval *retval;
+
+  if (tree->nodes[index].type == Y_LAZY_ALIAS)
+    index = tree->nodes[index].value;
+
+  if (tree->nodes[index].type == Y_LAZY_SCALAR)
+    return php_yaml_lazy_scalar (tree, index TSRMLS_CC);
+
+  if (php_yaml_lazy_filtered (tree, index))
+    {
+      HashTable shared;
+
+      zend_hash_init (&shared, 0, NULL, ZVAL_PTR_DTOR, 0);
+      retval = php_yaml_lazy_materialize (tree, index, &shared TSRMLS_CC);
+      zend_hash_destroy (&shared);
+      return retval;
+    }
+
+  MAKE_STD_ZVAL (retval);
+  object_init_ex (retval, php_yaml_node_ce);
+  yn = (php_yaml_node *)zend_object_store_get_object (retval TSRMLS_CC);
+  yn->tree = tree;
+  yn->node = index;
+  tree->refcount++;
+  return retval;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_begin ()
+ * Sets up scalar evaluation the way yaml_parse() does for its call.
+ */
+static void
+php_yaml_lazy_begin (TSRMLS_D)
+{
+#ifdef IS_UNICODE
+  YAML_G (orig_runtime_encoding_conv) = UG (runtime_encoding_conv);
+  UG (runtime_encoding_conv) = UG (utf8_conv);
+#endif
+  YAML_G (timestamp_decoder) = NULL;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_end () */
+static void
+php_yaml_lazy_end (TSRMLS_D)
+{
+#ifdef IS_UNICODE
+  UG (runtime_encoding_conv) = YAML_G (orig_runtime_encoding_conv);
+#endif
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_load ()
+ * The tree of document pos of source, NULL on an error or if there is
+ * no such document.
+ */
+static php_yaml_lazy_tree *
+php_yaml_lazy_load (php_yaml_source *source, long pos, zval *callbacks TSRMLS_DC)
+{
+  php_yaml_lazy_tree *tree = ecalloc (1, sizeof (php_yaml_lazy_tree));
+
+  tree->refcount = 1;
+  if (callbacks != NULL)
+    {
+      Z_ADDREF_P (callbacks);
+      tree->callbacks = callbacks;
+      /* resolved for as long as the tree evaluates with them */
+      php_yaml_callbacks_begin (Z_ARRVAL_P (callbacks) TSRMLS_CC);
+    }
+
+  if (php_yaml_lazy_build (source, pos, tree TSRMLS_CC) == FAILURE || tree->count == 0)
+    {
+      php_yaml_lazy_free (tree TSRMLS_CC);
+      return NULL;
+    }
+  return tree;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_read ()
+ * Sets return_value to document pos of source: a YamlNode, or the value
+ * of a document that is a single scalar.
+ */
+int
+php_yaml_lazy_read (php_yaml_source *source, long pos, zval *callbacks,
+                    zval *return_value TSRMLS_DC)
+{
+  php_yaml_lazy_tree *tree = php_yaml_lazy_load (source, pos, callbacks TSRMLS_CC);
+  zval *retval = NULL;
+
+  if (tree == NULL)
+    return FAILURE;
+
+  retval = php_yaml_lazy_value (tree, 0 TSRMLS_CC);
+  php_yaml_lazy_free (tree TSRMLS_CC);
+
+  if (retval == NULL)
+    return FAILURE;
+
+  RETVAL_ZVAL (retval, 1, 1);
+  return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_node_free () */
+static void
+php_yaml_node_free (void *object TSRMLS_DC)
+{
+  php_yaml_node *yn = (php_yaml_node *)object;
+
+  if (yn->tree != NULL)
+    php_yaml_lazy_free (yn->tree TSRMLS_CC);
+  if (yn->entries != NULL)
+    efree (yn->entries);
+  if (yn->keys != NULL)
+    {
+      zend_hash_destroy (yn->keys);
+      FREE_HASHTABLE (yn->keys);
+    }
+  zend_object_std_dtor (&yn->std TSRMLS_CC);
+  efree (yn);
+}
+/* }}} */
+
+/* {{{ php_yaml_node_new () */
+static zend_object_value
+php_yaml_node_new (zend_class_entry *ce TSRMLS_DC)
+{
+  zend_object_value retval;
+  php_yaml_node *yn = ecalloc (1, sizeof (php_yaml_node));
+
+  zend_object_std_init (&yn->std, ce TSRMLS_CC);
+
+  retval.handle = zend_objects_store_put (yn, (zend_objects_store_dtor_t)zend_objects_destroy_object,
+                                          php_yaml_node_free, NULL TSRMLS_CC);
+  retval.handlers = &php_yaml_node_handlers;
+  return retval;
+}
+/* }}} */
+
+/* {{{ php_yaml_node_get ()
+ * The YamlNode of this, with its entries and keys looked up.
+ */
+static php_yaml_node *
+php_yaml_node_get (zval *object TSRMLS_DC)
+{
+  php_yaml_node *yn = (php_yaml_node *)zend_object_store_get_object (object TSRMLS_CC);
+  php_yaml_lazy_tree *tree = yn->tree;
+  php_yaml_lazy_node *node;
+  size_t count, i, child;
+
+  if (tree == NULL)
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "YamlNode is not part of a document");
+      return NULL;
+    }
+  if (yn->entries != NULL)
+    return yn;
+
+  node = &tree->nodes[yn->node];
+  count = node->type == Y_LAZY_MAPPING ? node->count / 2 : node->count;
+  yn->entries = (size_t *)safe_emalloc (count + 1, sizeof (size_t), 0);
+  for (i = 0, child = yn->node + 1; i < count; i++)
+    {
+      yn->entries[i] = child;
+      child = tree->nodes[child].next;
+      if (node->type == Y_LAZY_MAPPING)
+        child = tree->nodes[child].next;
+    }
+
+  if (node->type == Y_LAZY_MAPPING)
+    {
+      HashTable shared;
+      int ok = 1;
+
+      ALLOC_HASHTABLE (yn->keys);
+      zend_hash_init (yn->keys, (uint)count, NULL, NULL, 0);
+      zend_hash_init (&shared, 0, NULL, ZVAL_PTR_DTOR, 0);
+      for (i = 0; ok && i < count; i++)
+        {
+          char *key = php_yaml_lazy_key (tree, yn->entries[i], &shared TSRMLS_CC);
+
+          if (key == NULL)
+            ok = 0;
+          else
+            {
+              zend_symtable_update (yn->keys, key, strlen (key) + 1,
+                                    &i, sizeof (size_t), NULL);
+              efree (key);
+            }
+        }
+      zend_hash_destroy (&shared);
+
+      if (!ok)
+        {
+          efree (yn->entries);
+          yn->entries = NULL;
+          zend_hash_destroy (yn->keys);
+          FREE_HASHTABLE (yn->keys);
+          yn->keys = NULL;
+          return NULL;
+        }
+    }
+  return yn;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_index_of ()
+ * Whether str is a key an array would make an integer, as sequences
+ * have no others.
+ */
+static int
+php_yaml_lazy_index_of (const char *str, size_t length, long *index)
+{
+  if (length == 0 || length > 18 || strspn (str, "0123456789") < length ||
+      (str[0] == '0' && length > 1))
+    return 0;
+  *index = strtol (str, NULL, 10);
+  return 1;
+}
+/* }}} */
+
+/* {{{ php_yaml_node_find ()
+ * The node of the value at offset, with array offset semantics.
+ */
+static int
+php_yaml_node_find (php_yaml_node *yn, zval *offset, size_t *index TSRMLS_DC)
+{
+  php_yaml_lazy_node *node = &yn->tree->nodes[yn->node];
+  size_t *entry = NULL;
+  long lval;
+
+  switch (Z_TYPE_P (offset))
+    {
+    case IS_STRING:
+      if (node->type == Y_LAZY_MAPPING)
+        {
+          if (zend_symtable_find (yn->keys, Z_STRVAL_P (offset), Z_STRLEN_P (offset) + 1,
+                                  (void **)&entry) == FAILURE)
+            return FAILURE;
+          *index = yn->tree->nodes[yn->entries[*entry]].next;
+          return SUCCESS;
+        }
+      if (!php_yaml_lazy_index_of (Z_STRVAL_P (offset), Z_STRLEN_P (offset), &lval))
+        return FAILURE;
+      break;
+    case IS_NULL:
+      if (node->type == Y_LAZY_MAPPING &&
+          zend_hash_find (yn->keys, "", 1, (void **)&entry) == SUCCESS)
+        {
+          *index = yn->tree->nodes[yn->entries[*entry]].next;
+          return SUCCESS;
+        }
+      return FAILURE;
+    case IS_DOUBLE:
+      lval = (long)Z_DVAL_P (offset);
+      break;
+    case IS_LONG:
+    case IS_BOOL:
+    case IS_RESOURCE:
+      lval = Z_LVAL_P (offset);
+      break;
+    default:
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "Illegal offset type");
+      return FAILURE;
+    }
+
+  if (node->type == Y_LAZY_MAPPING)
+    {
+      if (zend_hash_index_find (yn->keys, (ulong)lval, (void **)&entry) == FAILURE)
+        return FAILURE;
+      *index = yn->tree->nodes[yn->entries[*entry]].next;
+      return SUCCESS;
+    }
+  if (lval < 0 || (size_t)lval >= node->count)
+    return FAILURE;
+  *index = yn->entries[lval];
+  return SUCCESS;
+}
+/* }}} */
+
+/* {{{ proto YamlNode::__construct ()
+   Only yaml_parse_lazy() makes YamlNode objects */
+PHP_METHOD (YamlNode, __construct)
+{
+}
+/* }}} */
+
+/* {{{ proto bool YamlNode::offsetExists (mixed offset) */
+PHP_METHOD (YamlNode, offsetExists)
+{
+  php_yaml_node *yn;
+  zval *offset = NULL;
+  size_t index;
+
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "z", &offset) == FAILURE)
+    return;
+
+  php_yaml_lazy_begin (TSRMLS_C);
+  yn = php_yaml_node_get (getThis () TSRMLS_CC);
+  php_yaml_lazy_end (TSRMLS_C);
+
+  RETURN_BOOL (yn != NULL && php_yaml_node_find (yn, offset, &index TSRMLS_CC) == SUCCESS);
+}
+/* }}} */
+
+/* {{{ proto mixed YamlNode::offsetGet (mixed offset)
+   The value at offset; a YamlNode for a collection */
+PHP_METHOD (YamlNode, offsetGet)
+{
+  php_yaml_node *yn;
+  zval *offset = NULL;
+  zval *value = NULL;
+  size_t index;
+
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "z", &offset) == FAILURE)
+    return;
+
+  php_yaml_lazy_begin (TSRMLS_C);
+  if ((yn = php_yaml_node_get (getThis () TSRMLS_CC)) != NULL)
+    {
+      if (php_yaml_node_find (yn, offset, &index TSRMLS_CC) == SUCCESS)
+        value = php_yaml_lazy_value (yn->tree, index TSRMLS_CC);
+      else if (Z_TYPE_P (offset) == IS_STRING)
+        php_error_docref (NULL TSRMLS_CC, E_NOTICE, "Undefined index: %s", Z_STRVAL_P (offset));
+      else if (Z_TYPE_P (offset) == IS_LONG)
+        php_error_docref (NULL TSRMLS_CC, E_NOTICE, "Undefined offset: %ld", Z_LVAL_P (offset));
+    }
+  php_yaml_lazy_end (TSRMLS_C);
+
+  if (value == NULL)
+    {
+      RETURN_NULL ();
+    }
+  RETURN_ZVAL (value, 1, 1);
+}
+/* }}} */
+
+/* {{{ proto void YamlNode::offsetSet (mixed offset, mixed value) */
+PHP_METHOD (YamlNode, offsetSet)
+{
+  php_error_docref (NULL TSRMLS_CC, E_WARNING, "YamlNode is read-only");
+}
+/* }}} */
+
+/* {{{ proto void YamlNode::offsetUnset (mixed offset) */
+PHP_METHOD (YamlNode, offsetUnset)
+{
+  php_error_docref (NULL TSRMLS_CC, E_WARNING, "YamlNode is read-only");
+}
+/* }}} */
+
+/* {{{ proto int YamlNode::count () */
+PHP_METHOD (YamlNode, count)
+{
+  php_yaml_node *yn;
+
+  php_yaml_lazy_begin (TSRMLS_C);
+  yn = php_yaml_node_get (getThis () TSRMLS_CC);
+  php_yaml_lazy_end (TSRMLS_C);
+
+  if (yn == NULL)
+    {
+      RETURN_LONG (0);
+    }
+  if (yn->keys != NULL)
+    {
+      RETURN_LONG (zend_hash_num_elements (yn->keys));
+    }
+  RETURN_LONG ((long)yn->tree->nodes[yn->node].count);
+}
+/* }}} */
+
+/* {{{ php_yaml_node_entries ()
+ * Adds the entries of yn to array as php_yaml_lazy_value() gives them.
+ */
+static int
+php_yaml_node_entries (php_yaml_node *yn, zval *array TSRMLS_DC)
+{
+  php_yaml_lazy_tree *tree = yn->tree;
+  php_yaml_lazy_node *node = &tree->nodes[yn->node];
+  size_t count = node->type == Y_LAZY_MAPPING ? node->count / 2 : node->count;
+  HashTable shared;
+  int ok = 1;
+  size_t i;
+
+  zend_hash_init (&shared, 0, NULL, ZVAL_PTR_DTOR, 0);
+  for (i = 0; ok && i < count; i++)
+    {
+      size_t child = yn->entries[i];
+      char *key = NULL;
+      zval *value = NULL;
+
+      if (node->type == Y_LAZY_MAPPING)
+        {
+          if ((key = php_yaml_lazy_key (tree, child, &shared TSRMLS_CC)) == NULL)
+            {
+              ok = 0;
+              break;
+            }
+          child = tree->nodes[child].next;
+        }
+
+      if ((value = php_yaml_lazy_value (tree, child TSRMLS_CC)) == NULL)
+        ok = 0;
+      else if (key != NULL)
+        add_assoc_zval (array, key, value);
+      else
+        add_next_index_zval (array, value);
+
+      if (key != NULL)
+        efree (key);
+    }
+  zend_hash_destroy (&shared);
+
+  return ok ? SUCCESS : FAILURE;
+}
+/* }}} */
+
+/* {{{ proto ArrayIterator YamlNode::getIterator ()
+   Iterates the entries, with collections as YamlNode objects */
+PHP_METHOD (YamlNode, getIterator)
+{
+  php_yaml_node *yn;
+  zval *entries = NULL;
+
+  MAKE_STD_ZVAL (entries);
+  array_init (entries);
+
+  php_yaml_lazy_begin (TSRMLS_C);
+  if ((yn = php_yaml_node_get (getThis () TSRMLS_CC)) != NULL)
+    {
+      /* what could be read before an error is iterated */
+      (void)php_yaml_node_entries (yn, entries TSRMLS_CC);
+    }
+  php_yaml_lazy_end (TSRMLS_C);
+
+  object_init_ex (return_value, spl_ce_ArrayIterator);
+  zend_call_method_with_1_params (&return_value, spl_ce_ArrayIterator,
+                                  &spl_ce_ArrayIterator->constructor, "__construct", NULL, entries);
+  zval_ptr_dtor (&entries);
+}
+/* }}} */
+
+/* {{{ proto array YamlNode::toArray ()
+   All of the node as yaml_parse() would give it */
+PHP_METHOD (YamlNode, toArray)
+{
+  php_yaml_node *yn = (php_yaml_node *)zend_object_store_get_object (getThis () TSRMLS_CC);
+  HashTable shared;
+  zval *retval;
+
+  if (yn->tree == NULL)
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "YamlNode is not part of a document");
+      RETURN_FALSE;
+    }
+
+  php_yaml_lazy_begin (TSRMLS_C);
+  zend_hash_init (&shared, 0, NULL, ZVAL_PTR_DTOR, 0);
+  retval = php_yaml_lazy_materialize (yn->tree, yn->node, &shared TSRMLS_CC);
+  zend_hash_destroy (&shared);
+  php_yaml_lazy_end (TSRMLS_C);
+
+  if (retval == NULL)
+    {
+      RETURN_FALSE;
+    }
+  RETURN_ZVAL (retval, 1, 1);
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_step ()
+ * Moves index to the entry of the collection at index that has key,
+ * or the index key stands for in a sequence.
+ */
+static int
+php_yaml_lazy_step (php_yaml_lazy_tree *tree, size_t *index, const char *key,
+                    size_t length, HashTable *shared TSRMLS_DC)
+{
+  php_yaml_lazy_node *node;
+  size_t i, child, found = 0;
+  ulong hash;
+  long n;
+
+  if (tree->nodes[*index].type == Y_LAZY_ALIAS)
+    *index = tree->nodes[*index].value;
+  node = &tree->nodes[*index];
+
+  if (node->type == Y_LAZY_SEQUENCE)
+    {
+      if (!php_yaml_lazy_index_of (key, length, &n) || (size_t)n >= node->count)
+        return FAILURE;
+      for (child = *index + 1; n > 0; n--)
+        child = tree->nodes[child].next;
+      *index = child;
+      return SUCCESS;
+    }
+  if (node->type != Y_LAZY_MAPPING)
+    return FAILURE;
+
+  /* the last of equal keys wins, as in an array */
+  hash = zend_inline_hash_func (key, (uint)length);
+  for (i = 0, child = *index + 1; i < node->count; i += 2)
+    {
+      php_yaml_lazy_node *k = &tree->nodes[child];
+      size_t value = k->next;
+
+      if (k->type == Y_LAZY_ALIAS && !(k->flags & Y_LAZY_RECURSIVE))
+        k = &tree->nodes[k->value];
+
+      if (k->type == Y_LAZY_SCALAR && (k->flags & Y_LAZY_KEY))
+        {
+          if (k->count == hash && k->length == length &&
+              memcmp (tree->data.c + k->value, key, length) == 0)
+            found = value;
+        }
+      else
+        {
+          char *str = php_yaml_lazy_key (tree, child, shared TSRMLS_CC);
+
+          if (str != NULL)
+            {
+              if (strlen (str) == length && memcmp (str, key, length) == 0)
+                found = value;
+              efree (str);
+            }
+        }
+      child = tree->nodes[value].next;
+    }
+
+  if (found == 0)
+    return FAILURE;
+  *index = found;
+  return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_document_find ()
+ * The node at path: mapping keys separated by ".", "[n]" for entry n
+ * of a sequence, or an array of the keys and indexes one by one for
+ * keys with those characters in them. An empty path is the root.
+ */
+static int
+php_yaml_document_find (php_yaml_lazy_tree *tree, zval *path, size_t *index TSRMLS_DC)
+{
+  HashTable shared;
+  int ok = SUCCESS;
+
+  *index = 0;
+  zend_hash_init (&shared, 0, NULL, ZVAL_PTR_DTOR, 0);
+
+  if (Z_TYPE_P (path) == IS_ARRAY)
+    {
+      HashPosition hpos;
+      zval **segment;
+
+      for (zend_hash_internal_pointer_reset_ex (Z_ARRVAL_P (path), &hpos);
+           ok == SUCCESS &&
+           zend_hash_get_current_data_ex (Z_ARRVAL_P (path), (void **)&segment, &hpos) == SUCCESS;
+           zend_hash_move_forward_ex (Z_ARRVAL_P (path), &hpos))
+        {
+          zval copy = **segment;
+
+          zval_copy_ctor (&copy);
+          convert_to_string (&copy);
+          ok = php_yaml_lazy_step (tree, index, Z_STRVAL (copy), Z_STRLEN (copy),
+                                   &shared TSRMLS_CC);
+          zval_dtor (&copy);
+        }
+    }
+  else
+    {
+      zval copy = *path;
+      const char *p, *end;
+
+      zval_copy_ctor (&copy);
+      convert_to_string (&copy);
+      p = Z_STRVAL (copy);
+      end = p + Z_STRLEN (copy);
+
+      while (ok == SUCCESS && p < end)
+        {
+          const char *q;
+
+          if (*p == '[')
+            {
+              if ((q = memchr (p, ']', end - p)) == NULL)
+                {
+                  php_error_docref (NULL TSRMLS_CC, E_WARNING, "Malformed path %s", Z_STRVAL (copy));
+                  ok = FAILURE;
+                  break;
+                }
+              ok = php_yaml_lazy_step (tree, index, p + 1, q - p - 1, &shared TSRMLS_CC);
+              p = q + 1;
+            }
+          else
+            {
+              for (q = p; q < end && *q != '.' && *q != '['; q++)
+                ;
+              ok = php_yaml_lazy_step (tree, index, p, q - p, &shared TSRMLS_CC);
+              p = q;
+            }
+          if (p < end && *p == '.')
+            p++;
+        }
+      zval_dtor (&copy);
+    }
+
+  zend_hash_destroy (&shared);
+  if (ok == SUCCESS && tree->nodes[*index].type == Y_LAZY_ALIAS)
+    *index = tree->nodes[*index].value;
+  return ok;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_check ()
+ * Whether the nodes of an unserialized tree are consistent, so that no
+ * offset leads out of it. Redoes what the nodes needn't be trusted
+ * with, the key hashes and which aliases are recursive.
+ */
+static int
+php_yaml_lazy_check (php_yaml_lazy_tree *tree)
+{
+  const char *data = tree->data.c;
+  size_t length = tree->data.len;
+  size_t i, k, child;
+
+  if (tree->count == 0 || tree->nodes[0].next != tree->count)
+    return FAILURE;
+
+  for (i = 0; i < tree->count; i++)
+    {
+      php_yaml_lazy_node *node = &tree->nodes[i];
+
+      if (node->tag != Y_LAZY_NO_TAG &&
+          (node->tag >= length || memchr (data + node->tag, '\0', length - node->tag) == NULL))
+        return FAILURE;
+
+      switch (node->type)
+        {
+        case Y_LAZY_SCALAR:
+          if (node->next != i + 1 || node->value >= length ||
+              node->length >= length - node->value || data[node->value + node->length] != '\0')
+            return FAILURE;
+          if (node->flags & Y_LAZY_KEY)
+            node->count = zend_inline_hash_func (data + node->value, (uint)node->length);
+          break;
+
+        case Y_LAZY_ALIAS:
+          if (node->next != i + 1 || node->value >= i ||
+              tree->nodes[node->value].type == Y_LAZY_ALIAS)
+            return FAILURE;
+          node->flags &= ~Y_LAZY_RECURSIVE;
+          if (tree->nodes[node->value].next > i)
+            node->flags |= Y_LAZY_RECURSIVE;
+          break;
+
+        case Y_LAZY_SEQUENCE:
+        case Y_LAZY_MAPPING:
+          if (node->next <= i || node->next > tree->count ||
+              (node->type == Y_LAZY_MAPPING && node->count % 2 != 0))
+            return FAILURE;
+          for (k = 0, child = i + 1; k < node->count; k++)
+            {
+              if (child >= node->next || tree->nodes[child].next <= child)
+                return FAILURE;
+              child = tree->nodes[child].next;
+            }
+          if (child != node->next)
+            return FAILURE;
+          break;
+
+        default:
+          return FAILURE;
+        }
+    }
+  return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_lazy_document ()
+ * Sets return_value to a YamlDocument over document pos of source.
+ */
+int
+php_yaml_lazy_document (php_yaml_source *source, long pos, zval *callbacks,
+                        zval *return_value TSRMLS_DC)
+{
+  php_yaml_lazy_tree *tree = php_yaml_lazy_load (source, pos, callbacks TSRMLS_CC);
+  php_yaml_document *doc;
+
+  if (tree == NULL)
+    return FAILURE;
+
+  object_init_ex (return_value, php_yaml_document_ce);
+  doc = (php_yaml_document *)zend_object_store_get_object (return_value TSRMLS_CC);
+  doc->tree = tree;
+  return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_document_free () */
+static void
+php_yaml_document_free (void *object TSRMLS_DC)
+{
+  php_yaml_document *doc = (php_yaml_document *)object;
+
+  if (doc->tree != NULL)
+    php_yaml_lazy_free (doc->tree TSRMLS_CC);
+  zend_object_std_dtor (&doc->std TSRMLS_CC);
+  efree (doc);
+}
+/* }}} */
+
+/* {{{ php_yaml_document_new () */
+static zend_object_value
+php_yaml_document_new (zend_class_entry *ce TSRMLS_DC)
+{
+  zend_object_value retval;
+  php_yaml_document *doc = ecalloc (1, sizeof (php_yaml_document));
+
+  zend_object_std_init (&doc->std, ce TSRMLS_CC);
+
+  retval.handle = zend_objects_store_put (doc, (zend_objects_store_dtor_t)zend_objects_destroy_object,
+                                          php_yaml_document_free, NULL TSRMLS_CC);
+  retval.handlers = &php_yaml_node_handlers;
+  return retval;
+}
+/* }}} */
+
+/* {{{ php_yaml_document_tree () */
+static php_yaml_lazy_tree *
+php_yaml_document_tree (zval *object TSRMLS_DC)
+{
+  php_yaml_document *doc = (php_yaml_document *)zend_object_store_get_object (object TSRMLS_CC);
+
+  if (doc->tree == NULL)
+    php_error_docref (NULL TSRMLS_CC, E_WARNING, "YamlDocument holds no document");
+  return doc->tree;
+}
+/* }}} */
+
+/* {{{ proto YamlDocument::__construct ()
+   Only yaml_parse_document() and unserialize() make YamlDocument objects */
+PHP_METHOD (YamlDocument, __construct)
+{
+}
+/* }}} */
+
+/* {{{ proto mixed YamlDocument::get (mixed path[, mixed default])
+   The value at path, a YamlNode for a collection; default if there is none */
+PHP_METHOD (YamlDocument, get)
+{
+  php_yaml_lazy_tree *tree;
+  zval *path = NULL;
+  zval *def = NULL;
+  zval *value = NULL;
+  size_t index;
+
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "z|z", &path, &def) == FAILURE)
+    return;
+  if ((tree = php_yaml_document_tree (getThis () TSRMLS_CC)) == NULL)
+    return;
+
+  php_yaml_lazy_begin (TSRMLS_C);
+  if (php_yaml_document_find (tree, path, &index TSRMLS_CC) == SUCCESS)
+    value = php_yaml_lazy_value (tree, index TSRMLS_CC);
+  php_yaml_lazy_end (TSRMLS_C);
+
+  if (value != NULL)
+    {
+      RETURN_ZVAL (value, 1, 1);
+    }
+  if (def != NULL)
+    {
+      RETURN_ZVAL (def, 1, 0);
+    }
+}
+/* }}} */
+
+/* {{{ proto bool YamlDocument::exists (mixed path) */
+PHP_METHOD (YamlDocument, exists)
+{
+  php_yaml_lazy_tree *tree;
+  zval *path = NULL;
+  size_t index;
+  int ok;
+
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "z", &path) == FAILURE)
+    return;
+  if ((tree = php_yaml_document_tree (getThis () TSRMLS_CC)) == NULL)
+    RETURN_FALSE;
+
+  php_yaml_lazy_begin (TSRMLS_C);
+  ok = php_yaml_document_find (tree, path, &index TSRMLS_CC);
+  php_yaml_lazy_end (TSRMLS_C);
+
+  RETURN_BOOL (ok == SUCCESS);
+}
+/* }}} */
+
+/* {{{ proto int YamlDocument::count ([mixed path])
+   Entries of the collection at path, 1 for a scalar, 0 if there is none */
+PHP_METHOD (YamlDocument, count)
+{
+  php_yaml_lazy_tree *tree;
+  php_yaml_lazy_node *node;
+  zval *path = NULL;
+  size_t index = 0;
+
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "|z", &path) == FAILURE)
+    return;
+  if ((tree = php_yaml_document_tree (getThis () TSRMLS_CC)) == NULL)
+    RETURN_LONG (0);
+
+  if (path != NULL)
+    {
+      int ok;
+
+      php_yaml_lazy_begin (TSRMLS_C);
+      ok = php_yaml_document_find (tree, path, &index TSRMLS_CC);
+      php_yaml_lazy_end (TSRMLS_C);
+      if (ok == FAILURE)
+        RETURN_LONG (0);
+    }
+
+  node = &tree->nodes[index];
+  if (node->type == Y_LAZY_SCALAR)
+    RETURN_LONG (1);
+  RETURN_LONG ((long)(node->type == Y_LAZY_MAPPING ? node->count / 2 : node->count));
+}
+/* }}} */
+
+/* {{{ proto string YamlDocument::serialize () */
+PHP_METHOD (YamlDocument, serialize)
+{
+  php_yaml_lazy_tree *tree;
+  php_yaml_document_header header;
+  smart_str buf = {0};
+
+  if ((tree = php_yaml_document_tree (getThis () TSRMLS_CC)) == NULL)
+    RETURN_NULL ();
+
+  memset (&header, 0, sizeof (php_yaml_document_header));
+  memcpy (header.magic, Y_DOCUMENT_MAGIC, sizeof (header.magic));
+  header.version = Y_DOCUMENT_VERSION;
+  header.node_size = (unsigned char)sizeof (php_yaml_lazy_node);
+  header.byte_order = 0x0102;
+  header.count = tree->count;
+  header.length = tree->data.len;
+
+  smart_str_appendl (&buf, (char *)&header, sizeof (php_yaml_document_header));
+  smart_str_appendl (&buf, (char *)tree->nodes, tree->count * sizeof (php_yaml_lazy_node));
+  smart_str_appendl (&buf, tree->data.c, tree->data.len);
+  smart_str_0 (&buf);
+
+  RETURN_STRINGL (buf.c, buf.len, 0);
+}
+/* }}} */
+
+/* {{{ proto void YamlDocument::unserialize (string serialized)
+   Tag callbacks are not kept, the values come out as without them */
+PHP_METHOD (YamlDocument, unserialize)
+{
+  php_yaml_document *doc = (php_yaml_document *)zend_object_store_get_object (getThis () TSRMLS_CC);
+  php_yaml_document_header header;
+  php_yaml_lazy_tree *tree;
+  char *str = NULL;
+  int str_len = 0;
+  size_t length;
+
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s", &str, &str_len) == FAILURE)
+    return;
+
+  if (doc->tree != NULL)
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "YamlDocument already holds a document");
+      return;
+    }
+
+  length = (size_t)str_len;
+  if (length < sizeof (php_yaml_document_header) ||
+      memcmp (str, Y_DOCUMENT_MAGIC, sizeof (header.magic)) != 0)
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "Not a serialized YamlDocument");
+      return;
+    }
+  memcpy (&header, str, sizeof (php_yaml_document_header));
+  if (header.version != Y_DOCUMENT_VERSION ||
+      header.node_size != sizeof (php_yaml_lazy_node) || header.byte_order != 0x0102)
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING,
+                        "YamlDocument was serialized by another version or platform");
+      return;
+    }
+  length -= sizeof (php_yaml_document_header);
+  if (header.count > length / sizeof (php_yaml_lazy_node) ||
+      header.length != length - header.count * sizeof (php_yaml_lazy_node))
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "Serialized YamlDocument is truncated");
+      return;
+    }
+
+  tree = ecalloc (1, sizeof (php_yaml_lazy_tree));
+  tree->refcount = 1;
+  tree->count = tree->size = header.count;
+  tree->nodes = (php_yaml_lazy_node *)safe_emalloc (header.count, sizeof (php_yaml_lazy_node), 0);
+  memcpy (tree->nodes, str + sizeof (php_yaml_document_header),
+          header.count * sizeof (php_yaml_lazy_node));
+  tree->data.c = emalloc (header.length + 1);
+  memcpy (tree->data.c, str + str_len - header.length, header.length);
+  tree->data.c[header.length] = '\0';
+  tree->data.len = header.length;
+  tree->data.a = header.length + 1;
+
+  if (php_yaml_lazy_check (tree) == FAILURE)
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "Serialized YamlDocument is corrupt");
+      php_yaml_lazy_free (tree TSRMLS_CC);
+      return;
+    }
+  doc->tree = tree;
+}
+/* }}} */
+
+/* {{{ argument information */
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_node_offset, 0, 0, 1)
+  ZEND_ARG_INFO (0, offset)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_node_offset_set, 0, 0, 2)
+  ZEND_ARG_INFO (0, offset)
+  ZEND_ARG_INFO (0, value)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_document_get, 0, 0, 1)
+  ZEND_ARG_INFO (0, path)
+  ZEND_ARG_INFO (0, default)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_document_path, 0, 0, 1)
+  ZEND_ARG_INFO (0, path)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_document_count, 0, 0, 0)
+  ZEND_ARG_INFO (0, path)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_document_unserialize, 0, 0, 1)
+  ZEND_ARG_INFO (0, serialized)
+  ZEND_END_ARG_INFO ()
+/* }}} */
+
+/* {{{ php_yaml_node_methods[] */
+static zend_function_entry php_yaml_node_methods[] = {
+  PHP_ME (YamlNode, __construct,  NULL,                          ZEND_ACC_PRIVATE | ZEND_ACC_CTOR)
+  PHP_ME (YamlNode, offsetExists, arginfo_yaml_node_offset,      ZEND_ACC_PUBLIC)
+  PHP_ME (YamlNode, offsetGet,    arginfo_yaml_node_offset,      ZEND_ACC_PUBLIC)
+  PHP_ME (YamlNode, offsetSet,    arginfo_yaml_node_offset_set,  ZEND_ACC_PUBLIC)
+  PHP_ME (YamlNode, offsetUnset,  arginfo_yaml_node_offset,      ZEND_ACC_PUBLIC)
+  PHP_ME (YamlNode, count,        NULL,                          ZEND_ACC_PUBLIC)
+  PHP_ME (YamlNode, getIterator,  NULL,                          ZEND_ACC_PUBLIC)
+  PHP_ME (YamlNode, toArray,      NULL,                          ZEND_ACC_PUBLIC)
+  { NULL, NULL, NULL }
+};
+/* }}} */
+
+/* {{{ php_yaml_document_methods[] */
+static zend_function_entry php_yaml_document_methods[] = {
+  PHP_ME (YamlDocument, __construct, NULL,                               ZEND_ACC_PRIVATE | ZEND_ACC_CTOR)
+  PHP_ME (YamlDocument, get,         arginfo_yaml_document_get,          ZEND_ACC_PUBLIC)
+  PHP_ME (YamlDocument, exists,      arginfo_yaml_document_path,         ZEND_ACC_PUBLIC)
+  PHP_ME (YamlDocument, count,       arginfo_yaml_document_count,        ZEND_ACC_PUBLIC)
+  PHP_ME (YamlDocument, serialize,   NULL,                               ZEND_ACC_PUBLIC)
+  PHP_ME (YamlDocument, unserialize, arginfo_yaml_document_unserialize,  ZEND_ACC_PUBLIC)
+  { NULL, NULL, NULL }
+};
+/* }}} */
+
+/* {{{ php_yaml_lazy_register () */
+void
+php_yaml_lazy_register (TSRMLS_D)
+{
+  zend_class_entry ce;
+
+  INIT_CLASS_ENTRY (ce, "YamlNode", php_yaml_node_methods);
+  ce.create_object = php_yaml_node_new;
+  php_yaml_node_ce = zend_register_internal_class (&ce TSRMLS_CC);
+  php_yaml_node_ce->ce_flags |= ZEND_ACC_FINAL_CLASS;
+  php_yaml_node_ce->serialize = zend_class_serialize_deny;
+  php_yaml_node_ce->unserialize = zend_class_unserialize_deny;
+  zend_class_implements (php_yaml_node_ce TSRMLS_CC, 3,
+                         zend_ce_arrayaccess, zend_ce_aggregate, spl_ce_Countable);
+
+  INIT_CLASS_ENTRY (ce, "YamlDocument", php_yaml_document_methods);
+  ce.create_object = php_yaml_document_new;
+  php_yaml_document_ce = zend_register_internal_class (&ce TSRMLS_CC);
+  php_yaml_document_ce->ce_flags |= ZEND_ACC_FINAL_CLASS;
+  zend_class_implements (php_yaml_document_ce TSRMLS_CC, 2,
+                         spl_ce_Countable, zend_ce_serializable);
+
+  /* the tree is immutable and shared, there is nothing to clone */
+  memcpy (&php_yaml_node_handlers, zend_get_std_object_handlers (), sizeof (zend_object_handlers));
+  php_yaml_node_handlers.clone_obj = NULL;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: noet sw=4 ts=4 fdm=marker
+ * vim<600: noet sw=4 ts=4
+ */
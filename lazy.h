@@ -0,0 +1,78 @@
+#ifndef LAZY_H
+#define LAZY_H
+
+/* {{{ lazy tree
+ * A document as a flat array of nodes in document order: a collection
+ * is followed by the nodes of its entries, keys and values alternating
+ * in a mapping. The scalars and tags are in data, each terminated by a
+ * NUL; a tag is stored once however often it is used. Shared by all
+ * the YamlNode objects over the document; see lazy.c.
+ */
+#define Y_LAZY_SCALAR   0
+#define Y_LAZY_SEQUENCE 1
+#define Y_LAZY_MAPPING  2
+#define Y_LAZY_ALIAS    3
+
+#define Y_LAZY_PLAIN_IMPLICIT  0x01
+#define Y_LAZY_QUOTED_IMPLICIT 0x02
+#define Y_LAZY_IMPLICIT        0x04  /* collection without a tag */
+#define Y_LAZY_KEY             0x08  /* scalar read as a mapping key */
+#define Y_LAZY_ANCHOR          0x10
+#define Y_LAZY_RECURSIVE       0x20  /* alias inside the node it refers to */
+
+#define Y_LAZY_NO_TAG ((size_t)-1)
+
+typedef struct _php_yaml_lazy_node {
+  unsigned char type;
+  unsigned char flags;
+  unsigned char style;
+  size_t count;   /* nodes directly below a collection, keys included;
+                     hash of the text of a scalar read as a key */
+  size_t next;    /* node after the subtree, 0 while it is being read */
+  size_t value;   /* offset of a scalar in data, node an alias refers to */
+  size_t length;
+  size_t tag;     /* offset in data or Y_LAZY_NO_TAG */
+} php_yaml_lazy_node;
+
+typedef struct _php_yaml_lazy_tree {
+  int refcount;
+  php_yaml_lazy_node *nodes;
+  size_t count;
+  size_t size;
+  smart_str data;
+  zval *callbacks;
+} php_yaml_lazy_tree;
+
+int
+php_yaml_lazy_read (php_yaml_source *source, long pos, zval *callbacks,
+                    zval *return_value TSRMLS_DC);
+
+int
+php_yaml_lazy_document (php_yaml_source *source, long pos, zval *callbacks,
+                        zval *return_value TSRMLS_DC);
+/* }}} */
+
+/* {{{ serialized YamlDocument
+ * The header, then the nodes and data of the tree as they are in
+ * memory, so it only loads where node layout and byte order match.
+ */
+#define Y_DOCUMENT_MAGIC   "YDOC"
+#define Y_DOCUMENT_VERSION 1
+
+typedef struct _php_yaml_document_header {
+  char magic[4];
+  unsigned char version;
+  unsigned char node_size;     /* sizeof (php_yaml_lazy_node) */
+  unsigned short byte_order;   /* 0x0102 as written */
+  size_t count;
+  size_t length;
+} php_yaml_document_header;
+/* }}} */
+
+extern zend_class_entry *php_yaml_node_ce;
+extern zend_class_entry *php_yaml_document_ce;
+
+void
+php_yaml_lazy_register (TSRMLS_D);
+
+#endif
@@ -0,0 +1,873 @@
+/**
+ * Parallel parsing and emission
+ *
+ * This file is part of php-yaml.
+ * php-yaml is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * php-yaml is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with php-yaml.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The input is cut into slices at "---" lines in column 0, which LibYAML
+ * always takes as document starts, whatever context it is in. Workers
+ * run one LibYAML parser per slice and record the events in malloc()ed
+ * lists; the calling thread turns the lists into zvals in input order
+ * while later slices are still being parsed.
+ *
+ * A single document with a large top-level mapping can also be cut, at
+ * keys in column 0. Unlike document starts these cuts may be wrong, so
+ * the slices are checked before their events are joined into one list.
+ *
+ * Emission works the other way around: the entries of a large top-level
+ * collection are snapshot as events in chunks on the calling thread,
+ * then rendered into separate buffers by the workers and written out in
+ * order.
+ *
+ * @package     php-yaml
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <php.h>
+#include <php_ini.h>
+#include <yaml.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_YAML_THREADS
+#include <pthread.h>
+#endif
+#include "php_yaml.h"
+#include "parser.h"
+#include "parallel.h"
+
+/* {{{ worker pool */
+struct _php_yaml_pool {
+	php_yaml_task_func_t func;
+	char *tasks;
+	size_t task_size;
+	size_t ntasks;
+	size_t next;        /* next task to start */
+	size_t released;    /* tasks released by the consumer */
+	size_t window;
+	int cancelled;
+	unsigned char *done;
+	int nthreads;
+#ifdef HAVE_YAML_THREADS
+	pthread_t *threads;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+#endif
+};
+
+#define PHP_YAML_TASK(pool, i) ((void *)((pool)->tasks + (i) * (pool)->task_size))
+
+#ifdef HAVE_YAML_THREADS
+/* {{{ php_yaml_pool_worker() */
+static void *
+php_yaml_pool_worker(void *arg)
+{
+	php_yaml_pool *pool = (php_yaml_pool *)arg;
+	size_t i;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->cancelled && pool->next < pool->ntasks &&
+				pool->next >= pool->released + pool->window) {
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		}
+		if (pool->cancelled || pool->next >= pool->ntasks) {
+			break;
+		}
+		i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		pool->func(PHP_YAML_TASK(pool, i));
+
+		pthread_mutex_lock(&pool->lock);
+		pool->done[i] = 1;
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+/* }}} */
+#endif
+
+/* {{{ php_yaml_pool_start()
+ * Returns NULL if out of memory. Falls back to running tasks inline if
+ * no thread can be created.
+ */
+php_yaml_pool *
+php_yaml_pool_start(php_yaml_task_func_t func, void *tasks, size_t task_size,
+		size_t ntasks, int nthreads, size_t window)
+{
+	php_yaml_pool *pool = calloc(1, sizeof(php_yaml_pool));
+
+	if (pool == NULL) {
+		return NULL;
+	}
+	if ((pool->done = calloc(ntasks ? ntasks : 1, 1)) == NULL) {
+		free(pool);
+		return NULL;
+	}
+	pool->func = func;
+	pool->tasks = (char *)tasks;
+	pool->task_size = task_size;
+	pool->ntasks = ntasks;
+	pool->window = window ? window : ntasks;
+
+	if (nthreads > Y_PARALLEL_MAX_THREADS) {
+		nthreads = Y_PARALLEL_MAX_THREADS;
+	}
+	if ((size_t)nthreads > ntasks) {
+		nthreads = (int)ntasks;
+	}
+
+#ifdef HAVE_YAML_THREADS
+	if (nthreads > 0 && (pool->threads = calloc(nthreads, sizeof(pthread_t))) != NULL) {
+		pthread_mutex_init(&pool->lock, NULL);
+		pthread_cond_init(&pool->cond, NULL);
+		while (pool->nthreads < nthreads &&
+				pthread_create(&pool->threads[pool->nthreads], NULL,
+					php_yaml_pool_worker, pool) == 0)
+		{
+			pool->nthreads++;
+		}
+	}
+#endif
+
+	return pool;
+}
+/* }}} */
+
+/* {{{ php_yaml_pool_wait()
+ * Waits until task i is done and returns it.
+ */
+void *
+php_yaml_pool_wait(php_yaml_pool *pool, size_t i)
+{
+#ifdef HAVE_YAML_THREADS
+	if (pool->nthreads > 0) {
+		pthread_mutex_lock(&pool->lock);
+		while (!pool->done[i]) {
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		}
+		pthread_mutex_unlock(&pool->lock);
+		return PHP_YAML_TASK(pool, i);
+	}
+#endif
+
+	if (!pool->done[i]) {
+		pool->func(PHP_YAML_TASK(pool, i));
+		pool->done[i] = 1;
+	}
+	return PHP_YAML_TASK(pool, i);
+}
+/* }}} */
+
+/* {{{ php_yaml_pool_release()
+ * Tells the workers that the consumer is through with tasks up to i.
+ */
+void
+php_yaml_pool_release(php_yaml_pool *pool, size_t i)
+{
+#ifdef HAVE_YAML_THREADS
+	if (pool->nthreads > 0) {
+		pthread_mutex_lock(&pool->lock);
+		pool->released = i + 1;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+#endif
+
+	pool->released = i + 1;
+}
+/* }}} */
+
+/* {{{ php_yaml_pool_finish()
+ * Cancels the tasks not started yet, joins the workers and frees the
+ * pool. The tasks themselves belong to the caller.
+ */
+void
+php_yaml_pool_finish(php_yaml_pool *pool)
+{
+#ifdef HAVE_YAML_THREADS
+	int i;
+
+	if (pool->threads != NULL) {
+		pthread_mutex_lock(&pool->lock);
+		pool->cancelled = 1;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+
+		for (i = 0; i < pool->nthreads; i++) {
+			pthread_join(pool->threads[i], NULL);
+		}
+		pthread_cond_destroy(&pool->cond);
+		pthread_mutex_destroy(&pool->lock);
+		free(pool->threads);
+	}
+#endif
+
+	free(pool->done);
+	free(pool);
+}
+/* }}} */
+/* }}} */
+
+/* {{{ slices */
+/* {{{ php_yaml_parse_slice()
+ * Task function, runs on a worker.
+ */
+void
+php_yaml_parse_slice(void *task)
+{
+	php_yaml_slice *slice = (php_yaml_slice *)task;
+	yaml_parser_t parser;
+	double start = php_yaml_clock();
+
+	if (slice->fp == NULL && slice->input == NULL) {
+		return;
+	}
+	if (!yaml_parser_initialize(&parser)) {
+		slice->events.error.error = YAML_MEMORY_ERROR;
+		return;
+	}
+	if (slice->fp != NULL) {
+		yaml_parser_set_input_file(&parser, slice->fp);
+	} else {
+		yaml_parser_set_input_string(&parser, slice->input + slice->offset, slice->length);
+	}
+	php_yaml_record_events(&parser, &slice->events, slice->offset, slice->line);
+	yaml_parser_delete(&parser);
+
+	slice->time = php_yaml_clock() - start;
+}
+/* }}} */
+
+/* {{{ php_yaml_read_slice()
+ * Turns the events of a parsed slice into zvals, like
+ * php_yaml_read_all() or php_yaml_read_partial() would.
+ */
+zval *
+php_yaml_read_slice(php_yaml_slice *slice, long pos, long *ndocs,
+		eval_scalar_func_t eval_func, HashTable *callbacks TSRMLS_DC)
+{
+	php_yaml_source source = {NULL, NULL, 0};
+	zval *retval;
+
+	source.list = &slice->events;
+	if (YAML_G(collect_timings)) {
+		YAML_G(stats).time_libyaml += slice->time;
+	}
+
+	if (pos < 0) {
+		retval = php_yaml_read_all(&source, ndocs, eval_func, callbacks);
+	} else {
+		retval = php_yaml_read_partial(&source, pos, ndocs, eval_func, callbacks TSRMLS_CC);
+	}
+
+	php_yaml_event_list_free(&slice->events);
+
+	return retval;
+}
+/* }}} */
+
+/* {{{ php_yaml_split_documents()
+ * Cuts input into slices of whole documents, each at least slice_size
+ * bytes long but the last. Returns the number of slices, 0 if the input
+ * can't be cut safely: UTF-16, or directives past the first line, since
+ * these belong to the document that follows.
+ */
+static size_t
+php_yaml_split_documents(const unsigned char *input, size_t length,
+		size_t slice_size, php_yaml_slice **slices_p)
+{
+	php_yaml_slice *slices = NULL;
+	size_t count = 0, size = 0;
+	size_t start = 0, start_line = 0, line = 0, p = 0;
+	const unsigned char *eol;
+
+	if (length >= 2 && ((input[0] == 0xFE && input[1] == 0xFF) ||
+			(input[0] == 0xFF && input[1] == 0xFE)))
+	{
+		return 0;
+	}
+
+	for (;;) {
+		/* p is at the start of a line */
+		if (input[p] == '%' && p > 0) {
+			free(slices);
+			return 0;
+		}
+
+		if (p - start >= slice_size && p + 3 <= length &&
+				input[p] == '-' && input[p + 1] == '-' && input[p + 2] == '-' &&
+				(p + 3 == length || input[p + 3] == ' ' || input[p + 3] == '\t' ||
+				 input[p + 3] == '\r' || input[p + 3] == '\n'))
+		{
+			if (count + 1 >= size) {
+				php_yaml_slice *tmp;
+
+				size = size ? size * 2 : 64;
+				if ((tmp = realloc(slices, size * sizeof(php_yaml_slice))) == NULL) {
+					free(slices);
+					return 0;
+				}
+				slices = tmp;
+			}
+			memset(&slices[count], 0, sizeof(php_yaml_slice));
+			slices[count].input = input;
+			slices[count].offset = start;
+			slices[count].length = p - start;
+			slices[count].line = start_line;
+			count++;
+
+			start = p;
+			start_line = line;
+		}
+
+		if ((eol = memchr(input + p, '\n', length - p)) == NULL) {
+			break;
+		}
+		line++;
+		p = eol - input + 1;
+		if (p == length) {
+			break;
+		}
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	/* the split always left room for the last slice */
+	memset(&slices[count], 0, sizeof(php_yaml_slice));
+	slices[count].input = input;
+	slices[count].offset = start;
+	slices[count].length = length - start;
+	slices[count].line = start_line;
+	count++;
+
+	*slices_p = slices;
+	return count;
+}
+/* }}} */
+
+/* {{{ php_yaml_split_mapping()
+ * Cuts a single document into slices of at least slice_size bytes, at
+ * lines in column 0 that look like the start of a top-level key. Returns
+ * the number of slices, 0 if the input is UTF-16 or holds more than one
+ * document.
+ */
+static size_t
+php_yaml_split_mapping(const unsigned char *input, size_t length,
+		size_t slice_size, php_yaml_slice **slices_p)
+{
+	php_yaml_slice *slices = NULL;
+	size_t count = 0, size = 0;
+	size_t start = 0, start_line = 0, line = 0, p = 0;
+	int seen_key = 0, seen_start = 0;
+	const unsigned char *eol;
+	unsigned char c;
+
+	if (length >= 2 && ((input[0] == 0xFE && input[1] == 0xFF) ||
+			(input[0] == 0xFF && input[1] == 0xFE)))
+	{
+		return 0;
+	}
+
+	for (;;) {
+		/* p is at the start of a line */
+		c = input[p];
+		if (p + 3 <= length && (c == '-' || c == '.') &&
+				input[p + 1] == c && input[p + 2] == c &&
+				(p + 3 == length || input[p + 3] == ' ' || input[p + 3] == '\t' ||
+				 input[p + 3] == '\r' || input[p + 3] == '\n'))
+		{
+			/* one document start before the mapping, no other markers */
+			if (c == '.' || seen_key || seen_start) {
+				free(slices);
+				return 0;
+			}
+			seen_start = 1;
+		} else if (c == '%' && (seen_key || seen_start)) {
+			free(slices);
+			return 0;
+		} else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+				(c >= '0' && c <= '9') || c == '_' || c == '"' || c == '\'' || c >= 0x80)
+		{
+			if (seen_key && p - start >= slice_size) {
+				if (count + 1 >= size) {
+					php_yaml_slice *tmp;
+
+					size = size ? size * 2 : 64;
+					if ((tmp = realloc(slices, size * sizeof(php_yaml_slice))) == NULL) {
+						free(slices);
+						return 0;
+					}
+					slices = tmp;
+				}
+				memset(&slices[count], 0, sizeof(php_yaml_slice));
+				slices[count].input = input;
+				slices[count].offset = start;
+				slices[count].length = p - start;
+				slices[count].line = start_line;
+				count++;
+
+				start = p;
+				start_line = line;
+			}
+			seen_key = 1;
+		}
+
+		if ((eol = memchr(input + p, '\n', length - p)) == NULL) {
+			break;
+		}
+		line++;
+		p = eol - input + 1;
+		if (p == length) {
+			break;
+		}
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	memset(&slices[count], 0, sizeof(php_yaml_slice));
+	slices[count].input = input;
+	slices[count].offset = start;
+	slices[count].length = length - start;
+	slices[count].line = start_line;
+	count++;
+
+	*slices_p = slices;
+	return count;
+}
+/* }}} */
+/* }}} */
+
+/* {{{ chunks */
+/* {{{ php_yaml_chunk_add()
+ * Appends event to chunk, which takes it over. Returns 0 if out of
+ * memory; the event is deleted then.
+ */
+int
+php_yaml_chunk_add(php_yaml_chunk *chunk, yaml_event_t *event)
+{
+	if (chunk->count == chunk->size) {
+		size_t size = chunk->size ? chunk->size * 2 : 256;
+		yaml_event_t *events = realloc(chunk->events, size * sizeof(yaml_event_t));
+
+		if (events == NULL) {
+			yaml_event_delete(event);
+			return 0;
+		}
+		chunk->events = events;
+		chunk->size = size;
+	}
+
+	chunk->events[chunk->count++] = *event;
+	return 1;
+}
+/* }}} */
+
+/* {{{ php_yaml_chunk_write() */
+static int
+php_yaml_chunk_write(void *data, unsigned char *buffer, size_t size)
+{
+	php_yaml_chunk *chunk = (php_yaml_chunk *)data;
+
+	if (chunk->length + size > chunk->capacity) {
+		size_t capacity = chunk->capacity ? chunk->capacity : 64 * 1024;
+		unsigned char *output;
+
+		while (capacity < chunk->length + size) {
+			capacity *= 2;
+		}
+		if ((output = realloc(chunk->output, capacity)) == NULL) {
+			return 0;
+		}
+		chunk->output = output;
+		chunk->capacity = capacity;
+	}
+
+	memcpy(chunk->output + chunk->length, buffer, size);
+	chunk->length += size;
+	return 1;
+}
+/* }}} */
+
+/* {{{ php_yaml_emit_chunk()
+ * Task function, runs on a worker.
+ */
+void
+php_yaml_emit_chunk(void *task)
+{
+	php_yaml_chunk *chunk = (php_yaml_chunk *)task;
+	yaml_emitter_t emitter;
+	double start = php_yaml_clock();
+	size_t i;
+
+	if (!yaml_emitter_initialize(&emitter)) {
+		chunk->error = YAML_MEMORY_ERROR;
+		return;
+	}
+	yaml_emitter_set_output(&emitter, php_yaml_chunk_write, chunk);
+	yaml_emitter_set_canonical(&emitter, chunk->config->canonical);
+	yaml_emitter_set_indent(&emitter, chunk->config->best_indent);
+	yaml_emitter_set_width(&emitter, chunk->config->best_width);
+	yaml_emitter_set_unicode(&emitter, chunk->config->unicode);
+	yaml_emitter_set_break(&emitter, chunk->config->line_break);
+
+	for (i = 0; i < chunk->count; i++) {
+		yaml_event_t event = chunk->events[i];
+
+		/* the emitter owns the event now */
+		memset(&chunk->events[i], 0, sizeof(yaml_event_t));
+		if (!yaml_emitter_emit(&emitter, &event)) {
+			chunk->error = emitter.error;
+			chunk->problem = emitter.problem;
+			break;
+		}
+	}
+	yaml_emitter_delete(&emitter);
+
+	chunk->time = php_yaml_clock() - start;
+}
+/* }}} */
+
+/* {{{ php_yaml_chunk_free()
+ * Frees the events and output of chunk, keeping its settings.
+ */
+void
+php_yaml_chunk_free(php_yaml_chunk *chunk)
+{
+	size_t i;
+
+	for (i = 0; i < chunk->count; i++) {
+		yaml_event_delete(&chunk->events[i]);
+	}
+	free(chunk->events);
+	free(chunk->output);
+	chunk->events = NULL;
+	chunk->output = NULL;
+	chunk->count = chunk->size = 0;
+	chunk->length = chunk->capacity = 0;
+	chunk->error = YAML_NO_ERROR;
+	chunk->problem = NULL;
+	chunk->time = 0;
+}
+/* }}} */
+/* }}} */
+
+/* {{{ php_yaml_cpu_count()
+ * Number of online processors, 1 if unknown.
+ */
+int
+php_yaml_cpu_count(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (n > 0) {
+		return n > Y_PARALLEL_MAX_THREADS ? Y_PARALLEL_MAX_THREADS : (int)n;
+	}
+#endif
+	return 1;
+}
+/* }}} */
+
+/* {{{ php_yaml_read_serial() */
+static zval *
+php_yaml_read_serial(const unsigned char *input, size_t length, long pos, long *ndocs,
+		eval_scalar_func_t eval_func, HashTable *callbacks TSRMLS_DC)
+{
+	yaml_parser_t parser = {0};
+	php_yaml_source source = {NULL, NULL, 0};
+	zval *retval;
+
+	yaml_parser_initialize(&parser);
+	yaml_parser_set_input_string(&parser, input, length);
+	source.parser = &parser;
+
+	if (pos < 0) {
+		retval = php_yaml_read_all(&source, ndocs, eval_func, callbacks);
+	} else {
+		retval = php_yaml_read_partial(&source, pos, ndocs, eval_func, callbacks TSRMLS_CC);
+	}
+
+	yaml_parser_delete(&parser);
+
+	return retval;
+}
+/* }}} */
+
+/* {{{ php_yaml_check_mapping_slice()
+ * Whether the events of a slice cut by php_yaml_split_mapping() are
+ * what a serial parse would have produced for that part of the input:
+ * one document holding one block mapping, and for all slices but the
+ * first, nothing a cut could have changed the meaning of.
+ */
+static int
+php_yaml_check_mapping_slice(php_yaml_slice *slice, int first, int last)
+{
+	yaml_event_t *events = slice->events.events;
+	size_t n = slice->events.count, i;
+
+	if (slice->events.error.error != YAML_NO_ERROR || n < 6 ||
+			events[1].type != YAML_DOCUMENT_START_EVENT ||
+			events[2].type != YAML_MAPPING_START_EVENT ||
+			events[2].data.mapping_start.style != YAML_BLOCK_MAPPING_STYLE ||
+			events[n - 3].type != YAML_MAPPING_END_EVENT ||
+			events[n - 2].type != YAML_DOCUMENT_END_EVENT)
+	{
+		return 0;
+	}
+
+	/* %TAG handles are only known to the first slice */
+	if (events[1].data.document_start.tag_directives.start !=
+			events[1].data.document_start.tag_directives.end)
+	{
+		return 0;
+	}
+	if (!first && (!events[1].data.document_start.implicit ||
+				events[1].data.document_start.version_directive != NULL ||
+				events[2].data.mapping_start.anchor != NULL ||
+				events[2].data.mapping_start.tag != NULL))
+	{
+		return 0;
+	}
+	if (!last && !events[n - 2].data.document_end.implicit) {
+		return 0;
+	}
+
+	/* a second document means the mapping ended early */
+	for (i = 3; i < n - 3; i++) {
+		if (events[i].type == YAML_DOCUMENT_START_EVENT) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+/* }}} */
+
+/* {{{ php_yaml_merge_mapping_slices()
+ * Appends the mapping entries of the other slices to the events of the
+ * first one, leaving a single stream.
+ */
+static int
+php_yaml_merge_mapping_slices(php_yaml_slice *slices, size_t nslices)
+{
+	php_yaml_event_list *list = &slices[0].events;
+	size_t total = list->count, i, j;
+	yaml_event_t *events;
+	unsigned char *hints;
+
+	for (i = 1; i < nslices; i++) {
+		total += slices[i].events.count;
+	}
+	if ((events = realloc(list->events, total * sizeof(yaml_event_t))) == NULL) {
+		return FAILURE;
+	}
+	list->events = events;
+	if ((hints = realloc(list->hints, total)) == NULL) {
+		return FAILURE;
+	}
+	list->hints = hints;
+	list->size = total;
+
+	for (i = 1; i < nslices; i++) {
+		php_yaml_event_list *next = &slices[i].events;
+		size_t n = next->count;
+
+		/* drop the mapping, document and stream ends of the list so far
+		   and the starts of the next one */
+		for (j = list->count - 3; j < list->count; j++) {
+			yaml_event_delete(&list->events[j]);
+		}
+		list->count -= 3;
+		for (j = 0; j < 3; j++) {
+			yaml_event_delete(&next->events[j]);
+		}
+
+		memcpy(list->events + list->count, next->events + 3, (n - 3) * sizeof(yaml_event_t));
+		memcpy(list->hints + list->count, next->hints + 3, n - 3);
+		list->count += n - 3;
+
+		/* the events are owned by the merged list now */
+		free(next->events);
+		free(next->hints);
+		next->events = NULL;
+		next->hints = NULL;
+		next->count = next->size = 0;
+	}
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_read_mapping()
+ * Parses a single document whose top level is a block mapping by
+ * cutting it at keys in column 0 and parsing the slices on nthreads
+ * workers. The cuts are speculative: if a slice does not come out as a
+ * plain run of mapping entries, a cut went through a flow collection, a
+ * quoted scalar or the like, and FAILURE is returned for the caller to
+ * parse the input serially. Anchors and aliases may cross slices, they
+ * are only resolved once the events are merged.
+ */
+static int
+php_yaml_read_mapping(const unsigned char *input, size_t length, long pos,
+		long *ndocs, int nthreads, eval_scalar_func_t eval_func,
+		HashTable *callbacks, zval **retval_p TSRMLS_DC)
+{
+	php_yaml_slice *slices = NULL;
+	php_yaml_pool *pool;
+	size_t nslices, i;
+	double time = 0;
+	int ok = 1;
+
+	if ((nslices = php_yaml_split_mapping(input, length,
+					Y_PARALLEL_SLICE_SIZE, &slices)) == 0)
+	{
+		return FAILURE;
+	}
+
+	pool = php_yaml_pool_start(php_yaml_parse_slice, slices, sizeof(php_yaml_slice),
+			nslices, nthreads, 0);
+	if (pool == NULL) {
+		free(slices);
+		return FAILURE;
+	}
+	for (i = 0; i < nslices; i++) {
+		php_yaml_slice *slice = (php_yaml_slice *)php_yaml_pool_wait(pool, i);
+
+		ok = ok && php_yaml_check_mapping_slice(slice, i == 0, i == nslices - 1);
+		time += slice->time;
+	}
+	php_yaml_pool_finish(pool);
+
+	if (ok && php_yaml_merge_mapping_slices(slices, nslices) == SUCCESS) {
+		slices[0].time = time;
+		*retval_p = php_yaml_read_slice(&slices[0], pos, ndocs, eval_func,
+				callbacks TSRMLS_CC);
+	} else {
+		ok = 0;
+	}
+
+	for (i = 0; i < nslices; i++) {
+		php_yaml_event_list_free(&slices[i].events);
+	}
+	free(slices);
+
+	return ok ? SUCCESS : FAILURE;
+}
+/* }}} */
+
+/* {{{ php_yaml_read_parallel()
+ * Like php_yaml_read_all() (pos -1) or php_yaml_read_partial() on a
+ * string parser, with the input parsed by nthreads workers: documents
+ * for pos -1, and the entries of a single top-level mapping if
+ * yaml.parse_split_mapping is on. Input that can't be split or is too
+ * small to be worth it is parsed serially.
+ */
+zval *
+php_yaml_read_parallel(const unsigned char *input, size_t length, long pos,
+		long *ndocs, int nthreads, eval_scalar_func_t eval_func,
+		HashTable *callbacks TSRMLS_DC)
+{
+	php_yaml_slice *slices = NULL;
+	php_yaml_pool *pool = NULL;
+	size_t nslices = 0, i;
+	zval *retval = NULL;
+	int ok = 1;
+
+	if (length > 0 && nthreads > 1 && pos < 0) {
+		nslices = php_yaml_split_documents(input, length, Y_PARALLEL_SLICE_SIZE, &slices);
+	}
+	if (nslices == 0) {
+		if (length > 0 && nthreads > 1 && pos <= 0 && YAML_G(parse_split_mapping) &&
+				php_yaml_read_mapping(input, length, pos, ndocs, nthreads,
+					eval_func, callbacks, &retval TSRMLS_CC) == SUCCESS)
+		{
+			return retval;
+		}
+		return php_yaml_read_serial(input, length, pos, ndocs, eval_func, callbacks TSRMLS_CC);
+	}
+
+	pool = php_yaml_pool_start(php_yaml_parse_slice, slices, sizeof(php_yaml_slice),
+			nslices, nthreads, 2 * (size_t)nthreads);
+	if (pool == NULL) {
+		free(slices);
+		return php_yaml_read_serial(input, length, pos, ndocs, eval_func, callbacks TSRMLS_CC);
+	}
+
+	MAKE_STD_ZVAL(retval);
+	array_init(retval);
+#ifdef IS_UNICODE
+	Z_ARRVAL_P(retval)->unicode = UG(unicode);
+#endif
+	YAML_G(stats).allocations++;
+
+	for (i = 0; i < nslices && ok; i++) {
+		php_yaml_slice *slice = (php_yaml_slice *)php_yaml_pool_wait(pool, i);
+		php_yaml_source source = {NULL, NULL, 0};
+
+		source.list = &slice->events;
+		if (YAML_G(collect_timings)) {
+			YAML_G(stats).time_libyaml += slice->time;
+		}
+
+		if (php_yaml_read_impl(&source, NULL, NULL, retval, ndocs,
+					eval_func, callbacks TSRMLS_CC) == NULL)
+		{
+			ok = 0;
+		}
+
+		php_yaml_event_list_free(&slice->events);
+		php_yaml_pool_release(pool, i);
+	}
+
+	php_yaml_pool_finish(pool);
+	for (i = 0; i < nslices; i++) {
+		php_yaml_event_list_free(&slices[i].events);
+	}
+	free(slices);
+
+	/* every slice has its own stream events */
+	YAML_G(stats).events[YAML_STREAM_START_EVENT] = 1;
+	YAML_G(stats).events[YAML_STREAM_END_EVENT] = ok;
+
+	if (!ok) {
+		zval_ptr_dtor(&retval);
+		return NULL;
+	}
+
+	return retval;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: noet sw=4 ts=4 fdm=marker
+ * vim<600: noet sw=4 ts=4
+ */
@@ -0,0 +1,100 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/* documents are handed to workers in slices of at least this many bytes */
+#define Y_PARALLEL_SLICE_SIZE   (512 * 1024)
+/* hard limit for yaml.parse_threads */
+#define Y_PARALLEL_MAX_THREADS  256
+
+/* {{{ worker pool
+ * Runs func on each of ntasks task structs of task_size bytes on up to
+ * nthreads native threads, in order of index. At most window tasks are
+ * started ahead of the last one released by the consumer, which bounds
+ * memory. Without thread support, tasks run inline on wait.
+ */
+typedef void (*php_yaml_task_func_t)(void *task);
+
+typedef struct _php_yaml_pool php_yaml_pool;
+
+php_yaml_pool *
+php_yaml_pool_start(php_yaml_task_func_t func, void *tasks, size_t task_size,
+		size_t ntasks, int nthreads, size_t window);
+
+void *
+php_yaml_pool_wait(php_yaml_pool *pool, size_t i);
+
+void
+php_yaml_pool_release(php_yaml_pool *pool, size_t i);
+
+void
+php_yaml_pool_finish(php_yaml_pool *pool);
+/* }}} */
+
+/* {{{ slices
+ * A piece of input parsed into events on a worker: a file, or length
+ * bytes from offset of input, starting at line line of the stream.
+ */
+typedef struct _php_yaml_slice {
+	FILE *fp;
+	const unsigned char *input;
+	size_t offset;
+	size_t length;
+	size_t line;
+	double time;
+	php_yaml_event_list events;
+} php_yaml_slice;
+
+void
+php_yaml_parse_slice(void *task);
+
+zval *
+php_yaml_read_slice(php_yaml_slice *slice, long pos, long *ndocs,
+		eval_scalar_func_t eval_func, HashTable *callbacks TSRMLS_DC);
+/* }}} */
+
+/* {{{ chunks
+ * A run of entries of a top-level collection, snapshot as a stream of
+ * events on the calling thread and rendered on a worker with the
+ * settings of config. The chunks of a collection, rendered one after
+ * another, give what a single emitter would have: the first has the
+ * document start, the last the document end.
+ */
+#define Y_PARALLEL_CHUNK_SIZE   4096  /* entries */
+
+typedef struct _php_yaml_chunk {
+	const yaml_emitter_t *config;
+	yaml_event_t *events;
+	size_t count;
+	size_t size;
+	unsigned char *output;
+	size_t length;
+	size_t capacity;
+	yaml_error_type_t error;
+	const char *problem;
+	double time;
+} php_yaml_chunk;
+
+int
+php_yaml_chunk_add(php_yaml_chunk *chunk, yaml_event_t *event);
+
+void
+php_yaml_emit_chunk(void *task);
+
+void
+php_yaml_chunk_free(php_yaml_chunk *chunk);
+/* }}} */
+
+int
+php_yaml_cpu_count(void);
+
+/* whether a call for document pos should go through php_yaml_read_parallel() */
+#define php_yaml_parallel_wanted(pos) \
+	(YAML_G(parse_threads) > 1 && \
+	 ((pos) < 0 || ((pos) == 0 && YAML_G(parse_split_mapping))))
+
+zval *
+php_yaml_read_parallel(const unsigned char *input, size_t length, long pos,
+		long *ndocs, int nthreads, eval_scalar_func_t eval_func,
+		HashTable *callbacks TSRMLS_DC);
+
+#endif
@@ -42,42 +42,801 @@
 #include "php_yaml.h"
 #include "zval_refcount.h" /* for PHP < 5.3 */
 #include "parser.h"
+#include "resolver.h"
+#include "probes.h"
 
 /* {{{ internal function prototypes */
-static char *
-php_yaml_convert_to_char(zval *zv TSRMLS_DC);
+static void
+php_yaml_rebase_mark(yaml_mark_t *mark, size_t offset, size_t line);
 
 static int
-php_yaml_apply_filter(zval **zpp, yaml_event_t event, HashTable *callbacks TSRMLS_DC);
+php_yaml_scalar_hint(yaml_event_t *event);
+
+static zval *
+php_yaml_eval(php_yaml_source *source, eval_scalar_func_t eval_func,
+		yaml_event_t event, HashTable *callbacks TSRMLS_DC);
+
+static zval *
+php_yaml_batch_callable(zval *entry);
 
 static int
-php_yaml_scalar_is_null(const char *value, size_t length, yaml_event_t event);
+php_yaml_find_callback(HashTable *callbacks, const char *tag,
+		zval **callable, php_yaml_callback **cached, int *batch TSRMLS_DC);
 
 static int
-php_yaml_scalar_is_bool(const char *value, size_t length, yaml_event_t event);
+php_yaml_call_batch(zval *callable, php_yaml_callback *cached, const char *tag,
+		zval *raw, zval **retval_ptr TSRMLS_DC);
 
 static int
-php_yaml_scalar_is_numeric(const char *value, size_t length,
-		long *lval, double *dval, char **str);
+php_yaml_call_batch_one(zval *callable, php_yaml_callback *cached, const char *tag,
+		zval *value, zval **retval_ptr TSRMLS_DC);
+
+static zval *
+php_yaml_batch_defer(php_yaml_source *source, yaml_event_t *event,
+		HashTable *callbacks TSRMLS_DC);
 
 static int
-php_yaml_scalar_is_timestamp(const char *value, size_t length);
+php_yaml_batch_flush(php_yaml_source *source TSRMLS_DC);
 
-static long
-php_yaml_eval_sexagesimal_l(long lval, char *sg, char *eos);
+static void
+php_yaml_batch_discard(php_yaml_source *source);
 
-static double
-php_yaml_eval_sexagesimal_d(double dval, char *sg, char *eos);
+static int
+php_yaml_has_filter(yaml_event_t *event, HashTable *callbacks);
+
+static int
+php_yaml_call_user_function(zval *func, php_yaml_callback *cached,
+		const char *tag, long size, zval **retval_ptr, int argc, zval **argv[] TSRMLS_DC);
+
+static char *
+php_yaml_convert_to_key(php_yaml_arena *arena, zval *zv TSRMLS_DC);
+
+static char *
+php_yaml_arena_strndup(php_yaml_arena *arena, const char *str, size_t length TSRMLS_DC);
+
+static void
+php_yaml_arena_release(php_yaml_arena *arena, char *ptr);
+
+static void
+php_yaml_arena_free(php_yaml_arena *arena);
+
+static void
+php_yaml_stage_push(php_yaml_stage *stage, char *key, zval *value);
+
+static void
+php_yaml_stage_flush(php_yaml_stage *stage, size_t base, zval *retval TSRMLS_DC);
+
+static void
+php_yaml_stage_discard(php_yaml_stage *stage, size_t base);
+
+static void
+php_yaml_stage_free(php_yaml_stage *stage);
+
+static void
+php_yaml_add_entry(php_yaml_source *source, yaml_event_t *parent,
+		zval *retval, zval *value);
+
+static void
+php_yaml_anchors_add(php_yaml_anchors *anchors, const char *name, zval *zv);
+
+static zval *
+php_yaml_anchors_find(php_yaml_anchors *anchors, const char *name);
+
+static void
+php_yaml_anchors_free(php_yaml_anchors *anchors);
+
+static void
+php_yaml_add_anchor(php_yaml_anchors *anchors, char *anchor, zval *zv TSRMLS_DC);
+
+static int
+php_yaml_scalar_is_null(const char *value, size_t length, yaml_event_t event);
+
+static int
+php_yaml_scalar_is_bool(const char *value, size_t length, yaml_event_t event);
 
 static int
 php_yaml_eval_timestamp(zval **zpp, char *ts, int ts_len TSRMLS_DC);
 
 static void
 php_yaml_print_parser_error (yaml_parser_t *parser TSRMLS_DC);
+
+static int
+php_yaml_check_limits(yaml_event_t *event TSRMLS_DC);
+/* }}} */
+
+/* {{{ php_yaml_next_event()
+ * yaml_parser_parse() or the next recorded event, plus error reporting,
+ * statistics and the limits of the call.
+ */
+int
+php_yaml_next_event(php_yaml_source *source, yaml_event_t *event TSRMLS_DC)
+{
+	yaml_parser_t *parser = source->parser;
+	double start = 0.0;
+	int ok;
+
+	if (source->list != NULL) {
+		php_yaml_event_list *list = source->list;
+
+		if (source->pos == list->count) {
+			php_yaml_print_parser_error(&list->error TSRMLS_CC);
+			return FAILURE;
+		}
+		*event = list->events[source->pos];
+		memset(&list->events[source->pos], 0, sizeof(yaml_event_t));
+		source->pos++;
+
+		YAML_G(stats).events[event->type]++;
+		YAML_G(stats).bytes = (long)event->end_mark.index;
+		return php_yaml_check_limits(event TSRMLS_CC);
+	}
+
+	if (YAML_G(collect_timings)) {
+		start = php_yaml_clock();
+	}
+	ok = yaml_parser_parse(parser, event);
+	if (YAML_G(collect_timings)) {
+		YAML_G(stats).time_libyaml += php_yaml_clock() - start;
+	}
+
+	if (!ok) {
+		php_yaml_print_parser_error(parser TSRMLS_CC);
+		return FAILURE;
+	}
+
+	YAML_G(stats).events[event->type]++;
+	YAML_G(stats).bytes = (long)parser->offset;
+	return php_yaml_check_limits(event TSRMLS_CC);
+}
+/* }}} */
+
+/* {{{ php_yaml_check_limits()
+ * Counts event against the limits of the call. An event over a limit
+ * is deleted, before anything is made of it.
+ */
+#define Y_LIMIT_ADD(field, n) \
+	((used->field += (n)) > max->field && max->field > 0)
+
+static int
+php_yaml_check_limits(yaml_event_t *event TSRMLS_DC)
+{
+	php_yaml_limits *max = &YAML_G(limits);
+	php_yaml_limits *used = &YAML_G(used);
+	const char *what = NULL;
+	long limit = 0;
+
+	switch (event->type) {
+	  case YAML_DOCUMENT_START_EVENT:
+		if (Y_LIMIT_ADD(documents, 1)) {
+			what = "documents";
+			limit = max->documents;
+		}
+		break;
+
+	  case YAML_SEQUENCE_START_EVENT:
+	  case YAML_MAPPING_START_EVENT:
+		if (Y_LIMIT_ADD(depth, 1)) {
+			what = "depth";
+			limit = max->depth;
+		} else if (Y_LIMIT_ADD(nodes, 1)) {
+			what = "nodes";
+			limit = max->nodes;
+		}
+		break;
+
+	  case YAML_SEQUENCE_END_EVENT:
+	  case YAML_MAPPING_END_EVENT:
+		used->depth--;
+		break;
+
+	  case YAML_SCALAR_EVENT:
+		if (Y_LIMIT_ADD(nodes, 1)) {
+			what = "nodes";
+			limit = max->nodes;
+		} else if (Y_LIMIT_ADD(scalar_bytes, (long)event->data.scalar.length)) {
+			what = "scalar_bytes";
+			limit = max->scalar_bytes;
+		}
+		break;
+
+	  case YAML_ALIAS_EVENT:
+		if (Y_LIMIT_ADD(nodes, 1)) {
+			what = "nodes";
+			limit = max->nodes;
+		} else if (Y_LIMIT_ADD(aliases, 1)) {
+			what = "aliases";
+			limit = max->aliases;
+		}
+		break;
+
+	  default:
+		break;
+	}
+
+	if (what == NULL) {
+		return SUCCESS;
+	}
+
+	php_error_docref(NULL TSRMLS_CC, E_WARNING,
+			"Limit max_%s of %ld exceeded at line %zu, column %zu", what, limit,
+			event->start_mark.line + 1, event->start_mark.column + 1);
+	yaml_event_delete(event);
+	return FAILURE;
+}
+
+#undef Y_LIMIT_ADD
+/* }}} */
+
+/* {{{ php_yaml_limits_read()
+ * The limits of a call from the yaml.max_* settings and options, an
+ * array that may override them by the same names without "yaml.".
+ */
+int
+php_yaml_limits_read(HashTable *options, php_yaml_limits *max TSRMLS_DC)
+{
+	static const char *names[] = {
+		"max_depth", "max_nodes", "max_scalar_bytes", "max_aliases", "max_documents"
+	};
+	long *fields[5];
+	zval **entry = NULL;
+	int i, found = 0;
+
+	max->depth = YAML_G(max_depth);
+	max->nodes = YAML_G(max_nodes);
+	max->scalar_bytes = YAML_G(max_scalar_bytes);
+	max->aliases = YAML_G(max_aliases);
+	max->documents = YAML_G(max_documents);
+
+	if (options == NULL) {
+		return SUCCESS;
+	}
+
+	fields[0] = &max->depth;
+	fields[1] = &max->nodes;
+	fields[2] = &max->scalar_bytes;
+	fields[3] = &max->aliases;
+	fields[4] = &max->documents;
+
+	for (i = 0; i < 5; i++) {
+		zval copy;
+
+#ifdef IS_UNICODE
+		if (zend_ascii_hash_find(options, (char *)names[i], strlen(names[i]) + 1,
+					(void **)&entry) == FAILURE) {
+#else
+		if (zend_hash_find(options, (char *)names[i], strlen(names[i]) + 1,
+					(void **)&entry) == FAILURE) {
+#endif
+			continue;
+		}
+		found++;
+
+		copy = **entry;
+		zval_copy_ctor(&copy);
+		convert_to_long(&copy);
+		if (Z_LVAL(copy) < 0) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING,
+					"Option '%s' must not be negative", names[i]);
+			return FAILURE;
+		}
+		*fields[i] = Z_LVAL(copy);
+	}
+
+	if (found != zend_hash_num_elements(options)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING,
+				"Unknown option, expected max_depth, max_nodes, max_scalar_bytes, "
+				"max_aliases or max_documents");
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_limits_begin()
+ * Applies max from here on, keeping the limits and counts of a call
+ * that is still going on, as when a callback parses, in saved.
+ */
+void
+php_yaml_limits_begin(const php_yaml_limits *max, php_yaml_limits_saved *saved TSRMLS_DC)
+{
+	saved->limits = YAML_G(limits);
+	saved->used = YAML_G(used);
+	YAML_G(limits) = *max;
+	memset(&YAML_G(used), 0, sizeof(php_yaml_limits));
+}
+/* }}} */
+
+/* {{{ php_yaml_limits_end() */
+void
+php_yaml_limits_end(const php_yaml_limits_saved *saved TSRMLS_DC)
+{
+	YAML_G(limits) = saved->limits;
+	YAML_G(used) = saved->used;
+}
+/* }}} */
+
+/* {{{ php_yaml_rebase_mark() */
+static void
+php_yaml_rebase_mark(yaml_mark_t *mark, size_t offset, size_t line)
+{
+	mark->index += offset;
+	mark->line += line;
+}
+/* }}} */
+
+/* {{{ php_yaml_record_events()
+ * Records all events of parser up to the end of the stream. Positions
+ * are moved by offset bytes and line lines, for input that starts in
+ * the middle of a larger stream. Uses no Zend API, so it may run on
+ * any thread.
+ */
+int
+php_yaml_record_events(yaml_parser_t *parser, php_yaml_event_list *list,
+		size_t offset, size_t line)
+{
+	yaml_event_t event;
+
+	do {
+		if (!yaml_parser_parse(parser, &event)) {
+			list->error.error = parser->error;
+			list->error.problem = parser->problem;
+			list->error.problem_offset = parser->problem_offset + offset;
+			list->error.problem_value = parser->problem_value;
+			list->error.problem_mark = parser->problem_mark;
+			list->error.context = parser->context;
+			list->error.context_mark = parser->context_mark;
+			php_yaml_rebase_mark(&list->error.problem_mark, offset, line);
+			php_yaml_rebase_mark(&list->error.context_mark, offset, line);
+			return FAILURE;
+		}
+
+		php_yaml_rebase_mark(&event.start_mark, offset, line);
+		php_yaml_rebase_mark(&event.end_mark, offset, line);
+		if (php_yaml_event_list_add(list, &event) == FAILURE) {
+			yaml_event_delete(&event);
+			return FAILURE;
+		}
+	} while (event.type != YAML_STREAM_END_EVENT);
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_event_list_add()
+ * Appends event to list, which takes it over on success.
+ */
+int
+php_yaml_event_list_add(php_yaml_event_list *list, yaml_event_t *event)
+{
+	if (list->count == list->size) {
+		size_t size = list->size ? list->size * 2 : 256;
+		yaml_event_t *events = realloc(list->events, size * sizeof(yaml_event_t));
+		unsigned char *hints;
+
+		if (events == NULL) {
+			list->error.error = YAML_MEMORY_ERROR;
+			return FAILURE;
+		}
+		list->events = events;
+		if ((hints = realloc(list->hints, size)) == NULL) {
+			list->error.error = YAML_MEMORY_ERROR;
+			return FAILURE;
+		}
+		list->hints = hints;
+		list->size = size;
+	}
+
+	list->hints[list->count] = event->type == YAML_SCALAR_EVENT ?
+		php_yaml_scalar_hint(event) : Y_HINT_NONE;
+	list->events[list->count++] = *event;
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_event_list_free()
+ * Frees the events not handed out yet.
+ */
+void
+php_yaml_event_list_free(php_yaml_event_list *list)
+{
+	size_t i;
+
+	for (i = 0; i < list->count; i++) {
+		yaml_event_delete(&list->events[i]);
+	}
+	free(list->events);
+	free(list->hints);
+	list->events = NULL;
+	list->hints = NULL;
+	list->count = list->size = 0;
+}
+/* }}} */
+
+/* {{{ php_yaml_scalar_hint()
+ * The checks of php_yaml_eval_scalar() that need no Zend API, done in
+ * advance for recorded events. Tagged scalars are left alone, they may
+ * have callbacks.
+ */
+static int
+php_yaml_scalar_hint(yaml_event_t *event)
+{
+	const char *value = (const char *)event->data.scalar.value;
+	size_t length = event->data.scalar.length;
+
+	if (!event->data.scalar.plain_implicit && !event->data.scalar.quoted_implicit) {
+		return Y_HINT_NONE;
+	}
+	if (php_yaml_scalar_is_null(value, length, *event) ||
+		php_yaml_scalar_is_bool(value, length, *event) != -1 ||
+		(!event->data.scalar.quoted_implicit &&
+		 php_yaml_scalar_may_be_numeric(value, length)) ||
+		php_yaml_scalar_is_timestamp(value, length))
+	{
+		return Y_HINT_NONE;
+	}
+
+	return Y_HINT_STRING;
+}
+/* }}} */
+
+/* {{{ php_yaml_eval() */
+static zval *
+php_yaml_eval(php_yaml_source *source, eval_scalar_func_t eval_func,
+		yaml_event_t event, HashTable *callbacks TSRMLS_DC)
+{
+	double start, callbacks_time;
+	zval *retval;
+
+	/* the hint belongs to the event handed out last */
+	if (source->list != NULL && source->list->hints[source->pos - 1] == Y_HINT_STRING) {
+		MAKE_STD_ZVAL(retval);
+#ifdef IS_UNICODE
+		ZVAL_U_STRINGL(UG(utf8_conv), retval, (char *)event.data.scalar.value,
+				event.data.scalar.length, ZSTR_DUPLICATE);
+#else
+		ZVAL_STRINGL(retval, (char *)event.data.scalar.value, event.data.scalar.length, 1);
+#endif
+		YAML_G(stats).allocations++;
+		YAML_G(stats).scalars[Y_STATS_STRING]++;
+		return retval;
+	}
+
+	if (callbacks != NULL && (retval = php_yaml_batch_defer(source, &event, callbacks TSRMLS_CC)) != NULL) {
+		return retval;
+	}
+
+	if (!YAML_G(collect_timings)) {
+		return eval_func(event, callbacks TSRMLS_CC);
+	}
+
+	start = php_yaml_clock();
+	callbacks_time = YAML_G(stats).time_callbacks;
+	retval = eval_func(event, callbacks TSRMLS_CC);
+	/* the callbacks it called have a time of their own */
+	YAML_G(stats).time_eval += php_yaml_clock() - start
+		- (YAML_G(stats).time_callbacks - callbacks_time);
+
+	return retval;
+}
+/* }}} */
+
+/* {{{ php_yaml_batch_callable()
+ * The callable of a batch callback, given as array('batch' => callable),
+ * or NULL for any other entry of the callbacks.
+ */
+static zval *
+php_yaml_batch_callable(zval *entry)
+{
+	zval **callable = NULL;
+
+	if (Z_TYPE_P(entry) != IS_ARRAY || zend_hash_num_elements(Z_ARRVAL_P(entry)) != 1) {
+		return NULL;
+	}
+#ifdef IS_UNICODE
+	if (zend_ascii_hash_find(Z_ARRVAL_P(entry), "batch", sizeof("batch"), (void **)&callable) == FAILURE) {
+#else
+	if (zend_hash_find(Z_ARRVAL_P(entry), "batch", sizeof("batch"), (void **)&callable) == FAILURE) {
+#endif
+		return NULL;
+	}
+	return *callable;
+}
+/* }}} */
+
+/* {{{ php_yaml_find_callback()
+ * The callback for tag in callbacks, its resolved form if a call has
+ * begun resolving callbacks and whether it is a batch callback;
+ * FAILURE if there is none.
+ */
+static int
+php_yaml_find_callback(HashTable *callbacks, const char *tag,
+		zval **callable, php_yaml_callback **cached, int *batch TSRMLS_DC)
+{
+	php_yaml_callbacks *resolved;
+	zval **entry = NULL;
+
+	*cached = NULL;
+	for (resolved = YAML_G(resolved_callbacks); resolved != NULL; resolved = resolved->next) {
+		if (resolved->callbacks == callbacks) {
+			if (zend_hash_find(&resolved->resolved, (char *)tag, strlen(tag) + 1,
+					(void **)cached) == FAILURE) {
+				return FAILURE;
+			}
+			*callable = (*cached)->callable;
+			*batch = (*cached)->batch;
+			return SUCCESS;
+		}
+	}
+
+	if (zend_hash_find(callbacks, (char *)tag, strlen(tag) + 1, (void **)&entry) == FAILURE) {
+		return FAILURE;
+	}
+	if ((*callable = php_yaml_batch_callable(*entry)) != NULL) {
+		*batch = 1;
+	} else {
+		*callable = *entry;
+		*batch = 0;
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_call_batch()
+ * Calls a batch callback with raw, an array; its return value must be
+ * an array too.
+ */
+static int
+php_yaml_call_batch(zval *callable, php_yaml_callback *cached, const char *tag,
+		zval *raw, zval **retval_ptr TSRMLS_DC)
+{
+	zval **argv[] = { &raw };
+
+	*retval_ptr = NULL;
+	if (php_yaml_call_user_function(callable, cached, tag,
+			zend_hash_num_elements(Z_ARRVAL_P(raw)), retval_ptr, 1, argv TSRMLS_CC) == FAILURE ||
+		*retval_ptr == NULL)
+	{
+		php_error_docref(NULL TSRMLS_CC, E_WARNING,
+				"Failed to apply batch callback for tag '%s'", tag);
+		return FAILURE;
+	}
+	if (Z_TYPE_PP(retval_ptr) != IS_ARRAY) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING,
+				"Batch callback for tag '%s' must return an array", tag);
+		zval_ptr_dtor(retval_ptr);
+		*retval_ptr = NULL;
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_yaml_call_batch_one()
+ * Calls a batch callback for value alone, where values can't be
+ * collected: collections, and scalars outside of a whole parse.
+ */
+static int
+php_yaml_call_batch_one(zval *callable, php_yaml_callback *cached, const char *tag,
+		zval *value, zval **retval_ptr TSRMLS_DC)
+{
+	zval *raw = NULL, *result = NULL;
+	zval **entry = NULL;
+	int ok = FAILURE;
+
+	MAKE_STD_ZVAL(raw);
+	array_init_size(raw, 1);
+	Z_ADDREF_P(value);
+	add_next_index_zval(raw, value);
+
+	*retval_ptr = NULL;
+	if (php_yaml_call_batch(callable, cached, tag, raw, &result TSRMLS_CC) == SUCCESS) {
+		if (zend_hash_index_find(Z_ARRVAL_P(result), 0, (void **)&entry) == SUCCESS) {
+			MAKE_STD_ZVAL(*retval_ptr);
+			ZVAL_ZVAL(*retval_ptr, *entry, 1, 0);
+			ok = SUCCESS;
+		} else {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING,
+					"Batch callback for tag '%s' returned no value for entry 0", tag);
+		}
+		zval_ptr_dtor(&result);
+	}
+	zval_ptr_dtor(&raw);
+
+	return ok;
+}
+/* }}} */
+
+/* {{{ batches */
+
+/* {{{ php_yaml_batch_dtor() */
+static void
+php_yaml_batch_dtor(void *data)
+{
+	php_yaml_batch *batch = (php_yaml_batch *)data;
+	size_t i;
+
+	for (i = 0; i < batch->count; i++) {
+		zval_ptr_dtor(&batch->values[i]);
+	}
+	if (batch->values != NULL) {
+		efree(batch->values);
+	}
+	zval_ptr_dtor(&batch->raw);
+	efree(batch->tag);
+}
+/* }}} */
+
+/* {{{ php_yaml_batch_defer()
+ * The null value standing in for the scalar of event until its batch
+ * callback is called, or NULL if its tag has no batch callback.
+ */
+static zval *
+php_yaml_batch_defer(php_yaml_source *source, yaml_event_t *event,
+		HashTable *callbacks TSRMLS_DC)
+{
+	const char *tag = (const char *)event->data.scalar.tag;
+	php_yaml_batch *batch = NULL;
+	php_yaml_callback *cached = NULL;
+	zval *callable = NULL;
+	zval *value;
+	int is_batch = 0;
+
+	if (tag == NULL || event->data.scalar.plain_implicit || event->data.scalar.quoted_implicit ||
+			php_yaml_find_callback(callbacks, tag, &callable, &cached, &is_batch TSRMLS_CC) == FAILURE ||
+			!is_batch) {
+		return NULL;
+	}
+
+	if (source->batches == NULL) {
+		ALLOC_HASHTABLE(source->batches);
+		zend_hash_init(source->batches, 0, NULL, php_yaml_batch_dtor, 0);
+	}
+	if (zend_hash_find(source->batches, (char *)tag, strlen(tag) + 1, (void **)&batch) == FAILURE) {
+		php_yaml_batch b;
+
+		memset(&b, 0, sizeof(php_yaml_batch));
+		b.tag = estrdup(tag);
+		b.callable = callable;
+		b.cached = cached;
+		MAKE_STD_ZVAL(b.raw);
+		array_init(b.raw);
+		zend_hash_add(source->batches, (char *)tag, strlen(tag) + 1, &b,
+				sizeof(php_yaml_batch), (void **)&batch);
+	}
+
+	if (batch->count == batch->size) {
+		batch->size = batch->size > 0 ? batch->size * 2 : Y_STAGE_MIN_SIZE;
+		batch->values = safe_erealloc(batch->values, batch->size, sizeof(zval *), 0);
+	}
+	add_next_index_stringl(batch->raw, (char *)event->data.scalar.value,
+			event->data.scalar.length, 1);
+
+	MAKE_STD_ZVAL(value);
+	ZVAL_NULL(value);
+	Z_ADDREF_P(value);
+	batch->values[batch->count++] = value;
+	YAML_G(stats).allocations++;
+
+	return value;
+}
+/* }}} */
+
+/* {{{ php_yaml_batch_flush()
+ * Calls the batch callbacks with the scalars held back and fills in
+ * their values.
+ */
+static int
+php_yaml_batch_flush(php_yaml_source *source TSRMLS_DC)
+{
+	HashPosition hpos;
+	php_yaml_batch *batch = NULL;
+	int ok = SUCCESS;
+
+	if (source->batches == NULL) {
+		return SUCCESS;
+	}
+
+	for (zend_hash_internal_pointer_reset_ex(source->batches, &hpos);
+			ok == SUCCESS &&
+			zend_hash_get_current_data_ex(source->batches, (void **)&batch, &hpos) == SUCCESS;
+			zend_hash_move_forward_ex(source->batches, &hpos)) {
+		zval *result = NULL;
+		zval **entry = NULL;
+		size_t i;
+
+		if (php_yaml_call_batch(batch->callable, batch->cached, batch->tag, batch->raw,
+				&result TSRMLS_CC) == FAILURE) {
+			ok = FAILURE;
+			break;
+		}
+
+		for (i = 0; i < batch->count; i++) {
+			if (zend_hash_index_find(Z_ARRVAL_P(result), (ulong)i, (void **)&entry) == FAILURE) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING,
+						"Batch callback for tag '%s' returned no value for entry %lu",
+						batch->tag, (unsigned long)i);
+				ok = FAILURE;
+				break;
+			}
+			/* in place, for the arrays and aliases that hold it */
+			ZVAL_ZVAL(batch->values[i], *entry, 1, 0);
+		}
+		zval_ptr_dtor(&result);
+	}
+
+	php_yaml_batch_discard(source);
+	return ok;
+}
+/* }}} */
+
+/* {{{ php_yaml_batch_discard() */
+static void
+php_yaml_batch_discard(php_yaml_source *source)
+{
+	if (source->batches != NULL) {
+		zend_hash_destroy(source->batches);
+		FREE_HASHTABLE(source->batches);
+		source->batches = NULL;
+	}
+}
+/* }}} */
+
+/* }}} */
+/* }}} */
+
+/* {{{ php_yaml_call_user_function()
+ * Calls a tag callback or timestamp decoder, through its resolved form
+ * cached if there is one. tag and size (length of the scalar or number
+ * of elements of the collection) only feed the probe.
+ */
+static int
+php_yaml_call_user_function(zval *func, php_yaml_callback *cached,
+		const char *tag, long size, zval **retval_ptr, int argc, zval **argv[] TSRMLS_DC)
+{
+	double start = 0.0, elapsed;
+	/* no clock for the probe unless a tracer is attached to it */
+	int timed = YAML_G(collect_timings) || YAML_PROBE_ENABLED(callback);
+	int result;
+
+	if (timed) {
+		start = php_yaml_clock();
+	}
+#ifdef Y_RESOLVE_CALLBACKS
+	if (cached != NULL && cached->fci.size != 0) {
+		/* copies, as the callback may parse with the same callbacks */
+		zend_fcall_info fci = cached->fci;
+		zend_fcall_info_cache fcc = cached->fcc;
+
+		fci.retval_ptr_ptr = retval_ptr;
+		fci.param_count = argc;
+		fci.params = argv;
+		/* separated for by-reference parameters, as call_user_function_ex() does */
+		fci.no_separation = 0;
+		result = zend_call_function(&fci, &fcc TSRMLS_CC);
+	} else {
+		result = call_user_function_ex(EG(function_table), NULL, func,
+				retval_ptr, argc, argv, 0, NULL TSRMLS_CC);
+	}
+#else
+	result = call_user_function_ex(EG(function_table), NULL, func,
+			retval_ptr, argc, argv, 0, NULL TSRMLS_CC);
+#endif
+	if (timed) {
+		elapsed = php_yaml_clock() - start;
+		if (YAML_G(collect_timings)) {
+			YAML_G(stats).time_callbacks += elapsed;
+		}
+		YAML_PROBE4(callback, tag, size,
+				result == SUCCESS && *retval_ptr != NULL, YAML_PROBE_NS(elapsed));
+	}
+
+	return result;
+}
 /* }}} */
 
 /* {{{ php_yaml_convert_to_char() */
-static char *
+char *
 php_yaml_convert_to_char(zval *zv TSRMLS_DC)
 {
 	char *str = NULL;
@@ -168,16 +927,332 @@ php_yaml_convert_to_char(zval *zv TSRMLS_DC)
 }
 /* }}} */
 
+/* {{{ php_yaml_convert_to_key()
+ * php_yaml_convert_to_char() for a mapping key, in the arena.
+ */
+static char *
+php_yaml_convert_to_key(php_yaml_arena *arena, zval *zv TSRMLS_DC)
+{
+	char *str = php_yaml_convert_to_char(zv TSRMLS_CC);
+	char *key;
+
+	if (str == NULL) {
+		return NULL;
+	}
+	key = php_yaml_arena_strndup(arena, str, strlen(str) TSRMLS_CC);
+	efree(str);
+	return key;
+}
+/* }}} */
+
+/* {{{ arena */
+struct _php_yaml_arena_block {
+	php_yaml_arena_block *prev;
+	size_t size;
+	size_t used;
+	char data[1];
+};
+
+/* {{{ php_yaml_arena_strndup() */
+static char *
+php_yaml_arena_strndup(php_yaml_arena *arena, const char *str, size_t length TSRMLS_DC)
+{
+	php_yaml_arena_block *block = arena->block;
+	char *ptr;
+
+	if (block == NULL || block->size - block->used < length + 1) {
+		if (arena->spare != NULL && arena->spare->size >= length + 1) {
+			block = arena->spare;
+			arena->spare = NULL;
+		} else {
+			size_t size = length + 1 > Y_ARENA_BLOCK_SIZE ? length + 1 : Y_ARENA_BLOCK_SIZE;
+
+			block = (php_yaml_arena_block *)emalloc(sizeof(php_yaml_arena_block) + size);
+			block->size = size;
+			YAML_G(stats).allocations++;
+		}
+		block->used = 0;
+		block->prev = arena->block;
+		arena->block = block;
+	}
+
+	ptr = block->data + block->used;
+	memcpy(ptr, str, length);
+	ptr[length] = '\0';
+	block->used += length + 1;
+	return ptr;
+}
+/* }}} */
+
+/* {{{ php_yaml_arena_release()
+ * Gives back ptr and everything allocated after it. Of the blocks that
+ * become empty, the largest is kept as a spare.
+ */
+static void
+php_yaml_arena_release(php_yaml_arena *arena, char *ptr)
+{
+	php_yaml_arena_block *block;
+
+	while ((block = arena->block) != NULL &&
+			(ptr < block->data || ptr >= block->data + block->size)) {
+		arena->block = block->prev;
+		if (arena->spare == NULL) {
+			arena->spare = block;
+		} else if (arena->spare->size < block->size) {
+			efree(arena->spare);
+			arena->spare = block;
+		} else {
+			efree(block);
+		}
+	}
+	if (block != NULL) {
+		block->used = ptr - block->data;
+	}
+}
+/* }}} */
+
+/* {{{ php_yaml_arena_free() */
+static void
+php_yaml_arena_free(php_yaml_arena *arena)
+{
+	php_yaml_arena_block *block;
+
+	while ((block = arena->block) != NULL) {
+		arena->block = block->prev;
+		efree(block);
+	}
+	if (arena->spare != NULL) {
+		efree(arena->spare);
+		arena->spare = NULL;
+	}
+}
+/* }}} */
+/* }}} */
+
+/* {{{ stage */
+
+/* {{{ php_yaml_stage_push() */
+static void
+php_yaml_stage_push(php_yaml_stage *stage, char *key, zval *value)
+{
+	if (stage->count == stage->size) {
+		stage->size = stage->size ? stage->size * 2 : 64;
+		stage->values = (zval **)erealloc(stage->values, stage->size * sizeof(zval *));
+		stage->keys = (char **)erealloc(stage->keys, stage->size * sizeof(char *));
+	}
+	stage->keys[stage->count] = key;
+	stage->values[stage->count++] = value;
+}
+/* }}} */
+
+/* {{{ php_yaml_stage_flush()
+ * Moves the entries from base on into the still empty array retval,
+ * sized for all of them at once.
+ */
+static void
+php_yaml_stage_flush(php_yaml_stage *stage, size_t base, zval *retval TSRMLS_DC)
+{
+	HashTable *ht = Z_ARRVAL_P(retval);
+	size_t i;
+
+	if (stage->count - base > Y_STAGE_MIN_SIZE && zend_hash_num_elements(ht) == 0) {
+		zend_hash_destroy(ht);
+		zend_hash_init(ht, (uint)(stage->count - base), NULL, ZVAL_PTR_DTOR, 0);
+#ifdef IS_UNICODE
+		ht->unicode = UG(unicode);
+#endif
+	}
+	for (i = base; i < stage->count; i++) {
+		if (stage->keys[i] != NULL) {
+			add_assoc_zval(retval, stage->keys[i], stage->values[i]);
+		} else {
+			add_next_index_zval(retval, stage->values[i]);
+		}
+	}
+	stage->count = base;
+}
+/* }}} */
+
+/* {{{ php_yaml_stage_discard() */
+static void
+php_yaml_stage_discard(php_yaml_stage *stage, size_t base)
+{
+	while (stage->count > base) {
+		zval_ptr_dtor(&stage->values[--stage->count]);
+	}
+}
+/* }}} */
+
+/* {{{ php_yaml_stage_free() */
+static void
+php_yaml_stage_free(php_yaml_stage *stage)
+{
+	php_yaml_stage_discard(stage, 0);
+	if (stage->values != NULL) {
+		efree(stage->values);
+		efree(stage->keys);
+	}
+	memset(stage, 0, sizeof(php_yaml_stage));
+}
+/* }}} */
+
+/* {{{ php_yaml_add_entry()
+ * Adds value to a sequence on the stage, or to any other parent, such
+ * as a document, directly.
+ */
+static void
+php_yaml_add_entry(php_yaml_source *source, yaml_event_t *parent,
+		zval *retval, zval *value)
+{
+	if (parent->type == YAML_SEQUENCE_START_EVENT) {
+		php_yaml_stage_push(&source->stage, NULL, value);
+	} else {
+		add_next_index_zval(retval, value);
+	}
+}
+/* }}} */
+/* }}} */
+
+/* {{{ anchors */
+
+/* {{{ php_yaml_anchors_slot()
+ * The slot of name, or the empty one where it would go.
+ */
+static php_yaml_anchor *
+php_yaml_anchors_slot(php_yaml_anchors *anchors, const char *name,
+		size_t length, ulong hash)
+{
+	size_t i = (size_t)hash & anchors->mask;
+
+	while (anchors->slots[i].value != NULL) {
+		php_yaml_anchor *slot = &anchors->slots[i];
+		if (slot->hash == hash && slot->length == length &&
+				memcmp(anchors->names + slot->name, name, length) == 0)
+		{
+			break;
+		}
+		i = (i + 1) & anchors->mask;
+	}
+	return &anchors->slots[i];
+}
+/* }}} */
+
+/* {{{ php_yaml_anchors_add()
+ * Takes over a reference to zv. An anchor defined again replaces the
+ * node it had.
+ */
+static void
+php_yaml_anchors_add(php_yaml_anchors *anchors, const char *name, zval *zv)
+{
+	size_t length = strlen(name);
+	ulong hash = zend_inline_hash_func(name, (uint)length);
+	php_yaml_anchor *slot;
+
+	if (anchors->slots == NULL || (anchors->count + 1) * 2 > anchors->mask + 1) {
+		php_yaml_anchor *old = anchors->slots;
+		size_t size = old == NULL ? Y_ANCHORS_MIN_SIZE : (anchors->mask + 1) * 2;
+		size_t i;
+
+		anchors->slots = (php_yaml_anchor *)ecalloc(size, sizeof(php_yaml_anchor));
+		anchors->mask = size - 1;
+		for (i = 0; old != NULL && i < size / 2; i++) {
+			if (old[i].value != NULL) {
+				*php_yaml_anchors_slot(anchors, anchors->names + old[i].name,
+						old[i].length, old[i].hash) = old[i];
+			}
+		}
+		if (old != NULL) {
+			efree(old);
+		}
+	}
+
+	slot = php_yaml_anchors_slot(anchors, name, length, hash);
+	if (slot->value != NULL) {
+		zval_ptr_dtor(&slot->value);
+		slot->value = zv;
+		return;
+	}
+
+	if (anchors->names_used + length > anchors->names_size) {
+		anchors->names_size = MAX(anchors->names_size * 2, anchors->names_used + length + 64);
+		anchors->names = (char *)erealloc(anchors->names, anchors->names_size);
+	}
+	memcpy(anchors->names + anchors->names_used, name, length);
+	slot->hash = hash;
+	slot->name = anchors->names_used;
+	slot->length = length;
+	slot->value = zv;
+	anchors->names_used += length;
+	anchors->count++;
+}
+/* }}} */
+
+/* {{{ php_yaml_anchors_find() */
+static zval *
+php_yaml_anchors_find(php_yaml_anchors *anchors, const char *name)
+{
+	size_t length;
+
+	if (anchors->slots == NULL) {
+		return NULL;
+	}
+	length = strlen(name);
+	return php_yaml_anchors_slot(anchors, name, length,
+			zend_inline_hash_func(name, (uint)length))->value;
+}
+/* }}} */
+
+/* {{{ php_yaml_anchors_free()
+ * Drops the references to the nodes, which the document still has.
+ */
+static void
+php_yaml_anchors_free(php_yaml_anchors *anchors)
+{
+	size_t i;
+
+	if (anchors->slots != NULL) {
+		for (i = 0; i <= anchors->mask; i++) {
+			if (anchors->slots[i].value != NULL) {
+				zval_ptr_dtor(&anchors->slots[i].value);
+			}
+		}
+		efree(anchors->slots);
+	}
+	if (anchors->names != NULL) {
+		efree(anchors->names);
+	}
+	memset(anchors, 0, sizeof(php_yaml_anchors));
+}
+/* }}} */
+
+/* {{{ php_yaml_add_anchor()
+ * Registers zv for the aliases to anchor. Unless yaml.alias_references
+ * is off, the node and its aliases become PHP references to each other;
+ * otherwise they share the value, which is separated on write as usual.
+ */
+static void
+php_yaml_add_anchor(php_yaml_anchors *anchors, char *anchor, zval *zv TSRMLS_DC)
+{
+	Z_ADDREF_P(zv);
+	if (YAML_G(alias_references)) {
+		Z_SET_ISREF_P(zv);
+	}
+	php_yaml_anchors_add(anchors, anchor, zv);
+}
+/* }}} */
+/* }}} */
+
 /* {{{ php_yaml_read_impl() */
 zval *
-php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
-		zval *aliases, zval *zv, long *ndocs,
+php_yaml_read_impl(php_yaml_source *source, yaml_event_t *parent,
+		php_yaml_anchors *anchors, zval *zv, long *ndocs,
 		eval_scalar_func_t eval_func, HashTable *callbacks TSRMLS_DC)
 {
 	zval *retval = NULL;
 	yaml_event_t event = {0};
 	char *key = NULL;
 	int code = Y_PARSER_CONTINUE;
+	size_t base = source->stage.count;
 
 	if (zv != NULL) {
 		retval = zv;
@@ -187,14 +1262,14 @@ php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
 #ifdef IS_UNICODE
 		Z_ARRVAL_P(retval)->unicode = UG(unicode);
 #endif
+		YAML_G(stats).allocations++;
 	}
 
 	do {
 		zval *tmp_p = NULL;
 		zval **tmp_pp = NULL;
 
-		if (!yaml_parser_parse(parser, &event)) {
-			php_yaml_print_parser_error (parser TSRMLS_CC);
+		if (php_yaml_next_event(source, &event TSRMLS_CC) == FAILURE) {
 			code = Y_PARSER_FAILURE;
 			break;
 		}
@@ -205,17 +1280,14 @@ php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
 			break;
 
 		  case YAML_DOCUMENT_START_EVENT:
+			YAML_PROBE2(document__start, *ndocs, (long)event.start_mark.index);
 			{
-				zval *a = NULL;
-				MAKE_STD_ZVAL(a);
-				array_init(a);
-#ifdef IS_UNICODE
-				Z_ARRVAL_P(a)->unicode = UG(unicode);
-#endif
-				if (php_yaml_read_impl(parser, &event, a, retval, ndocs, eval_func, callbacks TSRMLS_CC) == NULL) {
+				php_yaml_anchors a;
+				memset(&a, 0, sizeof(php_yaml_anchors));
+				if (php_yaml_read_impl(source, &event, &a, retval, ndocs, eval_func, callbacks TSRMLS_CC) == NULL) {
 					code = Y_PARSER_FAILURE;
 				}
-				zval_ptr_dtor(&a);
+				php_yaml_anchors_free(&a);
 			}
 			(*ndocs)++;
 			break;
@@ -227,28 +1299,34 @@ php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
 #ifdef IS_UNICODE
 			Z_ARRVAL_P(tmp_p)->unicode = UG(unicode);
 #endif
+			YAML_G(stats).allocations++;
 
 			if (event.type == YAML_SEQUENCE_START_EVENT) {
 				if (event.data.sequence_start.anchor != NULL) {
-					Z_ADDREF_P(tmp_p);
-					Z_SET_ISREF_P(tmp_p);
-					add_assoc_zval(aliases, (char *)event.data.sequence_start.anchor, tmp_p);
+					php_yaml_add_anchor(anchors, (char *)event.data.sequence_start.anchor,
+							tmp_p TSRMLS_CC);
 				}
 			} else if (event.type == YAML_MAPPING_START_EVENT) {
 				if (event.data.mapping_start.anchor != NULL) {
-					Z_ADDREF_P(tmp_p);
-					Z_SET_ISREF_P(tmp_p);
-					add_assoc_zval(aliases, (char *)event.data.mapping_start.anchor, tmp_p);
+					php_yaml_add_anchor(anchors, (char *)event.data.mapping_start.anchor,
+							tmp_p TSRMLS_CC);
 				}
 			}
 
-			tmp_p = php_yaml_read_impl(parser, &event, aliases, tmp_p, ndocs, eval_func, callbacks TSRMLS_CC);
+			tmp_p = php_yaml_read_impl(source, &event, anchors, tmp_p, ndocs, eval_func, callbacks TSRMLS_CC);
 			if (tmp_p == NULL) {
 				code = Y_PARSER_FAILURE;
 				break;
 			}
 
 			if (callbacks != NULL) {
+				/* the filter is to see the values of the scalars below */
+				if (source->batches != NULL && php_yaml_has_filter(&event, callbacks) &&
+						php_yaml_batch_flush(source TSRMLS_CC) == FAILURE) {
+					zval_ptr_dtor(&tmp_p);
+					code = Y_PARSER_FAILURE;
+					break;
+				}
 				if (php_yaml_apply_filter(&tmp_p, event, callbacks TSRMLS_CC) == Y_FILTER_FAILURE) {
 					zval_ptr_dtor(&tmp_p);
 					code = Y_PARSER_FAILURE;
@@ -258,22 +1336,27 @@ php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
 
 			if (parent->type == YAML_MAPPING_START_EVENT) {
 				if (key == NULL) {
-					key = php_yaml_convert_to_char(tmp_p TSRMLS_CC);
+					/* the key may hold scalars still waiting for their values */
+					if (source->batches != NULL && php_yaml_batch_flush(source TSRMLS_CC) == FAILURE) {
+						zval_ptr_dtor(&tmp_p);
+						code = Y_PARSER_FAILURE;
+						break;
+					}
+					key = php_yaml_convert_to_key(&source->arena, tmp_p TSRMLS_CC);
 					if (key == NULL) {
 						zval_ptr_dtor(&tmp_p);
 						code = Y_PARSER_FAILURE;
 						break;
 					}
-					/* assign tmp_p to the alias-storage
-					   tmp_p will be freed in its destructor */
-					add_next_index_zval(aliases, tmp_p);
+					/* the key has been copied, the anchors keep
+					   what an alias may still need of tmp_p */
+					zval_ptr_dtor(&tmp_p);
 				} else {
-					add_assoc_zval(retval, key, tmp_p);
-					efree(key);
+					php_yaml_stage_push(&source->stage, key, tmp_p);
 					key = NULL;
 				}
 			} else {
-				add_next_index_zval(retval, tmp_p);
+				php_yaml_add_entry(source, parent, retval, tmp_p);
 			}
 			break;
 
@@ -285,27 +1368,30 @@ php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
 			break;
 
 		  case YAML_ALIAS_EVENT:
-			if (zend_hash_find(Z_ARRVAL_P(aliases),
-					(char *)event.data.alias.anchor,
-					(uint)strlen((char *)event.data.alias.anchor) + 1,
-					(void **)&tmp_pp) == SUCCESS)
+			if ((tmp_p = php_yaml_anchors_find(anchors,
+							(char *)event.data.alias.anchor)) != NULL)
 			{
+				tmp_pp = &tmp_p;
 				if (parent->type == YAML_MAPPING_START_EVENT) {
 					if (key == NULL) {
-						key = php_yaml_convert_to_char(*tmp_pp TSRMLS_CC);
+						/* the key may be a scalar still waiting for its value */
+						if (source->batches != NULL && php_yaml_batch_flush(source TSRMLS_CC) == FAILURE) {
+							code = Y_PARSER_FAILURE;
+							break;
+						}
+						key = php_yaml_convert_to_key(&source->arena, *tmp_pp TSRMLS_CC);
 						if (key == NULL) {
 							code = Y_PARSER_FAILURE;
 							break;
 						}
 					} else {
 						Z_ADDREF_PP(tmp_pp);
-						add_assoc_zval(retval, key, *tmp_pp);
-						efree(key);
+						php_yaml_stage_push(&source->stage, key, *tmp_pp);
 						key = NULL;
 					}
 				} else {
 					Z_ADDREF_PP(tmp_pp);
-					add_next_index_zval(retval, *tmp_pp);
+					php_yaml_add_entry(source, parent, retval, *tmp_pp);
 				}
 			} else {
 				php_error_docref(NULL TSRMLS_CC, E_WARNING,
@@ -317,33 +1403,34 @@ php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
 		  case YAML_SCALAR_EVENT:
 			if (parent->type == YAML_MAPPING_START_EVENT) {
 				if (key == NULL) {
-					key = estrndup((char *)event.data.scalar.value, event.data.scalar.length);
+					key = php_yaml_arena_strndup(&source->arena, (char *)event.data.scalar.value,
+							event.data.scalar.length TSRMLS_CC);
 				} else {
-					tmp_p = eval_func(event, callbacks TSRMLS_CC);
+					tmp_p = php_yaml_eval(source, eval_func, event, callbacks TSRMLS_CC);
 					if (tmp_p == NULL) {
 						code = Y_PARSER_FAILURE;
 						break;
 					}
-					add_assoc_zval(retval, key, tmp_p);
-					efree(key);
+					php_yaml_stage_push(&source->stage, key, tmp_p);
 					key = NULL;
 				}
 			} else {
-				tmp_p = eval_func(event, callbacks TSRMLS_CC);
+				tmp_p = php_yaml_eval(source, eval_func, event, callbacks TSRMLS_CC);
 				if (tmp_p == NULL) {
 					code = Y_PARSER_FAILURE;
 					break;
 				}
-				add_next_index_zval(retval, tmp_p);
+				php_yaml_add_entry(source, parent, retval, tmp_p);
 			}
 
 			if (event.data.scalar.anchor != NULL) {
 				if (tmp_p == NULL) {
-					add_assoc_string(aliases, (char *)event.data.scalar.anchor, key, 1);
+					MAKE_STD_ZVAL(tmp_p);
+					ZVAL_STRING(tmp_p, key, 1);
+					php_yaml_anchors_add(anchors, (char *)event.data.scalar.anchor, tmp_p);
 				} else {
-					Z_ADDREF_P(tmp_p);
-					Z_SET_ISREF_P(tmp_p);
-					add_assoc_zval(aliases, (char *)event.data.scalar.anchor, tmp_p);
+					php_yaml_add_anchor(anchors, (char *)event.data.scalar.anchor,
+							tmp_p TSRMLS_CC);
 				}
 			}
 			break;
@@ -356,12 +1443,41 @@ php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
 		yaml_event_delete(&event);
 	} while (code == Y_PARSER_CONTINUE);
 
-	if (key != NULL) {
+	if (key != NULL) {
+		if (code == Y_PARSER_SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "invalid mapping structure");
+		}
+		code = Y_PARSER_FAILURE;
+	}
+
+	if (parent != NULL && parent->type == YAML_DOCUMENT_START_EVENT && source->batches != NULL) {
+		if (code != Y_PARSER_SUCCESS) {
+			php_yaml_batch_discard(source);
+		} else if (php_yaml_batch_flush(source TSRMLS_CC) == FAILURE) {
+			code = Y_PARSER_FAILURE;
+		}
+	}
+
+	if (parent != NULL && (parent->type == YAML_SEQUENCE_START_EVENT ||
+			parent->type == YAML_MAPPING_START_EVENT)) {
+		/* the keys of this mapping are the oldest allocations in the
+		   arena still in use, giving back the first gives back all */
+		if (source->stage.count > base && source->stage.keys[base] != NULL) {
+			key = source->stage.keys[base];
+		}
 		if (code == Y_PARSER_SUCCESS) {
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "invalid mapping structure");
+			php_yaml_stage_flush(&source->stage, base, retval TSRMLS_CC);
+		} else {
+			php_yaml_stage_discard(&source->stage, base);
 		}
-		efree(key);
-		code = Y_PARSER_FAILURE;
+	}
+	if (key != NULL) {
+		php_yaml_arena_release(&source->arena, key);
+	}
+
+	if (parent == NULL) {
+		php_yaml_arena_free(&source->arena);
+		php_yaml_stage_free(&source->stage);
 	}
 
 	if (code == Y_PARSER_FAILURE) {
@@ -376,32 +1492,33 @@ php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
 }
 /* }}} */
 
-/* {{{ php_yaml_read_partial() */
+/* {{{ php_yaml_read_partial()
+ * Without ndocs, stops as soon as document pos is complete instead of
+ * reading to the end of the stream to count the documents.
+ */
 zval *
-php_yaml_read_partial(yaml_parser_t *parser, long pos, long *ndocs,
+php_yaml_read_partial(php_yaml_source *source, long pos, long *ndocs,
 		eval_scalar_func_t eval_func, HashTable *callbacks TSRMLS_DC)
 {
 	zval *retval = NULL;
 	yaml_event_t event = {0};
 	int code = Y_PARSER_CONTINUE;
+	long count = 0;
+	long *counter = ndocs != NULL ? ndocs : &count;
 
 	do {
-		if (!yaml_parser_parse(parser, &event)) {
-			php_yaml_print_parser_error (parser TSRMLS_CC);
+		if (php_yaml_next_event(source, &event TSRMLS_CC) == FAILURE) {
 			code = Y_PARSER_FAILURE;
 			break;
 		}
 
 		if (event.type == YAML_DOCUMENT_START_EVENT) {
-			if (*ndocs == pos) {
+			YAML_PROBE2(document__start, *counter, (long)event.start_mark.index);
+			if (*counter == pos) {
 				zval *tmp_p = NULL;
-				zval *aliases = NULL;
-				MAKE_STD_ZVAL(aliases);
-				array_init(aliases);
-#ifdef IS_UNICODE
-				Z_ARRVAL_P(aliases)->unicode = UG(unicode);
-#endif
-				tmp_p = php_yaml_read_impl(parser, &event, aliases, NULL, ndocs, eval_func, callbacks TSRMLS_CC);
+				php_yaml_anchors anchors;
+				memset(&anchors, 0, sizeof(php_yaml_anchors));
+				tmp_p = php_yaml_read_impl(source, &event, &anchors, NULL, counter, eval_func, callbacks TSRMLS_CC);
 				if (tmp_p == NULL) {
 					code = Y_PARSER_FAILURE;
 				} else {
@@ -411,10 +1528,13 @@ php_yaml_read_partial(yaml_parser_t *parser, long pos, long *ndocs,
 						ZVAL_ZVAL(retval, *tmp_pp, 1, 0);
 					}
 					zval_ptr_dtor(&tmp_p);
+					if (ndocs == NULL) {
+						code = Y_PARSER_SUCCESS;
+					}
 				}
-				zval_ptr_dtor(&aliases);
+				php_yaml_anchors_free(&anchors);
 			}
-			(*ndocs)++;
+			(*counter)++;
 		} else if (event.type == YAML_STREAM_END_EVENT) {
 			code = Y_PARSER_SUCCESS;
 		}
@@ -422,8 +1542,11 @@ php_yaml_read_partial(yaml_parser_t *parser, long pos, long *ndocs,
 		yaml_event_delete(&event);
 	} while (code == Y_PARSER_CONTINUE);
 
+	php_yaml_arena_free(&source->arena);
+	php_yaml_stage_free(&source->stage);
+
 	if (code == Y_PARSER_FAILURE) {
-		*ndocs = -1;
+		*counter = -1;
 		if (retval != NULL) {
 			zval_ptr_dtor(&retval);
 		}
@@ -434,12 +1557,32 @@ php_yaml_read_partial(yaml_parser_t *parser, long pos, long *ndocs,
 }
 /* }}} */
 
-/* {{{ php_yaml_apply_filter() */
+/* {{{ php_yaml_has_filter()
+ * Whether callbacks have a filter for the collection started by event.
+ */
 static int
+php_yaml_has_filter(yaml_event_t *event, HashTable *callbacks)
+{
+	const char *tag = NULL;
+
+	if (event->type == YAML_SEQUENCE_START_EVENT && !event->data.sequence_start.implicit) {
+		tag = (const char *)event->data.sequence_start.tag;
+	} else if (event->type == YAML_MAPPING_START_EVENT && !event->data.mapping_start.implicit) {
+		tag = (const char *)event->data.mapping_start.tag;
+	}
+
+	return tag != NULL && zend_hash_exists(callbacks, (char *)tag, strlen(tag) + 1);
+}
+/* }}} */
+
+/* {{{ php_yaml_apply_filter() */
+int
 php_yaml_apply_filter(zval **zpp, yaml_event_t event, HashTable *callbacks TSRMLS_DC)
 {
 	char *tag = NULL;
-	zval **callback = NULL;
+	zval *callback = NULL;
+	php_yaml_callback *cached = NULL;
+	int batch = 0;
 
 	/* detect event type and get tag */
 	switch (event.type) {
@@ -462,12 +1605,17 @@ php_yaml_apply_filter(zval **zpp, yaml_event_t event, HashTable *callbacks TSRML
 	}
 
 	/* find and apply the filter function */
-	if (zend_hash_find(callbacks, tag, strlen(tag) + 1, (void **)&callback) == SUCCESS) {
+	if (php_yaml_find_callback(callbacks, tag, &callback, &cached, &batch TSRMLS_CC) == SUCCESS) {
 		zval **argv[] = { zpp };
 		zval *retval = NULL;
 
-		if (call_user_function_ex(EG(function_table), NULL, *callback,
-				&retval, 1, argv, 0, NULL TSRMLS_CC) == FAILURE ||
+		if (batch) {
+			if (php_yaml_call_batch_one(callback, cached, tag, *zpp, &retval TSRMLS_CC) == FAILURE) {
+				return Y_FILTER_FAILURE;
+			}
+		} else if (php_yaml_call_user_function(callback, cached, tag,
+				zend_hash_num_elements(Z_ARRVAL_PP(zpp)),
+				&retval, 1, argv TSRMLS_CC) == FAILURE ||
 			retval == NULL)
 		{
 			php_error_docref(NULL TSRMLS_CC, E_WARNING,
@@ -507,15 +1655,18 @@ php_yaml_eval_scalar(yaml_event_t event, HashTable *callbacks TSRMLS_DC)
 
 	MAKE_STD_ZVAL(tmp);
 	ZVAL_NULL(tmp);
+	YAML_G(stats).allocations++;
 
 	/* check for null */
 	if (php_yaml_scalar_is_null(value, length, event)) {
+		YAML_G(stats).scalars[Y_STATS_NULL]++;
 		return tmp;
 	}
 
 	/* check for bool */
 	if ((flags = php_yaml_scalar_is_bool(value, length, event)) != -1) {
 		ZVAL_BOOL(tmp, (zend_bool)flags);
+		YAML_G(stats).scalars[Y_STATS_BOOL]++;
 		return tmp;
 	}
 
@@ -540,14 +1691,17 @@ php_yaml_eval_scalar(yaml_event_t event, HashTable *callbacks TSRMLS_DC)
 			} else if (SCALAR_TAG_IS(event, "int") && (flags & Y_SCALAR_IS_FLOAT)) {
 				convert_to_long(tmp);
 			}
+			YAML_G(stats).scalars[Z_TYPE_P(tmp) == IS_DOUBLE ? Y_STATS_FLOAT : Y_STATS_INT]++;
 			return tmp;
 		} else if (IS_NOT_IMPLICIT_AND_TAG_IS(event, "float")) {
 			ZVAL_STRINGL(tmp, value, length, 1);
 			convert_to_double(tmp);
+			YAML_G(stats).scalars[Y_STATS_FLOAT]++;
 			return tmp;
 		} else if (IS_NOT_IMPLICIT_AND_TAG_IS(event, "int")) {
 			ZVAL_STRINGL(tmp, value, length, 1);
 			convert_to_long(tmp);
+			YAML_G(stats).scalars[Y_STATS_INT]++;
 			return tmp;
 		}
 	}
@@ -559,6 +1713,7 @@ php_yaml_eval_scalar(yaml_event_t event, HashTable *callbacks TSRMLS_DC)
 				zval_ptr_dtor(&tmp);
 				return NULL;
 			}
+			YAML_G(stats).scalars[Y_STATS_TIMESTAMP]++;
 			return tmp;
 		}
 	} else if (SCALAR_TAG_IS(event, "timestamp")) {
@@ -566,6 +1721,7 @@ php_yaml_eval_scalar(yaml_event_t event, HashTable *callbacks TSRMLS_DC)
 			zval_ptr_dtor(&tmp);
 			return NULL;
 		}
+		YAML_G(stats).scalars[Y_STATS_TIMESTAMP]++;
 		return tmp;
 	}
 
@@ -585,6 +1741,7 @@ php_yaml_eval_scalar(yaml_event_t event, HashTable *callbacks TSRMLS_DC)
 		} else {
 			ZVAL_STRINGL(tmp, value, length, 1);
 		}
+		YAML_G(stats).scalars[Y_STATS_BINARY]++;
 		return tmp;
 	}
 
@@ -594,6 +1751,7 @@ php_yaml_eval_scalar(yaml_event_t event, HashTable *callbacks TSRMLS_DC)
 #else
 	ZVAL_STRINGL(tmp, value, length, 1);
 #endif
+	YAML_G(stats).scalars[Y_STATS_STRING]++;
 
 	return tmp;
 }
@@ -604,29 +1762,48 @@ zval *
 php_yaml_eval_scalar_with_callbacks(yaml_event_t event, HashTable *callbacks TSRMLS_DC)
 {
 	char *tag = (char *)event.data.scalar.tag;
-	zval **callback = NULL;
+	zval *callback = NULL;
+	php_yaml_callback *cached = NULL;
+	int batch = 0;
 
 	/* find and apply the evaluation function */
 	if (!event.data.scalar.quoted_implicit && !event.data.scalar.plain_implicit &&
-			zend_hash_find(callbacks, tag, strlen(tag) + 1, (void **)&callback) == SUCCESS)
+			php_yaml_find_callback(callbacks, tag, &callback, &cached, &batch TSRMLS_CC) == SUCCESS)
 	{
 		zval **argv[] = { NULL };
 		zval *arg = NULL;
 		zval *retval = NULL;
 
-		MAKE_STD_ZVAL(arg);
+		/* taken out of cached while in use, in case the callback
+		   parses with the same callbacks */
+		if (cached != NULL && cached->arg != NULL) {
+			arg = cached->arg;
+			cached->arg = NULL;
+		} else {
+			MAKE_STD_ZVAL(arg);
+		}
 		ZVAL_STRINGL(arg, (char *)event.data.scalar.value, event.data.scalar.length, 1);
 		argv[0] = &arg;
 
-		if (call_user_function_ex(EG(function_table), NULL, *callback,
-				&retval, 1, argv, 0, NULL TSRMLS_CC) == FAILURE ||
+		if (batch) {
+			php_yaml_call_batch_one(callback, cached, tag, arg, &retval TSRMLS_CC);
+		} else if (php_yaml_call_user_function(callback, cached, tag, (long)event.data.scalar.length,
+				&retval, 1, argv TSRMLS_CC) == FAILURE ||
 			retval == NULL)
 		{
 			php_error_docref(NULL TSRMLS_CC, E_WARNING,
 					"Failed to evaluate value for tag '%s'"
 					" with user defined function", tag);
 		}
-		zval_ptr_dtor(&arg);
+
+		if (cached != NULL && cached->arg == NULL &&
+				Z_REFCOUNT_P(arg) == 1 && !Z_ISREF_P(arg)) {
+			zval_dtor(arg);
+			ZVAL_NULL(arg);
+			cached->arg = arg;
+		} else {
+			zval_ptr_dtor(&arg);
+		}
 
 		return retval;
 	}
@@ -687,502 +1864,6 @@ php_yaml_scalar_is_bool(const char *value, size_t length, yaml_event_t event)
 }
 /* }}} */
 
-/* {{{ php_yaml_scalar_is_numeric() */
-static int
-php_yaml_scalar_is_numeric(const char *value, size_t length,
-		long *lval, double *dval, char **str)
-{
-	const char* end = value + length;
-	char *buf = NULL, *ptr = NULL;
-	int negative = 0;
-	int type = 0;
-
-	if (length == 0) {
-		goto not_numeric;
-	}
-
-	/* trim */
-	while (value < end && (*(end - 1) == ' ' || *(end - 1) == '\t')) {
-		end--;
-	}
-	while (value < end && (*value == ' ' || *value == '\t')) {
-		value++;
-	}
-	if (value == end) {
-		goto not_numeric;
-	}
-
-	/* not a number */
-	if (!strcmp(".NAN", value) || !strcmp(".NaN", value) || !strcmp(".nan", value)) {
-		type = Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_NAN;
-		goto finish;
-	}
-
-	/* sign */
-	if (*value == '+') {
-		value++;
-	} else if (*value == '-') {
-		negative = 1;
-		value++;
-	}
-	if (value == end) {
-		goto not_numeric;
-	}
-
-	/* infinity */
-	if (!strcmp(".INF", value) || !strcmp(".Inf", value) || !strcmp(".inf", value)) {
-		type = Y_SCALAR_IS_FLOAT;
-		type |= (negative ? Y_SCALAR_IS_INFINITY_N : Y_SCALAR_IS_INFINITY_P);
-		goto finish;
-	}
-
-	/* alloc */
-	buf = (char *)emalloc(length + 3);
-	ptr = buf;
-	if (negative) {
-		*ptr++ = '-';
-	}
-
-	/* parse */
-	if (*value == '0') {
-		*ptr++ = *value++;
-		if (value == end) {
-			goto return_zero;
-		}
-
-		if (*value == 'b') {
-			/* binary integer */
-			*ptr++ = *value++;
-			if (value == end) {
-				goto not_numeric;
-			}
-			while (value < end && (*value == '_' || *value == '0')) {
-				value++;
-			}
-			if (value == end) {
-				goto return_zero;
-			}
-			/* check the sequence */
-			while (value < end) {
-				if (*value == '_') {
-					*value++;
-				} else if (*value == '0' || *value == '1') {
-					*ptr++ = *value++;
-				} else {
-					goto not_numeric;
-				}
-			}
-			type = Y_SCALAR_IS_INT | Y_SCALAR_IS_BINARY;
-
-		} else if (*value == 'x') {
-			/* hexadecimal integer */
-			*ptr++ = *value++;
-			if (value == end) {
-				goto not_numeric;
-			}
-			while (value < end && (*value == '_' || *value == '0')) {
-				value++;
-			}
-			if (value == end) {
-				goto return_zero;
-			}
-			/* check the sequence */
-			while (value < end) {
-				if (*value == '_') {
-					*value++;
-				} else if ((*value >= '0' && *value <= '9') ||
-					(*value >= 'A' && *value <= 'F') ||
-					(*value >= 'a' && *value <= 'f'))
-				{
-					*ptr++ = *value++;
-				} else {
-					goto not_numeric;
-				}
-			}
-			type = Y_SCALAR_IS_INT | Y_SCALAR_IS_HEXADECIMAL;
-
-		} else if (*value == '_' || (*value >= '0' && *value <= '7')) {
-			/* octal integer */
-			while (value < end) {
-				if (*value == '_') {
-					*value++;
-				} else if (*value >= '0' && *value <= '7') {
-					*ptr++ = *value++;
-				} else {
-					goto not_numeric;
-				}
-			}
-			type = Y_SCALAR_IS_INT | Y_SCALAR_IS_OCTAL;
-
-		} else if (*value == '.') {
-			goto check_float;
-
-		} else {
-			goto not_numeric;
-		}
-
-	} else if (*value >= '1' && *value <= '9') {
-		/* integer */
-		*ptr++ = *value++;
-		while (value < end) {
-			if (*value == '_' || *value == ',') {
-				*value++;
-			} else if (*value >= '0' && *value <= '9') {
-				*ptr++ = *value++;
-			} else if (*value == ':') {
-				goto check_sexa;
-			} else if (*value == '.') {
-				goto check_float;
-			} else {
-				goto not_numeric;
-			}
-		}
-		type = Y_SCALAR_IS_INT | Y_SCALAR_IS_DECIMAL;
-
-	} else if (*value == ':') {
-		/* sexagecimal */
-	  check_sexa:
-		while (value < end - 2) {
-			if (*value == '.') {
-				type = Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_SEXAGECIMAL;
-				goto check_float;
-			}
-			if (*value != ':') {
-				goto not_numeric;
-			}
-			*ptr++ = *value++;
-			if (*(value + 1) == ':') {
-				if (*value >= '0' && *value <= '9') {
-					*ptr++ = *value++;
-				} else {
-					goto not_numeric;
-				}
-			} else {
-				if ((*value >= '0' && *value <= '5') &&
-					(*(value + 1) >= '0' && *(value + 1) <= '9'))
-				{
-					*ptr++ = *value++;
-					*ptr++ = *value++;
-				} else {
-					goto not_numeric;
-				}
-			}
-		}
-		if (*value == '.') {
-			type = Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_SEXAGECIMAL;
-			goto check_float;
-		} else if (value == end) {
-			type = Y_SCALAR_IS_INT | Y_SCALAR_IS_SEXAGECIMAL;
-		} else {
-			goto not_numeric;
-		}
-
-	} else if (*value == '.') {
-		/* float */
-		*ptr++ = '0';
-	  check_float:
-		*ptr++ = *value++;
-		if (type == (Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_SEXAGECIMAL)) {
-			/* sexagecimal float */
-			while (value < end && (*(end - 1) == '_' || *(end - 1) == '0')) {
-				end--;
-			}
-			if (value == end) {
-				*ptr++ = '0';
-			}
-			while (value < end) {
-				if (*value == '_') {
-					*value++;
-				} else if (*value >= '0' && *value <= '9') {
-					*ptr++ = *value++;
-				} else {
-					goto not_numeric;
-				}
-			}
-		} else {
-			/* decimal float */
-			int is_exp = 0;
-			while (value < end) {
-				if (*value == '_') {
-					*value++;
-				} else if (*value >= '0' && *value <= '9') {
-					*ptr++ = *value++;
-				} else if (*value == 'E' || *value == 'e') {
-					/* exponential */
-					is_exp = 1;
-					*ptr++ = *value++;
-					if (value == end || (*value != '+' && *value != '-')) {
-						goto not_numeric;
-					}
-					*ptr++ = *value++;
-					if (value == end || *value < '0' || *value > '9' || (*value == '0' && value + 1 == end)) {
-						goto not_numeric;
-					}
-					*ptr++ = *value++;
-					while (value < end) {
-						if (*value >= '0' && *value <= '9') {
-							*ptr++ = *value++;
-						} else {
-							goto not_numeric;
-						}
-					}
-				} else {
-					goto not_numeric;
-				}
-			}
-			/* trim */
-			if (!is_exp) {
-				while (*(ptr - 1) == '0') {
-					ptr--;
-				}
-				if (*(ptr - 1) == '.') {
-					*ptr++ = '0';
-				}
-			}
-			type = Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_DECIMAL;
-		}
-
-	} else {
-		goto not_numeric;
-	}
-
-	/* terminate */
-	*ptr = '\0';
-
-  finish:
-	/* convert & assign */
-	if ((type & Y_SCALAR_IS_INT) && lval != NULL) {
-		switch (type & Y_SCALAR_FORMAT_MASK) {
-		  case Y_SCALAR_IS_BINARY:
-			ptr = buf + 2;
-			if (*ptr == 'b') {
-				ptr++;
-			}
-			*lval = strtol(ptr, (char **)NULL, 2);
-			if (*buf == '-') {
-				*lval *= -1L;
-			}
-			break;
-		  case Y_SCALAR_IS_OCTAL:
-			*lval = strtol(buf, (char **)NULL, 8);
-			break;
-		  case Y_SCALAR_IS_HEXADECIMAL:
-			*lval = strtol(buf, (char **)NULL, 16);
-			break;
-		  case Y_SCALAR_IS_SEXAGECIMAL:
-			*lval = php_yaml_eval_sexagesimal_l(0, buf, ptr);
-			if (*buf == '-') {
-				*lval *= -1L;
-			}
-			break;
-		  default:
-			*lval = atol(buf);
-		}
-	} else if ((type & Y_SCALAR_IS_FLOAT) && dval != NULL) {
-		switch (type & Y_SCALAR_FORMAT_MASK) {
-		  case Y_SCALAR_IS_SEXAGECIMAL:
-			*dval = php_yaml_eval_sexagesimal_d(0.0, buf, ptr);
-			if (*buf == '-') {
-				*dval *= -1.0;
-			}
-			break;
-		  case Y_SCALAR_IS_INFINITY_P:
-			*dval = php_get_inf();
-			break;
-		  case Y_SCALAR_IS_INFINITY_N:
-			*dval = -php_get_inf();
-			break;
-		  case Y_SCALAR_IS_NAN:
-			*dval = php_get_nan();
-			break;
-		  default:
-			*dval = atof(buf);
-		}
-	}
-	if (buf != NULL) {
-		if (str != NULL) {
-			*str = buf;
-		} else {
-			efree(buf);
-		}
-	}
-
-	/* return */
-	return type;
-
-  return_zero:
-	if (lval != NULL) {
-		*lval = 0;
-	}
-	if (dval != NULL) {
-		*dval = 0.0;
-	}
-	if (buf != NULL) {
-		efree(buf);
-	}
-	return (Y_SCALAR_IS_INT | Y_SCALAR_IS_ZERO);
-
-  not_numeric:
-	if (buf != NULL) {
-		efree(buf);
-	}
-	return Y_SCALAR_IS_NOT_NUMERIC;
-}
-/* }}} */
-
-#define ts_skip_space() \
-	while (ptr < end && (*ptr == ' ' || *ptr == '\t')) { \
-		ptr++; \
-	}
-
-#define ts_skip_number() \
-	while (ptr < end && *ptr >= '0' && *ptr <= '9') { \
-		ptr++; \
-	}
-
-/* {{{ php_yaml_scalar_is_timestamp()
- * timestamp specification is found at http://yaml.org/type/timestamp.html.
- */
-static int
-php_yaml_scalar_is_timestamp(const char *value, size_t length)
-{
-	const char *ptr = value;
-	const char *end = value + length;
-	const char *pos1, *pos2;
-
-	/* skip leading space */
-	ts_skip_space();
-
-	/* check year and separator */
-	pos1 = pos2 = ptr;
-	ts_skip_number();
-	if (ptr == pos1 || ptr == end || ptr - pos2 != 4 || *ptr != '-') {
-		return 0;
-	}
-
-	/* check month and separator */
-	pos2 = ++ptr;
-	ts_skip_number();
-	if (ptr == pos2 || ptr == end || ptr - pos2 > 2 || *ptr != '-') {
-		return 0;
-	}
-
-	/* check day and separator */
-	pos2 = ++ptr;
-	ts_skip_number();
-	if (ptr == pos2 || ptr - pos2 > 2) {
-		return 0;
-	}
-
-	/* check separator */
-	pos2 = ptr;
-	ts_skip_space();
-	if (ptr == end) {
-		return (pos2 - pos1 == 10) ? 1 : 0;
-	}
-	if (*ptr == 'T' || *ptr == 't') {
-		*ptr++;
-	}
-
-	/* check hour and separator */
-	pos1 = ptr;
-	ts_skip_number();
-	if (ptr == pos1 || ptr == end || ptr - pos1 > 2 || *ptr != ':') {
-		return 0;
-	}
-
-	/* check minute and separator */
-	pos1 = ++ptr;
-	ts_skip_number();
-	if (ptr == end || ptr - pos1 != 2 || *ptr != ':') {
-		return 0;
-	}
-
-	/* check second */
-	pos1 = ++ptr;
-	ts_skip_number();
-	if (ptr == end) {
-		return (ptr - pos1 == 2) ? 1 : 0;
-	}
-
-	/* check fraction */
-	if (*ptr == '.') {
-		ptr++;
-		ts_skip_number();
-	}
-
-	/* skip separator space */
-	ts_skip_space();
-	if (ptr == end) {
-		return 1;
-	}
-
-	/* check time zone */
-	if (*ptr == 'Z') {
-		ptr++;
-		ts_skip_space();
-		return (ptr == end) ? 1 : 0;
-	}
-	if (*ptr != '+' && *ptr != '-') {
-		return 0;
-	}
-	pos1 = ++ptr;
-	ts_skip_number();
-	if (ptr - pos1 == 0 || ptr - pos1 > 4) {
-		return 0;
-	}
-	if (ptr - pos1 < 3 && *ptr == ':') {
-		pos1 = ++ptr;
-		ts_skip_number();
-		if (ptr - pos1 != 2) {
-			return 0;
-		}
-	}
-
-	/* skip following space */
-	ts_skip_space();
-	return (ptr == end) ? 1 : 0;
-}
-/* }}} */
-
-/* {{{ php_yaml_eval_sexagesimal_l() */
-static long
-php_yaml_eval_sexagesimal_l(long lval, char *sg, char *eos)
-{
-	char *ep;
-	while (sg < eos && (*sg < '0' || *sg > '9')) {
-		*sg++;
-	}
-	ep = sg;
-	while (ep < eos && *ep >= '0' && *ep <= '9') {
-		*ep++;
-	}
-	if (sg == eos) {
-		return lval;
-	}
-	return php_yaml_eval_sexagesimal_l(lval * 60 + strtol(sg, (char **)NULL, 10), ep, eos);
-}
-/* }}} */
-
-/* {{{ php_yaml_eval_sexagesimal_d() */
-static double
-php_yaml_eval_sexagesimal_d(double dval, char *sg, char *eos)
-{
-	char *ep;
-	while (sg < eos && *sg != '.' && (*sg < '0' || *sg > '9')) {
-		*sg++;
-	}
-	ep = sg;
-	while (ep < eos && *ep >= '0' && *ep <= '9') {
-		*ep++;
-	}
-	if (sg == eos || *sg == '.') {
-		return dval;
-	}
-	return php_yaml_eval_sexagesimal_d(dval * 60.0 + strtod(sg, (char **)NULL), ep, eos);
-}
-/* }}} */
-
 /* {{{ php_yaml_eval_timestamp() */
 static int
 php_yaml_eval_timestamp(zval **zpp, char *ts, int ts_len TSRMLS_DC)
@@ -1265,8 +1946,8 @@ php_yaml_eval_timestamp(zval **zpp, char *ts, int ts_len TSRMLS_DC)
 #endif
 		argv[0] = &arg;
 
-		if (call_user_function_ex(EG(function_table), NULL, func,
-				&retval, 1, argv, 0, NULL TSRMLS_CC) == FAILURE ||
+		if (php_yaml_call_user_function(func, NULL, "tag:yaml.org,2002:timestamp", ts_len,
+				&retval, 1, argv TSRMLS_CC) == FAILURE ||
 			retval == NULL)
 		{
 			php_error_docref(NULL TSRMLS_CC, E_WARNING,
@@ -1380,6 +2061,11 @@ php_yaml_check_callbacks(HashTable *callbacks TSRMLS_DC)
 
 	while (zend_hash_get_current_data(callbacks, (void **)&entry) == SUCCESS) {
 		int key_type = zend_hash_get_current_key_ex(callbacks, &key, &key_len, &idx, 0, NULL);
+		zval *callable = php_yaml_batch_callable(*entry);
+
+		if (callable == NULL) {
+			callable = *entry;
+		}
 
 #ifdef IS_UNICODE
 		if (key_type == HASH_KEY_IS_STRING || key_type == HASH_KEY_IS_UNICODE) {
@@ -1388,7 +2074,7 @@ php_yaml_check_callbacks(HashTable *callbacks TSRMLS_DC)
 
 			INIT_ZVAL(name);
 
-			if (!zend_is_callable(*entry, 0, &name)) {
+			if (!zend_is_callable(callable, 0, &name)) {
 				if (Z_TYPE(name) == IS_UNICODE || Z_TYPE(name) == IS_STRING) {
 					php_error_docref(NULL TSRMLS_CC, E_WARNING,
 							"Callback for tag '%R', '%R' is not valid",
@@ -1402,6 +2088,12 @@ php_yaml_check_callbacks(HashTable *callbacks TSRMLS_DC)
 			}
 
 			if (ZEND_U_EQUAL(type, key, key_len - 1, "tag:yaml.org,2002:timestamp", sizeof("tag:yaml.org,2002:timestamp") - 1)) {
+				if (callable != *entry) {
+					php_error_docref(NULL TSRMLS_CC, E_WARNING,
+							"Callback for tag '%R' can't be a batch callback", type, key);
+					zval_dtor(&name);
+					return FAILURE;
+				}
 				YAML_G(timestamp_decoder) = *entry;
 			}
 
@@ -1413,7 +2105,7 @@ php_yaml_check_callbacks(HashTable *callbacks TSRMLS_DC)
 		if (key_type == HASH_KEY_IS_STRING) {
 			char *name;
 
-			if (!zend_is_callable(*entry, 0, &name TSRMLS_CC)) {
+			if (!zend_is_callable(callable, 0, &name TSRMLS_CC)) {
 				if (name != NULL) {
 					php_error_docref(NULL TSRMLS_CC, E_WARNING,
 							"Callback for tag '%s', '%s' is not valid", key, name);
@@ -1426,6 +2118,14 @@ php_yaml_check_callbacks(HashTable *callbacks TSRMLS_DC)
 			}
 
 			if (!strcmp(key, "tag:yaml.org,2002:timestamp")) {
+				if (callable != *entry) {
+					php_error_docref(NULL TSRMLS_CC, E_WARNING,
+							"Callback for tag '%s' can't be a batch callback", key);
+					if (name != NULL) {
+						efree(name);
+					}
+					return FAILURE;
+				}
 				YAML_G(timestamp_decoder) = *entry;
 			}
 
@@ -1445,6 +2145,110 @@ php_yaml_check_callbacks(HashTable *callbacks TSRMLS_DC)
 }
 /* }}} */
 
+/* {{{ php_yaml_callback_dtor() */
+static void
+php_yaml_callback_dtor(void *data)
+{
+	php_yaml_callback *cb = (php_yaml_callback *)data;
+
+	if (cb->arg != NULL) {
+		zval_ptr_dtor(&cb->arg);
+	}
+}
+/* }}} */
+
+/* {{{ php_yaml_callbacks_begin()
+ * Resolves the callbacks, checked by php_yaml_check_callbacks(), for
+ * the parse that is about to start, or counts one more user of them.
+ */
+void
+php_yaml_callbacks_begin(HashTable *callbacks TSRMLS_DC)
+{
+#ifdef Y_RESOLVE_CALLBACKS
+	php_yaml_callbacks *resolved;
+	HashPosition hpos;
+	zval **entry = NULL;
+	char *key = NULL;
+	uint key_len = 0;
+	ulong idx = 0L;
+
+	if (callbacks == NULL) {
+		return;
+	}
+
+	for (resolved = YAML_G(resolved_callbacks); resolved != NULL; resolved = resolved->next) {
+		if (resolved->callbacks == callbacks) {
+			resolved->refcount++;
+			return;
+		}
+	}
+
+	resolved = emalloc(sizeof(php_yaml_callbacks));
+	resolved->callbacks = callbacks;
+	resolved->refcount = 1;
+	zend_hash_init(&resolved->resolved, zend_hash_num_elements(callbacks), NULL,
+			php_yaml_callback_dtor, 0);
+
+	for (zend_hash_internal_pointer_reset_ex(callbacks, &hpos);
+			zend_hash_get_current_data_ex(callbacks, (void **)&entry, &hpos) == SUCCESS;
+			zend_hash_move_forward_ex(callbacks, &hpos)) {
+		php_yaml_callback cb;
+		char *error = NULL;
+
+		if (zend_hash_get_current_key_ex(callbacks, &key, &key_len, &idx, 0, &hpos) != HASH_KEY_IS_STRING) {
+			continue;
+		}
+
+		memset(&cb, 0, sizeof(php_yaml_callback));
+		cb.callable = php_yaml_batch_callable(*entry);
+		if (cb.callable != NULL) {
+			cb.batch = 1;
+		} else {
+			cb.callable = *entry;
+		}
+		if (zend_fcall_info_init(cb.callable, 0, &cb.fci, &cb.fcc, NULL, &error TSRMLS_CC) == FAILURE) {
+			/* called as it is, to fail as before */
+			cb.fci.size = 0;
+		}
+		if (error != NULL) {
+			efree(error);
+		}
+		zend_hash_add(&resolved->resolved, key, key_len, &cb, sizeof(php_yaml_callback), NULL);
+	}
+
+	resolved->next = YAML_G(resolved_callbacks);
+	YAML_G(resolved_callbacks) = resolved;
+#endif
+}
+/* }}} */
+
+/* {{{ php_yaml_callbacks_end() */
+void
+php_yaml_callbacks_end(HashTable *callbacks TSRMLS_DC)
+{
+#ifdef Y_RESOLVE_CALLBACKS
+	php_yaml_callbacks **link;
+
+	if (callbacks == NULL) {
+		return;
+	}
+
+	for (link = &YAML_G(resolved_callbacks); *link != NULL; link = &(*link)->next) {
+		php_yaml_callbacks *resolved = *link;
+
+		if (resolved->callbacks == callbacks) {
+			if (--resolved->refcount == 0) {
+				*link = resolved->next;
+				zend_hash_destroy(&resolved->resolved);
+				efree(resolved);
+			}
+			return;
+		}
+	}
+#endif
+}
+/* }}} */
+
 /*
  * Local variables:
  * tab-width: 4
@@ -9,30 +9,160 @@
 #define Y_FILTER_SUCCESS  1
 #define Y_FILTER_FAILURE -1
 
-#define Y_SCALAR_IS_NOT_NUMERIC 0x00
-#define Y_SCALAR_IS_INT         0x10
-#define Y_SCALAR_IS_FLOAT       0x20
-#define Y_SCALAR_IS_ZERO        0x00
-#define Y_SCALAR_IS_BINARY      0x01
-#define Y_SCALAR_IS_OCTAL       0x02
-#define Y_SCALAR_IS_DECIMAL     0x03
-#define Y_SCALAR_IS_HEXADECIMAL 0x04
-#define Y_SCALAR_IS_SEXAGECIMAL 0x05
-#define Y_SCALAR_IS_INFINITY_P  0x06
-#define Y_SCALAR_IS_INFINITY_N  0x07
-#define Y_SCALAR_IS_NAN         0x08
-#define Y_SCALAR_FORMAT_MASK    0x0F
+/* {{{ event sources
+ * php_yaml_read_impl() takes its events either from a live parser or
+ * from a list recorded in advance, possibly on another thread. A list
+ * is allocated with malloc() and owns its events until they are handed
+ * out; error holds the state of the recording parser if it failed.
+ * hints has the scalar type checks that could be done while recording.
+ */
+#define Y_HINT_NONE   0
+#define Y_HINT_STRING 1  /* implicit scalar that resolves to a plain string */
+
+typedef struct _php_yaml_event_list {
+	yaml_event_t *events;
+	unsigned char *hints;
+	size_t count;
+	size_t size;
+	yaml_parser_t error;
+} php_yaml_event_list;
+
+/* {{{ arena
+ * Bump allocator for the strings a parse needs only for a moment,
+ * mapping keys above all. They are given back in reverse order of
+ * allocation, which keeps the blocks for the next ones; the blocks
+ * go back to Zend when the parse ends.
+ */
+#define Y_ARENA_BLOCK_SIZE 8192
+
+typedef struct _php_yaml_arena_block php_yaml_arena_block;
+
+typedef struct _php_yaml_arena {
+	php_yaml_arena_block *block;
+	php_yaml_arena_block *spare;
+} php_yaml_arena;
+/* }}} */
+
+/* {{{ stage
+ * The entries of the collections being read, innermost last. They go
+ * into the array of their collection at its end, which can then be
+ * made for exactly that many. keys are in the arena, NULL in sequences.
+ */
+#define Y_STAGE_MIN_SIZE 8  /* what array_init() makes room for anyway */
+
+typedef struct _php_yaml_stage {
+	zval **values;
+	char **keys;
+	size_t count;
+	size_t size;
+} php_yaml_stage;
+/* }}} */
+
+/* {{{ anchors
+ * The nodes of a document that aliases may refer to, holding a
+ * reference to each until the end of the document. The names are
+ * copied one after the other into names, without terminators; the
+ * slots are found by open addressing and kept at most half full.
+ */
+#define Y_ANCHORS_MIN_SIZE 16
+
+typedef struct _php_yaml_anchor {
+	ulong hash;
+	size_t name;    /* offset in names */
+	size_t length;
+	zval *value;    /* NULL in an empty slot */
+} php_yaml_anchor;
+
+typedef struct _php_yaml_anchors {
+	php_yaml_anchor *slots;
+	size_t mask;
+	size_t count;
+	char *names;
+	size_t names_used;
+	size_t names_size;
+} php_yaml_anchors;
+/* }}} */
+
+/* {{{ resolved callbacks
+ * The tag callbacks of an array looked up once for all the calls that
+ * use it between php_yaml_callbacks_begin() and _end(), which may nest.
+ * The scalar handed to a scalar callback is kept for the next call if
+ * the callback didn't keep it. Needs zend_fcall_info_init() of PHP 5.3.
+ */
+#if ZEND_EXTENSION_API_NO >= 220090626 && !defined(IS_UNICODE)
+#define Y_RESOLVE_CALLBACKS 1
+#endif
+
+typedef struct _php_yaml_callback {
+	zval *callable;
+	int batch;              /* given as array('batch' => callable) */
+#ifdef Y_RESOLVE_CALLBACKS
+	zend_fcall_info fci;    /* size 0 if it couldn't be resolved */
+	zend_fcall_info_cache fcc;
+#endif
+	zval *arg;
+} php_yaml_callback;
+
+typedef struct _php_yaml_callbacks {
+	HashTable *callbacks;
+	HashTable resolved;     /* php_yaml_callback by tag */
+	int refcount;
+	struct _php_yaml_callbacks *next;
+} php_yaml_callbacks;
+/* }}} */
+
+/* {{{ batches
+ * The scalars of a document with a tag that has a batch callback. They
+ * are null until the end of the document, or until a collection filter
+ * might see them, when each callback gets all the scalars of its tag
+ * as written in one array and returns their values under the same
+ * indexes. A reference to each null value is held to fill it in place.
+ */
+typedef struct _php_yaml_batch {
+	char *tag;
+	zval *callable;
+	php_yaml_callback *cached;
+	zval *raw;
+	zval **values;
+	size_t count;
+	size_t size;
+} php_yaml_batch;
+/* }}} */
+
+typedef struct _php_yaml_source {
+	yaml_parser_t *parser;
+	php_yaml_event_list *list;
+	size_t pos;
+	/* zeroed by the initializers of the members above */
+	php_yaml_arena arena;
+	php_yaml_stage stage;
+	HashTable *batches;     /* php_yaml_batch by tag, NULL if none pending */
+} php_yaml_source;
+
+int
+php_yaml_record_events(yaml_parser_t *parser, php_yaml_event_list *list,
+		size_t offset, size_t line);
+
+int
+php_yaml_event_list_add(php_yaml_event_list *list, yaml_event_t *event);
+
+int
+php_yaml_next_event(php_yaml_source *source, yaml_event_t *event TSRMLS_DC);
+
+void
+php_yaml_event_list_free(php_yaml_event_list *list);
+/* }}} */
 
 zval *
-php_yaml_read_impl(yaml_parser_t *parser, yaml_event_t *parent,
-		zval *aliases, zval *zv, long *ndocs,
+php_yaml_read_impl(php_yaml_source *source, yaml_event_t *parent,
+		php_yaml_anchors *anchors, zval *zv, long *ndocs,
 		eval_scalar_func_t eval_func, HashTable *callbacks TSRMLS_DC);
 
-#define php_yaml_read_all(parser, ndocs, eval_func, callbacks) \
-	php_yaml_read_impl((parser), NULL, NULL, NULL, (ndocs), (eval_func), (callbacks) TSRMLS_CC)
+#define php_yaml_read_all(source, ndocs, eval_func, callbacks) \
+	php_yaml_read_impl((source), NULL, NULL, NULL, (ndocs), (eval_func), (callbacks) TSRMLS_CC)
 
 zval *
-php_yaml_read_partial(yaml_parser_t *parser, long pos, long *ndocs,
+php_yaml_read_partial(php_yaml_source *source, long pos, long *ndocs,
 		eval_scalar_func_t eval_func, HashTable *callbacks TSRMLS_DC);
 
 zval *
@@ -41,7 +171,28 @@ php_yaml_eval_scalar(yaml_event_t event, HashTable *callbacks TSRMLS_DC);
 zval *
 php_yaml_eval_scalar_with_callbacks(yaml_event_t event, HashTable *callbacks TSRMLS_DC);
 
+int
+php_yaml_apply_filter(zval **zpp, yaml_event_t event, HashTable *callbacks TSRMLS_DC);
+
+char *
+php_yaml_convert_to_char(zval *zv TSRMLS_DC);
+
 int
 php_yaml_check_callbacks(HashTable *callbacks TSRMLS_DC);
 
+void
+php_yaml_callbacks_begin(HashTable *callbacks TSRMLS_DC);
+
+void
+php_yaml_callbacks_end(HashTable *callbacks TSRMLS_DC);
+
+int
+php_yaml_limits_read(HashTable *options, php_yaml_limits *max TSRMLS_DC);
+
+void
+php_yaml_limits_begin(const php_yaml_limits *max, php_yaml_limits_saved *saved TSRMLS_DC);
+
+void
+php_yaml_limits_end(const php_yaml_limits_saved *saved TSRMLS_DC);
+
 #endif
@@ -40,6 +40,57 @@
 #include "TSRM.h"
 #endif
 
+/* {{{ per-call statistics */
+#define Y_STATS_NONE            0
+#define Y_STATS_PARSE           1
+#define Y_STATS_EMIT            2
+
+#define Y_STATS_NULL            0
+#define Y_STATS_BOOL            1
+#define Y_STATS_INT             2
+#define Y_STATS_FLOAT           3
+#define Y_STATS_TIMESTAMP       4
+#define Y_STATS_BINARY          5
+#define Y_STATS_STRING          6
+#define Y_STATS_SCALAR_TYPES    7
+
+typedef struct _php_yaml_stats {
+	int operation;
+	const char *function;
+	long events[YAML_MAPPING_END_EVENT + 1];
+	long scalars[Y_STATS_SCALAR_TYPES];
+	long bytes;
+	long allocations;
+	long memory;
+	/* wall times in seconds; only the total is measured unless
+	   yaml.collect_timings is on */
+	double time_total;
+	double time_libyaml;
+	double time_eval;
+	double time_callbacks;
+} php_yaml_stats;
+/* }}} */
+
+/* {{{ limits
+ * What one call may parse, from the yaml.max_* settings and the options
+ * of the call, 0 for no limit; and what it has parsed so far, depth
+ * being the collections open at the moment.
+ */
+typedef struct _php_yaml_limits {
+	long depth;
+	long nodes;
+	long scalar_bytes;
+	long aliases;
+	long documents;
+} php_yaml_limits;
+
+/* the limits and counts of a call, put aside while a callback parses */
+typedef struct _php_yaml_limits_saved {
+	php_yaml_limits limits;
+	php_yaml_limits used;
+} php_yaml_limits_saved;
+/* }}} */
+
 /* {{{ module globals */
 ZEND_BEGIN_MODULE_GLOBALS (yaml)
 	zend_bool decode_binary;
@@ -48,6 +99,23 @@ ZEND_BEGIN_MODULE_GLOBALS (yaml)
     zend_bool throw_exceptions;
 	long fill_column;
     zend_bool nomnom;
+	zend_bool collect_timings;
+	long parse_threads;
+	zend_bool parse_split_mapping;
+	long emit_threads;
+	long stream_chunk_size;
+	zend_bool fast_scanner;
+	zend_bool alias_references;
+	long max_depth;
+	long max_nodes;
+	long max_scalar_bytes;
+	long max_aliases;
+	long max_documents;
+	php_yaml_limits limits;
+	php_yaml_limits used;
+	struct _php_yaml_callbacks *resolved_callbacks;
+	php_yaml_stats stats;
+	int stats_depth;        /* calls going on, more than one from callbacks */
 #ifdef IS_UNICODE
 	UConverter *orig_runtime_encoding_conv;
 #endif
@@ -65,6 +133,7 @@ ZEND_DECLARE_MODULE_GLOBALS (yaml)
 /* {{{ module function prototypes */
 PHP_MINIT_FUNCTION (yaml);
 PHP_MSHUTDOWN_FUNCTION (yaml);
+PHP_RINIT_FUNCTION (yaml);
 PHP_MINFO_FUNCTION (yaml);
 
 #if ZEND_EXTENSION_API_NO < 220060519
@@ -79,12 +148,20 @@ PHP_GINIT_FUNCTION (yaml);
 PHP_FUNCTION (yaml_parse);
 PHP_FUNCTION (yaml_parse_file);
 PHP_FUNCTION (yaml_parse_url);
+PHP_FUNCTION (yaml_parse_files);
+PHP_FUNCTION (yaml_parse_file_from);
+PHP_FUNCTION (yaml_parse_lazy);
+PHP_FUNCTION (yaml_parse_document);
 PHP_FUNCTION (yaml_emit);
 PHP_FUNCTION (yaml_emit_file);
+PHP_FUNCTION (yaml_last_stats);
 /* }}} */
 
 typedef zval* (*eval_scalar_func_t)(yaml_event_t event, HashTable *callbacks TSRMLS_DC);
 
+double
+php_yaml_clock (void);
+
 extern zend_module_entry yaml_module_entry;
 #define phpext_yaml_ptr &yaml_module_entry;
 
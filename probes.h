@@ -0,0 +1,93 @@
+/**
+ * USDT probe points
+ *
+ * This file is part of php-yaml.
+ * php-yaml is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * php-yaml is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with php-yaml.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @package     php-yaml
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+#ifndef PHP_YAML_PROBES_H
+#define PHP_YAML_PROBES_H
+
+/*
+ * Statically defined tracing probes of the "php_yaml" provider, for
+ * bpftrace, SystemTap or perf. Only compiled in with --enable-yaml-usdt;
+ * otherwise every probe expands to nothing.
+ *
+ * parse__start     (char *function, char *source, long size)
+ * parse__end       (char *function, int ok, long ndocs, long bytes, long ns)
+ * emit__start      (char *function, char *target)
+ * emit__end        (char *function, int ok, long bytes, long ns)
+ * document__start  (long index, long offset)
+ * callback         (char *tag, long size, int ok, long ns)
+ * emitter__error   (int error, char *problem)
+ *
+ * source and target are NULL for in-memory input and output, size is -1
+ * when the input length is not known up front. Durations are wall times
+ * in nanoseconds.
+ *
+ * Each probe has a semaphore, counting the tracers attached to it, so
+ * that YAML_PROBE_ENABLED() can skip work done only for the probe.
+ */
+
+#ifdef HAVE_YAML_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/* defined in yaml.c */
+#define YAML_PROBE_SEMAPHORE(name) \
+	unsigned short php_yaml_##name##_semaphore
+extern YAML_PROBE_SEMAPHORE(parse__start);
+extern YAML_PROBE_SEMAPHORE(parse__end);
+extern YAML_PROBE_SEMAPHORE(emit__start);
+extern YAML_PROBE_SEMAPHORE(emit__end);
+extern YAML_PROBE_SEMAPHORE(document__start);
+extern YAML_PROBE_SEMAPHORE(callback);
+extern YAML_PROBE_SEMAPHORE(emitter__error);
+
+#define YAML_PROBE_ENABLED(name) \
+	__builtin_expect(php_yaml_##name##_semaphore, 0)
+
+#define YAML_PROBE2(name, a1, a2) \
+	STAP_PROBE2(php_yaml, name, a1, a2)
+#define YAML_PROBE3(name, a1, a2, a3) \
+	STAP_PROBE3(php_yaml, name, a1, a2, a3)
+#define YAML_PROBE4(name, a1, a2, a3, a4) \
+	STAP_PROBE4(php_yaml, name, a1, a2, a3, a4)
+#define YAML_PROBE5(name, a1, a2, a3, a4, a5) \
+	STAP_PROBE5(php_yaml, name, a1, a2, a3, a4, a5)
+#else
+#define YAML_PROBE_ENABLED(name) 0
+
+#define YAML_PROBE2(name, a1, a2)
+#define YAML_PROBE3(name, a1, a2, a3)
+#define YAML_PROBE4(name, a1, a2, a3, a4)
+#define YAML_PROBE5(name, a1, a2, a3, a4, a5)
+#endif
+
+#define YAML_PROBE_NS(seconds) ((long)((seconds) * 1e9))
+
+#endif /* PHP_YAML_PROBES_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: noet sw=4 ts=4 fdm=marker
+ * vim<600: noet sw=4 ts=4
+ */
@@ -0,0 +1,374 @@
+/**
+ * YamlPushParser, incremental parsing of chunked input
+ *
+ * This file is part of php-yaml.
+ * php-yaml is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * php-yaml is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with php-yaml.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * LibYAML can't suspend a parse when its input runs dry: a read handler
+ * that returns no data ends the stream. So instead of keeping a parser
+ * alive across chunks, the push parser buffers input only up to the
+ * next document boundary, a "---" or "..." line in column 0, and parses
+ * each completed run of documents on its own. Only the unfinished
+ * document stays in memory.
+ *
+ * @package     php-yaml
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <php.h>
+#include <php_ini.h>
+#include <yaml.h>
+#include <ext/standard/php_smart_str.h>
+#include "php_yaml.h"
+#include "zval_refcount.h" /* for PHP < 5.3 */
+#include "parser.h"
+#include "push_parser.h"
+
+zend_class_entry *php_yaml_push_parser_ce;
+
+typedef struct _php_yaml_push_parser {
+  zend_object std;
+  php_yaml_push_state state;
+} php_yaml_push_parser;
+
+/* {{{ php_yaml_push_parser_free () */
+static void
+php_yaml_push_parser_free (void *object TSRMLS_DC)
+{
+  php_yaml_push_parser *pp = (php_yaml_push_parser *)object;
+
+  php_yaml_push_free (&pp->state);
+  zend_object_std_dtor (&pp->std TSRMLS_CC);
+  efree (pp);
+}
+/* }}} */
+
+/* {{{ php_yaml_push_parser_new () */
+static zend_object_value
+php_yaml_push_parser_new (zend_class_entry *ce TSRMLS_DC)
+{
+  zend_object_value retval;
+  php_yaml_push_parser *pp = ecalloc (1, sizeof (php_yaml_push_parser));
+
+  zend_object_std_init (&pp->std, ce TSRMLS_CC);
+
+  retval.handle = zend_objects_store_put (pp, (zend_objects_store_dtor_t)zend_objects_destroy_object,
+                                          php_yaml_push_parser_free, NULL TSRMLS_CC);
+  retval.handlers = zend_get_std_object_handlers ();
+  return retval;
+}
+/* }}} */
+
+/* {{{ php_yaml_push_flush ()
+ * Parses bytes from..to of the buffer, which start at line line of the
+ * stream, and appends the documents to docs. A run of documents that
+ * fails to parse is appended as FALSE. */
+static void
+php_yaml_push_flush (php_yaml_push_state *state, size_t from, size_t to,
+                     size_t line, zval *docs TSRMLS_DC)
+{
+  yaml_parser_t parser;
+  php_yaml_event_list list;
+  php_yaml_source source = {NULL, NULL, 0};
+  HashTable *callbacks = NULL;
+  eval_scalar_func_t eval_func = php_yaml_eval_scalar;
+  zval *yaml, **entry;
+  long ndocs = 0;
+
+  if (state->callbacks != NULL)
+    {
+      callbacks = Z_ARRVAL_P (state->callbacks);
+      eval_func = php_yaml_eval_scalar_with_callbacks;
+    }
+
+  memset (&list, 0, sizeof (php_yaml_event_list));
+  if (!yaml_parser_initialize (&parser))
+    list.error.error = YAML_MEMORY_ERROR;
+  else
+    {
+      yaml_parser_set_input_string (&parser, (unsigned char *)state->buffer.c + from, to - from);
+      php_yaml_record_events (&parser, &list, state->offset + from, line);
+      yaml_parser_delete (&parser);
+    }
+
+  source.list = &list;
+  yaml = php_yaml_read_all (&source, &ndocs, eval_func, callbacks);
+  php_yaml_event_list_free (&list);
+
+  if (yaml == NULL)
+    {
+      add_next_index_bool (docs, 0);
+      return;
+    }
+
+  zend_hash_internal_pointer_reset (Z_ARRVAL_P (yaml));
+  while (zend_hash_get_current_data (Z_ARRVAL_P (yaml), (void **)&entry) == SUCCESS)
+    {
+      Z_ADDREF_PP (entry);
+      add_next_index_zval (docs, *entry);
+      zend_hash_move_forward (Z_ARRVAL_P (yaml));
+    }
+  zval_ptr_dtor (&yaml);
+}
+/* }}} */
+
+#define Y_LINE_IS_MARKER(buf, p, eol, c) \
+  ((eol) - (p) >= 4 && (buf)[p] == (c) && (buf)[(p) + 1] == (c) && (buf)[(p) + 2] == (c) \
+   && ((buf)[(p) + 3] == ' ' || (buf)[(p) + 3] == '\t' \
+       || (buf)[(p) + 3] == '\r' || (buf)[(p) + 3] == '\n'))
+
+/* {{{ php_yaml_push_scan ()
+ * Scans the complete lines received since the last call for document
+ * boundaries, parses what is complete into docs and drops it from the
+ * buffer. With final set, the rest of the buffer is parsed too. */
+static void
+php_yaml_push_scan (php_yaml_push_state *state, int final, zval *docs TSRMLS_DC)
+{
+  const char *buf = state->buffer.c;
+  size_t len = state->buffer.len;
+  size_t p = state->scan, line = state->scan_line;
+  size_t cut = 0, cut_line = state->line;
+
+  while (p < len)
+    {
+      const char *nl = memchr (buf + p, '\n', len - p);
+      size_t eol;
+
+      if (nl == NULL)
+        break;
+      eol = nl - buf + 1;
+
+      if (Y_LINE_IS_MARKER (buf, p, eol, '-'))
+        {
+          /* a document start ends the previous document, but not the
+             directives in front of it */
+          if (state->has_doc)
+            {
+              php_yaml_push_flush (state, cut, p, cut_line, docs TSRMLS_CC);
+              cut = p;
+              cut_line = line;
+            }
+          state->has_doc = 1;
+        }
+      else if (Y_LINE_IS_MARKER (buf, p, eol, '.'))
+        {
+          php_yaml_push_flush (state, cut, eol, cut_line, docs TSRMLS_CC);
+          cut = eol;
+          cut_line = line + 1;
+          state->has_doc = 0;
+        }
+      else if (!state->has_doc)
+        {
+          size_t i = p;
+
+          while (i < eol && (buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\r'))
+            i++;
+          if (buf[i] != '\n' && buf[i] != '#' && !(i == p && buf[i] == '%'))
+            state->has_doc = 1;
+        }
+
+      p = eol;
+      line++;
+    }
+
+  if (final && cut < len)
+    {
+      php_yaml_push_flush (state, cut, len, cut_line, docs TSRMLS_CC);
+      cut = p = len;
+      cut_line = line;
+    }
+
+  /* drop what has been parsed */
+  if (cut > 0)
+    {
+      memmove (state->buffer.c, state->buffer.c + cut, len - cut);
+      state->buffer.len = len - cut;
+      state->offset += cut;
+      state->line = cut_line;
+      p -= cut;
+    }
+  state->scan = p;
+  state->scan_line = line;
+}
+/* }}} */
+
+/* {{{ php_yaml_push_feed ()
+ * Adds length bytes of chunk to the input of state and appends the
+ * documents they complete to docs. */
+void
+php_yaml_push_feed (php_yaml_push_state *state, const char *chunk, size_t length,
+                    zval *docs TSRMLS_DC)
+{
+  smart_str_appendl (&state->buffer, chunk, length);
+  php_yaml_push_scan (state, 0, docs TSRMLS_CC);
+}
+/* }}} */
+
+/* {{{ php_yaml_push_finish ()
+ * Ends the input of state, appends the remaining documents to docs and
+ * resets state for a new stream. */
+void
+php_yaml_push_finish (php_yaml_push_state *state, zval *docs TSRMLS_DC)
+{
+  php_yaml_push_scan (state, 1, docs TSRMLS_CC);
+
+  smart_str_free (&state->buffer);
+  state->scan = state->scan_line = state->offset = state->line = 0;
+  state->has_doc = 0;
+}
+/* }}} */
+
+/* {{{ php_yaml_push_free () */
+void
+php_yaml_push_free (php_yaml_push_state *state)
+{
+  smart_str_free (&state->buffer);
+  if (state->callbacks != NULL)
+    zval_ptr_dtor (&state->callbacks);
+  if (state->options != NULL)
+    zval_ptr_dtor (&state->options);
+}
+/* }}} */
+
+/* {{{ proto void YamlPushParser::__construct ([array callbacks[, array options]]) */
+PHP_METHOD (YamlPushParser, __construct)
+{
+  php_yaml_push_parser *pp = (php_yaml_push_parser *)zend_object_store_get_object (getThis () TSRMLS_CC);
+  zval *zcallbacks = NULL;
+  zval *zoptions = NULL;
+  php_yaml_limits limits;
+
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "|a/a", &zcallbacks, &zoptions) == FAILURE)
+    return;
+
+  if (zoptions != NULL)
+    {
+      if (php_yaml_limits_read (Z_ARRVAL_P (zoptions), &limits TSRMLS_CC) == FAILURE)
+        return;
+
+      Z_ADDREF_P (zoptions);
+      pp->state.options = zoptions;
+    }
+
+  if (zcallbacks != NULL)
+    {
+      if (php_yaml_check_callbacks (Z_ARRVAL_P (zcallbacks) TSRMLS_CC) == FAILURE)
+        return;
+
+      Z_ADDREF_P (zcallbacks);
+      pp->state.callbacks = zcallbacks;
+    }
+}
+/* }}} */
+
+/* {{{ php_yaml_push_parser_run () */
+static void
+php_yaml_push_parser_run (INTERNAL_FUNCTION_PARAMETERS, int final)
+{
+  php_yaml_push_parser *pp = (php_yaml_push_parser *)zend_object_store_get_object (getThis () TSRMLS_CC);
+  HashTable *callbacks = pp->state.callbacks != NULL ? Z_ARRVAL_P (pp->state.callbacks) : NULL;
+  char *chunk = NULL;
+  int chunk_len = 0;
+  php_yaml_limits limits;
+  php_yaml_limits_saved saved_limits;
+
+  if (!final && zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s", &chunk, &chunk_len) == FAILURE)
+    return;
+
+#ifdef IS_UNICODE
+  YAML_G (orig_runtime_encoding_conv) = UG (runtime_encoding_conv);
+  UG (runtime_encoding_conv) = UG (utf8_conv);
+#endif
+  YAML_G (timestamp_decoder) = NULL;
+  /* checked by the constructor */
+  php_yaml_limits_read (pp->state.options != NULL ? Z_ARRVAL_P (pp->state.options) : NULL, &limits TSRMLS_CC);
+
+  array_init (return_value);
+  php_yaml_callbacks_begin (callbacks TSRMLS_CC);
+  php_yaml_limits_begin (&limits, &saved_limits TSRMLS_CC);
+  if (final)
+    php_yaml_push_finish (&pp->state, return_value TSRMLS_CC);
+  else
+    php_yaml_push_feed (&pp->state, chunk, (size_t)chunk_len, return_value TSRMLS_CC);
+  php_yaml_limits_end (&saved_limits TSRMLS_CC);
+  php_yaml_callbacks_end (callbacks TSRMLS_CC);
+
+#ifdef IS_UNICODE
+  UG (runtime_encoding_conv) = YAML_G (orig_runtime_encoding_conv);
+#endif
+}
+/* }}} */
+
+/* {{{ proto array YamlPushParser::feed (string chunk)
+   Adds input; returns the documents it completed */
+PHP_METHOD (YamlPushParser, feed)
+{
+  php_yaml_push_parser_run (INTERNAL_FUNCTION_PARAM_PASSTHRU, 0);
+}
+/* }}} */
+
+/* {{{ proto array YamlPushParser::finish ()
+   Ends the input; returns the remaining documents and resets the parser */
+PHP_METHOD (YamlPushParser, finish)
+{
+  php_yaml_push_parser_run (INTERNAL_FUNCTION_PARAM_PASSTHRU, 1);
+}
+/* }}} */
+
+/* {{{ argument information */
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_push_parser_construct, 0, 0, 0)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_push_parser_feed, 0, 0, 1)
+  ZEND_ARG_INFO (0, chunk)
+  ZEND_END_ARG_INFO ()
+/* }}} */
+
+/* {{{ php_yaml_push_parser_methods[] */
+static zend_function_entry php_yaml_push_parser_methods[] = {
+  PHP_ME (YamlPushParser, __construct, arginfo_yaml_push_parser_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+  PHP_ME (YamlPushParser, feed,        arginfo_yaml_push_parser_feed,      ZEND_ACC_PUBLIC)
+  PHP_ME (YamlPushParser, finish,      NULL,                               ZEND_ACC_PUBLIC)
+  { NULL, NULL, NULL }
+};
+/* }}} */
+
+/* {{{ php_yaml_push_parser_register () */
+void
+php_yaml_push_parser_register (TSRMLS_D)
+{
+  zend_class_entry ce;
+
+  INIT_CLASS_ENTRY (ce, "YamlPushParser", php_yaml_push_parser_methods);
+  ce.create_object = php_yaml_push_parser_new;
+  php_yaml_push_parser_ce = zend_register_internal_class (&ce TSRMLS_CC);
+  php_yaml_push_parser_ce->ce_flags |= ZEND_ACC_FINAL_CLASS;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: noet sw=4 ts=4 fdm=marker
+ * vim<600: noet sw=4 ts=4
+ */
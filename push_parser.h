@@ -0,0 +1,35 @@
+#ifndef PUSH_PARSER_H
+#define PUSH_PARSER_H
+
+/* {{{ push state
+ * Input buffered up to the next document boundary, a "---" or "..."
+ * line in column 0; see push_parser.c.
+ */
+typedef struct _php_yaml_push_state {
+	smart_str buffer;   /* input not parsed yet */
+	size_t scan;        /* start of the first line of buffer not scanned yet */
+	size_t scan_line;
+	size_t offset;      /* stream position of the start of buffer */
+	size_t line;
+	int has_doc;        /* whether the scanned part holds document content */
+	zval *callbacks;
+	zval *options;      /* limits of YamlPushParser, per call of feed/finish */
+} php_yaml_push_state;
+
+void
+php_yaml_push_feed(php_yaml_push_state *state, const char *chunk, size_t length,
+		zval *docs TSRMLS_DC);
+
+void
+php_yaml_push_finish(php_yaml_push_state *state, zval *docs TSRMLS_DC);
+
+void
+php_yaml_push_free(php_yaml_push_state *state);
+/* }}} */
+
+extern zend_class_entry *php_yaml_push_parser_ce;
+
+void
+php_yaml_push_parser_register (TSRMLS_D);
+
+#endif
@@ -0,0 +1,576 @@
+/**
+ * YAML scalar resolvers
+ *
+ * Copyright (C) 2007  Ryusuke SEKIYAMA. All rights reserved.
+ * Copyright (C) 2008  Alexander Kahl
+ *
+ * This file is part of php-yaml.
+ * php-yaml is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * php-yaml is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with php-yaml.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Pure string functions that classify and convert plain scalars. They
+ * need nothing from Zend but emalloc/efree and php_get_inf/php_get_nan,
+ * so bench/resolver_bench.c can build them against stubs with
+ * PHP_YAML_RESOLVER_STANDALONE defined.
+ *
+ * @package     php-yaml
+ * @author      Ryusuke SEKIYAMA <rsky0711@gmail.com>
+ * @author      Alexander Kahl <e-user@gmx.net>
+ * @copyright   2007 Ryusuke SEKIYAMA
+ * @copyright   2008 Alexander Kahl
+ * @license     http://www.gnu.org/licenses/lgpl.html  LGPLv3+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef PHP_YAML_RESOLVER_STANDALONE
+#include "bench/resolver_stubs.h"
+#else
+#include <php.h>
+#include <ext/standard/basic_functions.h>
+#endif
+#include "resolver.h"
+
+/* {{{ php_yaml_scalar_is_numeric() */
+int
+php_yaml_scalar_is_numeric(const char *value, size_t length,
+		long *lval, double *dval, char **str)
+{
+	const char* end = value + length;
+	char scratch[Y_SCALAR_SCRATCH_SIZE];
+	char *buf = NULL, *ptr = NULL;
+	int negative = 0;
+	int type = 0;
+
+	if (length == 0) {
+		goto not_numeric;
+	}
+
+	/* trim */
+	while (value < end && (*(end - 1) == ' ' || *(end - 1) == '\t')) {
+		end--;
+	}
+	while (value < end && (*value == ' ' || *value == '\t')) {
+		value++;
+	}
+	if (value == end) {
+		goto not_numeric;
+	}
+
+	/* not a number */
+	if (!strcmp(".NAN", value) || !strcmp(".NaN", value) || !strcmp(".nan", value)) {
+		type = Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_NAN;
+		goto finish;
+	}
+
+	/* sign */
+	if (*value == '+') {
+		value++;
+	} else if (*value == '-') {
+		negative = 1;
+		value++;
+	}
+	if (value == end) {
+		goto not_numeric;
+	}
+
+	/* infinity */
+	if (!strcmp(".INF", value) || !strcmp(".Inf", value) || !strcmp(".inf", value)) {
+		type = Y_SCALAR_IS_FLOAT;
+		type |= (negative ? Y_SCALAR_IS_INFINITY_N : Y_SCALAR_IS_INFINITY_P);
+		goto finish;
+	}
+
+	/* alloc: numbers are short, the copy goes on the stack unless the
+	   caller keeps it */
+	if (str == NULL && length + 3 <= sizeof(scratch)) {
+		buf = scratch;
+	} else {
+		buf = (char *)emalloc(length + 3);
+	}
+	ptr = buf;
+	if (negative) {
+		*ptr++ = '-';
+	}
+
+	/* parse */
+	if (*value == '0') {
+		*ptr++ = *value++;
+		if (value == end) {
+			goto return_zero;
+		}
+
+		if (*value == 'b') {
+			/* binary integer */
+			*ptr++ = *value++;
+			if (value == end) {
+				goto not_numeric;
+			}
+			while (value < end && (*value == '_' || *value == '0')) {
+				value++;
+			}
+			if (value == end) {
+				goto return_zero;
+			}
+			/* check the sequence */
+			while (value < end) {
+				if (*value == '_') {
+					*value++;
+				} else if (*value == '0' || *value == '1') {
+					*ptr++ = *value++;
+				} else {
+					goto not_numeric;
+				}
+			}
+			type = Y_SCALAR_IS_INT | Y_SCALAR_IS_BINARY;
+
+		} else if (*value == 'x') {
+			/* hexadecimal integer */
+			*ptr++ = *value++;
+			if (value == end) {
+				goto not_numeric;
+			}
+			while (value < end && (*value == '_' || *value == '0')) {
+				value++;
+			}
+			if (value == end) {
+				goto return_zero;
+			}
+			/* check the sequence */
+			while (value < end) {
+				if (*value == '_') {
+					*value++;
+				} else if ((*value >= '0' && *value <= '9') ||
+					(*value >= 'A' && *value <= 'F') ||
+					(*value >= 'a' && *value <= 'f'))
+				{
+					*ptr++ = *value++;
+				} else {
+					goto not_numeric;
+				}
+			}
+			type = Y_SCALAR_IS_INT | Y_SCALAR_IS_HEXADECIMAL;
+
+		} else if (*value == '_' || (*value >= '0' && *value <= '7')) {
+			/* octal integer */
+			while (value < end) {
+				if (*value == '_') {
+					*value++;
+				} else if (*value >= '0' && *value <= '7') {
+					*ptr++ = *value++;
+				} else {
+					goto not_numeric;
+				}
+			}
+			type = Y_SCALAR_IS_INT | Y_SCALAR_IS_OCTAL;
+
+		} else if (*value == '.') {
+			goto check_float;
+
+		} else {
+			goto not_numeric;
+		}
+
+	} else if (*value >= '1' && *value <= '9') {
+		/* integer */
+		*ptr++ = *value++;
+		while (value < end) {
+			if (*value == '_' || *value == ',') {
+				*value++;
+			} else if (*value >= '0' && *value <= '9') {
+				*ptr++ = *value++;
+			} else if (*value == ':') {
+				goto check_sexa;
+			} else if (*value == '.') {
+				goto check_float;
+			} else {
+				goto not_numeric;
+			}
+		}
+		type = Y_SCALAR_IS_INT | Y_SCALAR_IS_DECIMAL;
+
+	} else if (*value == ':') {
+		/* sexagecimal */
+	  check_sexa:
+		while (value < end - 2) {
+			if (*value == '.') {
+				type = Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_SEXAGECIMAL;
+				goto check_float;
+			}
+			if (*value != ':') {
+				goto not_numeric;
+			}
+			*ptr++ = *value++;
+			if (*(value + 1) == ':') {
+				if (*value >= '0' && *value <= '9') {
+					*ptr++ = *value++;
+				} else {
+					goto not_numeric;
+				}
+			} else {
+				if ((*value >= '0' && *value <= '5') &&
+					(*(value + 1) >= '0' && *(value + 1) <= '9'))
+				{
+					*ptr++ = *value++;
+					*ptr++ = *value++;
+				} else {
+					goto not_numeric;
+				}
+			}
+		}
+		if (*value == '.') {
+			type = Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_SEXAGECIMAL;
+			goto check_float;
+		} else if (value == end) {
+			type = Y_SCALAR_IS_INT | Y_SCALAR_IS_SEXAGECIMAL;
+		} else {
+			goto not_numeric;
+		}
+
+	} else if (*value == '.') {
+		/* float */
+		*ptr++ = '0';
+	  check_float:
+		*ptr++ = *value++;
+		if (type == (Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_SEXAGECIMAL)) {
+			/* sexagecimal float */
+			while (value < end && (*(end - 1) == '_' || *(end - 1) == '0')) {
+				end--;
+			}
+			if (value == end) {
+				*ptr++ = '0';
+			}
+			while (value < end) {
+				if (*value == '_') {
+					*value++;
+				} else if (*value >= '0' && *value <= '9') {
+					*ptr++ = *value++;
+				} else {
+					goto not_numeric;
+				}
+			}
+		} else {
+			/* decimal float */
+			int is_exp = 0;
+			while (value < end) {
+				if (*value == '_') {
+					*value++;
+				} else if (*value >= '0' && *value <= '9') {
+					*ptr++ = *value++;
+				} else if (*value == 'E' || *value == 'e') {
+					/* exponential */
+					is_exp = 1;
+					*ptr++ = *value++;
+					if (value == end || (*value != '+' && *value != '-')) {
+						goto not_numeric;
+					}
+					*ptr++ = *value++;
+					if (value == end || *value < '0' || *value > '9' || (*value == '0' && value + 1 == end)) {
+						goto not_numeric;
+					}
+					*ptr++ = *value++;
+					while (value < end) {
+						if (*value >= '0' && *value <= '9') {
+							*ptr++ = *value++;
+						} else {
+							goto not_numeric;
+						}
+					}
+				} else {
+					goto not_numeric;
+				}
+			}
+			/* trim */
+			if (!is_exp) {
+				while (*(ptr - 1) == '0') {
+					ptr--;
+				}
+				if (*(ptr - 1) == '.') {
+					*ptr++ = '0';
+				}
+			}
+			type = Y_SCALAR_IS_FLOAT | Y_SCALAR_IS_DECIMAL;
+		}
+
+	} else {
+		goto not_numeric;
+	}
+
+	/* terminate */
+	*ptr = '\0';
+
+  finish:
+	/* convert & assign */
+	if ((type & Y_SCALAR_IS_INT) && lval != NULL) {
+		switch (type & Y_SCALAR_FORMAT_MASK) {
+		  case Y_SCALAR_IS_BINARY:
+			ptr = buf + 2;
+			if (*ptr == 'b') {
+				ptr++;
+			}
+			*lval = strtol(ptr, (char **)NULL, 2);
+			if (*buf == '-') {
+				*lval *= -1L;
+			}
+			break;
+		  case Y_SCALAR_IS_OCTAL:
+			*lval = strtol(buf, (char **)NULL, 8);
+			break;
+		  case Y_SCALAR_IS_HEXADECIMAL:
+			*lval = strtol(buf, (char **)NULL, 16);
+			break;
+		  case Y_SCALAR_IS_SEXAGECIMAL:
+			*lval = php_yaml_eval_sexagesimal_l(0, buf, ptr);
+			if (*buf == '-') {
+				*lval *= -1L;
+			}
+			break;
+		  default:
+			*lval = atol(buf);
+		}
+	} else if ((type & Y_SCALAR_IS_FLOAT) && dval != NULL) {
+		switch (type & Y_SCALAR_FORMAT_MASK) {
+		  case Y_SCALAR_IS_SEXAGECIMAL:
+			*dval = php_yaml_eval_sexagesimal_d(0.0, buf, ptr);
+			if (*buf == '-') {
+				*dval *= -1.0;
+			}
+			break;
+		  case Y_SCALAR_IS_INFINITY_P:
+			*dval = php_get_inf();
+			break;
+		  case Y_SCALAR_IS_INFINITY_N:
+			*dval = -php_get_inf();
+			break;
+		  case Y_SCALAR_IS_NAN:
+			*dval = php_get_nan();
+			break;
+		  default:
+			*dval = atof(buf);
+		}
+	}
+	if (buf != NULL) {
+		if (str != NULL) {
+			*str = buf;
+		} else if (buf != scratch) {
+			efree(buf);
+		}
+	}
+
+	/* return */
+	return type;
+
+  return_zero:
+	if (lval != NULL) {
+		*lval = 0;
+	}
+	if (dval != NULL) {
+		*dval = 0.0;
+	}
+	if (buf != NULL && buf != scratch) {
+		efree(buf);
+	}
+	return (Y_SCALAR_IS_INT | Y_SCALAR_IS_ZERO);
+
+  not_numeric:
+	if (buf != NULL && buf != scratch) {
+		efree(buf);
+	}
+	return Y_SCALAR_IS_NOT_NUMERIC;
+}
+/* }}} */
+
+/* {{{ php_yaml_scalar_may_be_numeric()
+ * Cheap test that rules out most strings php_yaml_scalar_is_numeric()
+ * would reject, without allocating.
+ */
+int
+php_yaml_scalar_may_be_numeric(const char *value, size_t length)
+{
+	const char *end = value + length;
+
+	while (value < end && (*value == ' ' || *value == '\t')) {
+		value++;
+	}
+	if (value < end && (*value == '+' || *value == '-')) {
+		value++;
+	}
+	return value < end && ((*value >= '0' && *value <= '9') ||
+			*value == '.' || *value == ':');
+}
+/* }}} */
+
+#define ts_skip_space() \
+	while (ptr < end && (*ptr == ' ' || *ptr == '\t')) { \
+		ptr++; \
+	}
+
+#define ts_skip_number() \
+	while (ptr < end && *ptr >= '0' && *ptr <= '9') { \
+		ptr++; \
+	}
+
+/* {{{ php_yaml_scalar_is_timestamp()
+ * timestamp specification is found at http://yaml.org/type/timestamp.html.
+ */
+int
+php_yaml_scalar_is_timestamp(const char *value, size_t length)
+{
+	const char *ptr = value;
+	const char *end = value + length;
+	const char *pos1, *pos2;
+
+	/* skip leading space */
+	ts_skip_space();
+
+	/* check year and separator */
+	pos1 = pos2 = ptr;
+	ts_skip_number();
+	if (ptr == pos1 || ptr == end || ptr - pos2 != 4 || *ptr != '-') {
+		return 0;
+	}
+
+	/* check month and separator */
+	pos2 = ++ptr;
+	ts_skip_number();
+	if (ptr == pos2 || ptr == end || ptr - pos2 > 2 || *ptr != '-') {
+		return 0;
+	}
+
+	/* check day and separator */
+	pos2 = ++ptr;
+	ts_skip_number();
+	if (ptr == pos2 || ptr - pos2 > 2) {
+		return 0;
+	}
+
+	/* check separator */
+	pos2 = ptr;
+	ts_skip_space();
+	if (ptr == end) {
+		return (pos2 - pos1 == 10) ? 1 : 0;
+	}
+	if (*ptr == 'T' || *ptr == 't') {
+		*ptr++;
+	}
+
+	/* check hour and separator */
+	pos1 = ptr;
+	ts_skip_number();
+	if (ptr == pos1 || ptr == end || ptr - pos1 > 2 || *ptr != ':') {
+		return 0;
+	}
+
+	/* check minute and separator */
+	pos1 = ++ptr;
+	ts_skip_number();
+	if (ptr == end || ptr - pos1 != 2 || *ptr != ':') {
+		return 0;
+	}
+
+	/* check second */
+	pos1 = ++ptr;
+	ts_skip_number();
+	if (ptr == end) {
+		return (ptr - pos1 == 2) ? 1 : 0;
+	}
+
+	/* check fraction */
+	if (*ptr == '.') {
+		ptr++;
+		ts_skip_number();
+	}
+
+	/* skip separator space */
+	ts_skip_space();
+	if (ptr == end) {
+		return 1;
+	}
+
+	/* check time zone */
+	if (*ptr == 'Z') {
+		ptr++;
+		ts_skip_space();
+		return (ptr == end) ? 1 : 0;
+	}
+	if (*ptr != '+' && *ptr != '-') {
+		return 0;
+	}
+	pos1 = ++ptr;
+	ts_skip_number();
+	if (ptr - pos1 == 0 || ptr - pos1 > 4) {
+		return 0;
+	}
+	if (ptr - pos1 < 3 && *ptr == ':') {
+		pos1 = ++ptr;
+		ts_skip_number();
+		if (ptr - pos1 != 2) {
+			return 0;
+		}
+	}
+
+	/* skip following space */
+	ts_skip_space();
+	return (ptr == end) ? 1 : 0;
+}
+/* }}} */
+
+/* {{{ php_yaml_eval_sexagesimal_l() */
+long
+php_yaml_eval_sexagesimal_l(long lval, char *sg, char *eos)
+{
+	char *ep;
+	while (sg < eos && (*sg < '0' || *sg > '9')) {
+		*sg++;
+	}
+	ep = sg;
+	while (ep < eos && *ep >= '0' && *ep <= '9') {
+		*ep++;
+	}
+	if (sg == eos) {
+		return lval;
+	}
+	return php_yaml_eval_sexagesimal_l(lval * 60 + strtol(sg, (char **)NULL, 10), ep, eos);
+}
+/* }}} */
+
+/* {{{ php_yaml_eval_sexagesimal_d() */
+double
+php_yaml_eval_sexagesimal_d(double dval, char *sg, char *eos)
+{
+	char *ep;
+	while (sg < eos && *sg != '.' && (*sg < '0' || *sg > '9')) {
+		*sg++;
+	}
+	ep = sg;
+	while (ep < eos && *ep >= '0' && *ep <= '9') {
+		*ep++;
+	}
+	if (sg == eos || *sg == '.') {
+		return dval;
+	}
+	return php_yaml_eval_sexagesimal_d(dval * 60.0 + strtod(sg, (char **)NULL), ep, eos);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: noet sw=4 ts=4 fdm=marker
+ * vim<600: noet sw=4 ts=4
+ */
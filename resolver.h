@@ -0,0 +1,37 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#define Y_SCALAR_IS_NOT_NUMERIC 0x00
+#define Y_SCALAR_IS_INT         0x10
+#define Y_SCALAR_IS_FLOAT       0x20
+#define Y_SCALAR_IS_ZERO        0x00
+#define Y_SCALAR_IS_BINARY      0x01
+#define Y_SCALAR_IS_OCTAL       0x02
+#define Y_SCALAR_IS_DECIMAL     0x03
+#define Y_SCALAR_IS_HEXADECIMAL 0x04
+#define Y_SCALAR_IS_SEXAGECIMAL 0x05
+#define Y_SCALAR_IS_INFINITY_P  0x06
+#define Y_SCALAR_IS_INFINITY_N  0x07
+#define Y_SCALAR_IS_NAN         0x08
+#define Y_SCALAR_FORMAT_MASK    0x0F
+
+/* candidates up to this size are copied on the stack */
+#define Y_SCALAR_SCRATCH_SIZE   64
+
+int
+php_yaml_scalar_is_numeric(const char *value, size_t length,
+		long *lval, double *dval, char **str);
+
+int
+php_yaml_scalar_may_be_numeric(const char *value, size_t length);
+
+int
+php_yaml_scalar_is_timestamp(const char *value, size_t length);
+
+long
+php_yaml_eval_sexagesimal_l(long lval, char *sg, char *eos);
+
+double
+php_yaml_eval_sexagesimal_d(double dval, char *sg, char *eos);
+
+#endif
@@ -0,0 +1,48 @@
+--TEST--
+yaml.emit_threads renders a large top-level array in parallel
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--INI--
+yaml.emit_threads=4
+--FILE--
+<?php
+$list = array();
+$hash = array();
+for ($i = 0; $i < 20000; $i++) {
+	switch ($i % 5) {
+	case 0: $value = "string $i"; break;
+	case 1: $value = array('a' => $i, 'b' => array($i, true, null)); break;
+	case 2: $value = $i / 4; break;
+	case 3: $value = "multi\nline: $i"; break;
+	default: $value = range(0, $i % 9); break;
+	}
+	$list[] = $value;
+	$hash["key $i"] = $value;
+}
+
+foreach (array($list, $hash) as $data) {
+	$parallel = yaml_emit($data);
+	ini_set('yaml.emit_threads', 0);
+	$serial = yaml_emit($data);
+	ini_set('yaml.emit_threads', 4);
+
+	var_dump($parallel === $serial, yaml_parse($parallel) === $data);
+}
+echo substr($parallel, 0, 33), "\n";
+echo substr($parallel, -22);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+---
+key 0: string 0
+key 1:
+  a: 1
+key 19999: [0, 1]
+...
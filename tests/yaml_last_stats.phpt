@@ -0,0 +1,47 @@
+--TEST--
+yaml_last_stats() function
+--SKIPIF--
+<?php 
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--FILE--
+<?php
+var_dump(yaml_last_stats());
+
+yaml_parse("a: 1\nb: [true, ~, 1.5, text]\n");
+$stats = yaml_last_stats();
+echo $stats['operation'], "\n";
+echo $stats['events']['mapping_start'], ' ', $stats['events']['sequence_start'], ' ', $stats['events']['scalar'], "\n";
+echo $stats['scalars']['int'], $stats['scalars']['bool'], $stats['scalars']['null'], $stats['scalars']['float'], $stats['scalars']['string'], "\n";
+echo $stats['bytes'], "\n";
+
+yaml_emit(array(1, 'two'));
+$stats = yaml_last_stats();
+echo $stats['operation'], ' ', $stats['events']['scalar'], ' ', $stats['bytes'] > 0 ? 'ok' : 'fail', "\n";
+
+// a parse in a callback leaves the statistics of the call alone, and
+// the time of the callbacks is not part of eval
+ini_set('yaml.collect_timings', 1);
+$inner = array('!inner' => function ($v) {
+	usleep(20000);
+	return yaml_parse("[1, 2, 3]");
+});
+yaml_parse("a: !inner x\nb: 2\n", 0, $n, $inner);
+$stats = yaml_last_stats();
+echo $stats['events']['mapping_start'], ' ', $stats['events']['sequence_start'], ' ', $stats['events']['scalar'], "\n";
+var_dump($stats['time']['callbacks'] >= 0.02, $stats['time']['eval'] < 0.02,
+	$stats['time']['eval'] + $stats['time']['callbacks'] <= $stats['time']['total']);
+?>
+--EXPECT--
+bool(false)
+parse
+1 1 7
+11111
+29
+emit 2 ok
+1 0 4
+bool(true)
+bool(true)
+bool(true)
@@ -8,7 +8,56 @@ if(!extension_loaded('yaml')) die('skip');
  ?>
 --FILE--
 <?php
-echo 'OK'; // no test case for this function yet
+$yaml = "--- first\n--- [second, 2]\n--- third: [\n";
+
+var_dump(yaml_parse($yaml, 1));
+
+// counting the documents reads the whole stream, which has an error
+var_dump(@yaml_parse($yaml, 1, $ndocs), $ndocs);
+
+var_dump(count(@yaml_parse("--- 1\n--- 2\n", -1, $ndocs)), $ndocs);
+
+// mapping keys, nested, longer than a block of the key arena and from aliases
+$long = str_repeat('k', 10000);
+$doc = yaml_parse("a:\n  ? $long\n  :\n    b: 1\n  &x c: 2\n*x : 3\n");
+var_dump(strlen(key($doc['a'])), $doc['a'][$long], $doc['a']['c'], $doc['c']);
+var_dump(@yaml_parse("a:\n  b:\n    c: [1\n"));
+
+// collections made for their size at the end, in order, last duplicate key winning
+$doc = yaml_parse("s: [" . implode(', ', range(1, 20)) . "]\nm: {a: 1, b: 2, c: 3, d: 4, e: 5, f: 6, g: 7, h: 8, i: 9, a: 10}\n");
+var_dump($doc['s'] === range(1, 20), implode(',', array_keys($doc['m'])), $doc['m']['a']);
+
+// anchors redefined, on keys and per document
+$doc = yaml_parse("a: &x 1\nb: &x 2\n? &k [k]\n: *x\nc: *k\n");
+var_dump($doc['b'], $doc[serialize(array('k'))], $doc['c']);
+var_dump(@yaml_parse("--- &x 1\n--- *x\n", -1));
 ?>
 --EXPECT--
-OK
\ No newline at end of file
+array(2) {
+  [0]=>
+  string(6) "second"
+  [1]=>
+  int(2)
+}
+bool(false)
+int(-1)
+int(2)
+int(2)
+int(10000)
+array(1) {
+  ["b"]=>
+  int(1)
+}
+int(2)
+int(3)
+bool(false)
+bool(true)
+string(17) "a,b,c,d,e,f,g,h,i"
+int(10)
+int(2)
+int(2)
+array(1) {
+  [0]=>
+  string(1) "k"
+}
+bool(false)
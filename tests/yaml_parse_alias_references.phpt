@@ -0,0 +1,46 @@
+--TEST--
+yaml.alias_references=0 shares anchored nodes as plain values
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--INI--
+yaml.alias_references=0
+--FILE--
+<?php
+$doc = yaml_parse("a: &x [1, 2]\nb: *x\nc: &s str\nd: *s\n");
+$doc['a'][] = 3;
+$doc['c'] = 'changed';
+var_dump($doc);
+
+ini_set('yaml.alias_references', 1);
+$doc = yaml_parse("a: &x [1, 2]\nb: *x\n");
+$doc['a'][] = 3;
+var_dump(count($doc['b']));
+?>
+--EXPECT--
+array(4) {
+  ["a"]=>
+  array(3) {
+    [0]=>
+    int(1)
+    [1]=>
+    int(2)
+    [2]=>
+    int(3)
+  }
+  ["b"]=>
+  array(2) {
+    [0]=>
+    int(1)
+    [1]=>
+    int(2)
+  }
+  ["c"]=>
+  string(7) "changed"
+  ["d"]=>
+  string(3) "str"
+}
+int(3)
@@ -0,0 +1,61 @@
+--TEST--
+yaml_parse - batch callbacks called once per tag and document
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--FILE--
+<?php
+$calls = array();
+$callbacks = array(
+	'!ip' => array('batch' => function ($raw) use (&$calls) {
+		$calls[] = 'ip: ' . implode(', ', $raw);
+		return array_map('ip2long', $raw);
+	}),
+	'!n' => array('batch' => function ($raw) use (&$calls) {
+		$calls[] = 'n: ' . implode(', ', $raw);
+		return array_map('intval', $raw);
+	}),
+	'!sum' => function ($list) {
+		return array_sum($list);
+	},
+	'!short' => array('batch' => function ($raw) {
+		return array();
+	}),
+);
+
+$yaml = <<<YAML
+a: &x !ip 10.0.0.1
+b: [!ip 10.0.0.2, !ip 10.0.0.3]
+c: !n 7
+d: *x
+e: !sum [!n 1, !n 2]
+---
+f: !ip 10.0.0.4
+YAML;
+
+echo json_encode(yaml_parse($yaml, -1, $n, $callbacks)), "\n";
+echo implode("\n", $calls), "\n";
+
+var_dump(yaml_parse("!n 3", 0, $n, $callbacks));
+
+// a collection key is made of the values
+var_dump(yaml_parse("? [!n 5]\n: x\n", 0, $n, $callbacks));
+
+var_dump(yaml_parse("- !short a\n- !short b\n", 0, $n, $callbacks));
+?>
+--EXPECTF--
+[{"a":167772161,"b":[167772162,167772163],"c":7,"d":167772161,"e":3},{"f":167772164}]
+ip: 10.0.0.1, 10.0.0.2, 10.0.0.3
+n: 7, 1, 2
+ip: 10.0.0.4
+int(3)
+array(1) {
+  ["a:1:{i:0;i:5;}"]=>
+  string(1) "x"
+}
+
+Warning: yaml_parse(): Batch callback for tag '!short' returned no value for entry 0 in %s on line %d
+bool(false)
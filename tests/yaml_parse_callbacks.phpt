@@ -0,0 +1,70 @@
+--TEST--
+yaml_parse - tag callbacks resolved once per parse
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--FILE--
+<?php
+class Money {
+	public $seen = array();
+	function parse($v) {
+		$this->seen[] = $v;
+		return (int)$v * 100;
+	}
+	static function total($list) {
+		return array_sum($list);
+	}
+}
+
+$money = new Money();
+$callbacks = array(
+	'!cents' => array($money, 'parse'),
+	'!sum' => 'Money::total',
+	'!inner' => function ($v) use (&$callbacks) {
+		return yaml_parse("!cents $v", 0, $n, $callbacks);
+	},
+);
+
+$yaml = "a: !cents 1\nb: !cents 2\nc: !sum [!cents 3, !cents 4]\nd: !inner 5\ne: !cents 6\n";
+var_dump(yaml_parse($yaml, 0, $n, $callbacks));
+var_dump($money->seen);
+
+// a shared argument is separated for a by-reference parameter
+ini_set('yaml.alias_references', 0);
+$byref = array('!list' => function (&$list) {
+	$list[] = 'x';
+	return $list;
+});
+echo json_encode(yaml_parse("a: &l !list [1]\nb: *l\n", 0, $n, $byref)), "\n";
+?>
+--EXPECT--
+array(5) {
+  ["a"]=>
+  int(100)
+  ["b"]=>
+  int(200)
+  ["c"]=>
+  int(700)
+  ["d"]=>
+  int(500)
+  ["e"]=>
+  int(600)
+}
+array(6) {
+  [0]=>
+  string(1) "1"
+  [1]=>
+  string(1) "2"
+  [2]=>
+  string(1) "3"
+  [3]=>
+  string(1) "4"
+  [4]=>
+  string(1) "5"
+  [5]=>
+  string(1) "6"
+}
+{"a":[1,"x"],"b":[1]}
@@ -0,0 +1,64 @@
+--TEST--
+yaml_parse_document - look up paths in a YamlDocument
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--FILE--
+<?php
+$yaml = <<<YAML
+---
+a:
+  b:
+    - x
+    - y
+    - {c: 7, d: [1, 2]}
+  e: &e {f: g}
+h: *e
+"dotted.key": 1
+...
+YAML;
+
+$doc = yaml_parse_document($yaml);
+var_dump(get_class($doc), count($doc));
+var_dump($doc->get('a.b[2].c'), $doc->get('a.b.1'), $doc->get('h.f'));
+var_dump($doc->get(array('dotted.key')), $doc->get('a.b[3]', 'none'), $doc->get('a.nope'));
+var_dump(get_class($doc->get('a.b[2].d')), $doc->get('a.b[2].d')->toArray());
+var_dump($doc->exists('a.e'), $doc->exists('a.e.g'), $doc->exists(''));
+var_dump($doc->count('a.b'), $doc->count('a.b[0]'), $doc->count('a.z'));
+
+$copy = unserialize(serialize($doc));
+var_dump(get_class($copy), $copy->get('a.b[2].c'), $copy->get('h.f'));
+var_dump(yaml_parse_document($yaml, 1));
+$doc->get('a.b[2');
+?>
+--EXPECTF--
+string(12) "YamlDocument"
+int(3)
+int(7)
+string(1) "y"
+string(1) "g"
+int(1)
+string(4) "none"
+NULL
+string(8) "YamlNode"
+array(2) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(2)
+}
+bool(true)
+bool(false)
+bool(true)
+int(3)
+int(1)
+int(0)
+string(12) "YamlDocument"
+int(7)
+string(1) "g"
+bool(false)
+
+Warning: YamlDocument::get(): Malformed path a.b[2 in %s on line %d
@@ -0,0 +1,53 @@
+--TEST--
+yaml.fast_scanner gives the same result as LibYAML
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--INI--
+yaml.fast_scanner=1
+--FILE--
+<?php
+// in the subset
+$fast = array(
+	"a: 1\nb:\n- x\n- 'it''s'\n- \"\\u00e9\\t\"\nc:\n  d: true # comment\n  e: 2001-12-14\n",
+	"---\n- - 1\n  - ~\n-\n---\nkey:\n",
+	"- \"\\L\\L\\L\\L\\L\\L\"\n- \"\\P\\Lx\\P\"\n",
+);
+// left to LibYAML
+$libyaml = array(
+	"a: &x [1, 2]\nb: *x\n",
+	"a: |\n  text\nb: plain\n  continued\n",
+	"a: b: c\n",
+	"a" . str_repeat(' ', 1100) . ": b\n",
+);
+
+foreach (array_merge($fast, $libyaml) as $input) {
+	$with = @yaml_parse($input, -1, $ndocs);
+	ini_set('yaml.fast_scanner', 0);
+	$without = @yaml_parse($input, -1);
+	ini_set('yaml.fast_scanner', 1);
+	var_dump($with === $without, $ndocs);
+}
+
+// only the wanted document is parsed without ndocs, as before
+var_dump(yaml_parse("--- 1\n--- [2\n", 0));
+?>
+--EXPECTF--
+bool(true)
+int(1)
+bool(true)
+int(2)
+bool(true)
+int(1)
+bool(true)
+int(1)
+bool(true)
+int(1)
+bool(true)
+int(%d)
+bool(true)
+int(%d)
+int(1)
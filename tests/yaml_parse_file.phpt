@@ -4,11 +4,33 @@ yaml_parse_file() function
 <?php 
 
 if(!extension_loaded('yaml')) die('skip');
+if(!extension_loaded('zlib')) die('skip zlib extension required');
 
  ?>
+--INI--
+yaml.stream_chunk_size=1024
 --FILE--
 <?php
-echo 'OK'; // no test case for this function yet
+$file = dirname(__FILE__) . '/parse_file.yaml.gz';
+$gz = gzopen($file, 'wb');
+for ($i = 0; $i < 5000; $i++) {
+	gzwrite($gz, "--- {id: $i, list: [a, b, c]}\n");
+}
+gzclose($gz);
+
+// compressed input is read as a stream, without a temporary file
+$doc = yaml_parse_file("compress.zlib://$file", 4999, $ndocs);
+var_dump($doc['id'], $ndocs);
+var_dump(count(yaml_parse_file("compress.zlib://$file", -1)));
+
+var_dump(@yaml_parse_file(dirname(__FILE__) . '/parse_file_missing.yaml'));
+?>
+--CLEAN--
+<?php
+@unlink(dirname(__FILE__) . '/parse_file.yaml.gz');
 ?>
 --EXPECT--
-OK
\ No newline at end of file
+int(4999)
+int(5000)
+int(5000)
+bool(false)
@@ -0,0 +1,37 @@
+--TEST--
+yaml_parse_file_from() function
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--FILE--
+<?php
+$file = dirname(__FILE__) . '/yaml_parse_file_from.yaml';
+file_put_contents($file, "--- 1\n--- {a: 2}\n--- [3,\n");
+
+$docs = yaml_parse_file_from($file, 0, $next);
+echo json_encode($docs), " $next\n";
+
+// the trailing document is complete once the next one starts
+file_put_contents($file, " 4]\n--- !x five\n...\n--- 6", FILE_APPEND);
+$docs = yaml_parse_file_from($file, $next, $next,
+	array('!x' => function ($v) { return strtoupper($v); }));
+echo json_encode($docs), " $next\n";
+
+// nothing new yet
+$docs = yaml_parse_file_from($file, $next, $next);
+echo json_encode($docs), " $next\n";
+
+var_dump(@yaml_parse_file_from($file, -1));
+?>
+--CLEAN--
+<?php
+@unlink(dirname(__FILE__) . '/yaml_parse_file_from.yaml');
+?>
+--EXPECT--
+[1,{"a":2}] 17
+[[3,4],"FIVE"] 45
+[] 45
+bool(false)
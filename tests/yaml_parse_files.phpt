@@ -0,0 +1,46 @@
+--TEST--
+yaml_parse_files() function
+--SKIPIF--
+<?php 
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--INI--
+yaml.parse_threads=2
+--FILE--
+<?php
+$dir = dirname(__FILE__);
+file_put_contents("$dir/parse_files_a.yaml", "a: 1\nb: [x, y]\n");
+file_put_contents("$dir/parse_files_b.yaml", "--- 1\n--- two\n");
+file_put_contents("$dir/parse_files_c.yaml", "a: [1\n");
+
+$files = array("$dir/parse_files_a.yaml", "$dir/parse_files_b.yaml",
+               "$dir/parse_files_c.yaml", "$dir/parse_files_missing.yaml");
+$result = @yaml_parse_files($files, -1, $ndocs);
+foreach ($files as $file) {
+	echo basename($file), ' ', json_encode($result[$file]), ' ', $ndocs[$file], "\n";
+}
+
+$result = yaml_parse_files(array("$dir/parse_files_b.yaml"), 1);
+var_dump($result["$dir/parse_files_b.yaml"]);
+
+// the limits apply to each file on its own
+$result = yaml_parse_files(array("$dir/parse_files_a.yaml", "$dir/parse_files_b.yaml"),
+                           -1, $ndocs, array(), array('max_documents' => 2));
+echo json_encode(array_values($result)), "\n";
+?>
+--CLEAN--
+<?php
+$dir = dirname(__FILE__);
+@unlink("$dir/parse_files_a.yaml");
+@unlink("$dir/parse_files_b.yaml");
+@unlink("$dir/parse_files_c.yaml");
+?>
+--EXPECT--
+parse_files_a.yaml [{"a":1,"b":["x","y"]}] 1
+parse_files_b.yaml [1,"two"] 2
+parse_files_c.yaml false -1
+parse_files_missing.yaml false -1
+string(3) "two"
+[[{"a":1,"b":["x","y"]}],[1,"two"]]
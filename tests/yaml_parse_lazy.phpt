@@ -0,0 +1,63 @@
+--TEST--
+yaml_parse_lazy - read a document through YamlNode
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--FILE--
+<?php
+$yaml = <<<YAML
+---
+name: catalog
+items:
+  - &first {id: 1, price: 9.5, tags: [a, b]}
+  - {id: 2, when: 2001-12-14}
+  - *first
+1: one
+money: !money 12
+...
+---
+second
+YAML;
+
+$doc = yaml_parse_lazy($yaml, 0, array('!money' => function ($v) { return "$v EUR"; }));
+var_dump(get_class($doc), count($doc), $doc['name'], $doc[1], $doc['1'], $doc['money']);
+var_dump(isset($doc['items']), isset($doc['nope']), count($doc['items']));
+var_dump(get_class($doc['items'][0]), $doc['items'][0]['price'], $doc['items'][2]['tags'][1]);
+foreach ($doc['items'][1] as $k => $v) {
+	var_dump($k, $v);
+}
+$full = yaml_parse($yaml);
+var_dump($doc['items']->toArray() === $full['items']);
+var_dump(yaml_parse_lazy($yaml, 1), yaml_parse_lazy($yaml, 2));
+// an alias to a key is the key as written
+$keys = yaml_parse_lazy("&k 1: x\nb: *k\n");
+var_dump($keys['b'], $keys->toArray() === yaml_parse("&k 1: x\nb: *k\n"));
+$doc['name'] = 'x';
+?>
+--EXPECTF--
+string(8) "YamlNode"
+int(4)
+string(7) "catalog"
+string(3) "one"
+string(3) "one"
+string(6) "12 EUR"
+bool(true)
+bool(false)
+int(3)
+string(8) "YamlNode"
+float(9.5)
+string(1) "b"
+string(2) "id"
+int(2)
+string(4) "when"
+int(%d)
+bool(true)
+string(6) "second"
+bool(false)
+string(1) "1"
+bool(true)
+
+Warning: YamlNode::offsetSet(): YamlNode is read-only in %s on line %d
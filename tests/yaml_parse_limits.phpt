@@ -0,0 +1,75 @@
+--TEST--
+yaml_parse - resource limits from ini settings and options
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--INI--
+yaml.max_depth=3
+--FILE--
+<?php
+$deep = "a: {b: {c: {d: 1}}}";
+$doc = "a: &x [1, 2, 3]\nb: *x\nc: *x\n";
+
+var_dump(yaml_parse("a: {b: {c: 1}}"));
+var_dump(yaml_parse($deep));
+var_dump(yaml_parse($deep, 0, $n, array(), array('max_depth' => 0)) !== false);
+
+var_dump(yaml_parse($doc, 0, $n, array(), array('max_nodes' => 10)) !== false);
+var_dump(yaml_parse($doc, 0, $n, array(), array('max_nodes' => 9)));
+var_dump(yaml_parse($doc, 0, $n, array(), array('max_aliases' => 1)));
+var_dump(yaml_parse("a: 1234\nb: 56789\n", 0, $n, array(), array('max_scalar_bytes' => 8)));
+var_dump(yaml_parse("--- 1\n--- 2\n--- 3\n", -1, $n, array(), array('max_documents' => 2)));
+
+var_dump(yaml_parse_lazy($deep, 0, array(), array('max_depth' => 2)));
+var_dump(yaml_parse($doc, 0, $n, array(), array('max_nodez' => 1)));
+var_dump(yaml_parse($doc, 0, $n, array(), array('max_nodes' => -1)));
+
+// a parse in a callback has limits of its own and leaves those of the call
+$inner = array('!inner' => function ($v) {
+	return yaml_parse($v);
+});
+var_dump(yaml_parse("- !inner x\n- 2\n- 3\n- 4\n", 0, $n, $inner, array('max_nodes' => 3)));
+?>
+--EXPECTF--
+array(1) {
+  ["a"]=>
+  array(1) {
+    ["b"]=>
+    array(1) {
+      ["c"]=>
+      int(1)
+    }
+  }
+}
+
+Warning: yaml_parse(): Limit max_depth of 3 exceeded at line 1, column 12 in %s on line %d
+bool(false)
+bool(true)
+bool(true)
+
+Warning: yaml_parse(): Limit max_nodes of 9 exceeded at line 3, column 4 in %s on line %d
+bool(false)
+
+Warning: yaml_parse(): Limit max_aliases of 1 exceeded at line 3, column 4 in %s on line %d
+bool(false)
+
+Warning: yaml_parse(): Limit max_scalar_bytes of 8 exceeded at line 2, column 4 in %s on line %d
+bool(false)
+
+Warning: yaml_parse(): Limit max_documents of 2 exceeded at line 3, column 1 in %s on line %d
+bool(false)
+
+Warning: yaml_parse_lazy(): Limit max_depth of 2 exceeded at line 1, column 8 in %s on line %d
+bool(false)
+
+Warning: yaml_parse(): Unknown option, expected max_depth, max_nodes, max_scalar_bytes, max_aliases or max_documents in %s on line %d
+bool(false)
+
+Warning: yaml_parse(): Option 'max_nodes' must not be negative in %s on line %d
+bool(false)
+
+Warning: yaml_parse(): Limit max_nodes of 3 exceeded at line 3, column 3 in %s on line %d
+bool(false)
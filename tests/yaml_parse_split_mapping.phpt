@@ -0,0 +1,44 @@
+--TEST--
+yaml.parse_split_mapping parses a large top-level mapping in slices
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--INI--
+yaml.parse_threads=4
+yaml.parse_split_mapping=1
+--FILE--
+<?php
+$yaml = "---\nfirst: &anchor {a: 1}\n";
+for ($i = 0; $i < 40000; $i++) {
+	$yaml .= "key$i:\n  value: \"$i\"\n  list:\n  - $i\n  - text $i\n";
+	if ($i % 1000 == 0) {
+		$yaml .= "alias$i: *anchor\n";
+	}
+}
+$flow = $yaml . "flow: [\n" . str_repeat("x,\n", 300000) . "]\nlast: 1\n";
+
+foreach (array($yaml, $flow) as $input) {
+	$split = yaml_parse($input);
+	$all = yaml_parse($input, -1);
+	ini_set('yaml.parse_split_mapping', 0);
+	$serial = yaml_parse($input);
+	ini_set('yaml.parse_split_mapping', 1);
+
+	var_dump(count($split), $split === $serial, $all === array($serial));
+}
+var_dump($split['alias39000']);
+?>
+--EXPECT--
+40041
+bool(true)
+bool(true)
+40043
+bool(true)
+bool(true)
+array(1) {
+  ["a"]=>
+  int(1)
+}
@@ -1,14 +1,64 @@
 --TEST--
 yaml_parse_url() function
 --SKIPIF--
-<?php 
+<?php
 
 if(!extension_loaded('yaml')) die('skip');
 
  ?>
 --FILE--
 <?php
-echo 'OK'; // no test case for this function yet
+/* stands in for a remote server: makes up the body as it is read */
+class YamlStandIn
+{
+	public $context;
+	private $docs;
+	private $sent = 0;
+
+	function stream_open($path, $mode, $options, &$opened_path)
+	{
+		$this->docs = (int)substr($path, strlen('standin://'));
+		return true;
+	}
+
+	function stream_read($count)
+	{
+		$out = '';
+		while (strlen($out) < $count && $this->sent < $this->docs) {
+			$out .= "--- {id: {$this->sent}, text: " . str_repeat('x', 200) . "}\n";
+			$this->sent++;
+		}
+		return $out;
+	}
+
+	function stream_eof()
+	{
+		return $this->sent >= $this->docs;
+	}
+
+	function stream_stat()
+	{
+		return array();
+	}
+}
+stream_wrapper_register('standin', 'YamlStandIn');
+
+$doc = yaml_parse_url('standin://3', 2);
+var_dump($doc['id']);
+
+// memory does not grow with the size of the body
+foreach (array(2000, 40000) as $docs) {
+	$before = memory_get_usage();
+	$peak = memory_get_peak_usage();
+	$doc = yaml_parse_url("standin://$docs", 1, $ndocs);
+	var_dump($doc['id'], $ndocs, memory_get_peak_usage() - max($peak, $before) < 1024 * 1024);
+}
 ?>
 --EXPECT--
-OK
\ No newline at end of file
+int(2)
+int(1)
+int(2000)
+bool(true)
+int(1)
+int(40000)
+bool(true)
@@ -0,0 +1,41 @@
+--TEST--
+YamlPushParser class
+--SKIPIF--
+<?php
+
+if(!extension_loaded('yaml')) die('skip');
+
+ ?>
+--FILE--
+<?php
+$yaml = "%YAML 1.1\n--- 1\n---\na: [x,\n  y]\n...\n# comment\n--- [1\n--- !x last\n";
+
+$parser = new YamlPushParser(array('!x' => function ($v) { return strtoupper($v); }));
+foreach (str_split($yaml, 5) as $chunk) {
+	foreach (@$parser->feed($chunk) as $doc) {
+		echo json_encode($doc), "\n";
+	}
+}
+echo "finish\n";
+foreach ($parser->finish() as $doc) {
+	echo json_encode($doc), "\n";
+}
+
+// reusable after finish()
+var_dump($parser->feed("a: 1\n"), $parser->finish());
+?>
+--EXPECT--
+1
+{"a":["x","y"]}
+false
+finish
+"LAST"
+array(0) {
+}
+array(1) {
+  [0]=>
+  array(1) {
+    ["a"]=>
+    int(1)
+  }
+}
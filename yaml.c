@@ -35,6 +35,12 @@
 #include <php.h>
 #include <php_ini.h>
 #include <yaml.h>
+#ifdef PHP_WIN32
+#include "win32/time.h"
+#elif defined(HAVE_SYS_TIME_H)
+#include <sys/time.h>
+#endif
+#include <time.h>
 #include <ext/standard/php_smart_str.h>
 #include <ext/standard/php_var.h>
 #include <ext/standard/info.h>
@@ -42,11 +48,32 @@
 #include "zval_refcount.h" /* for PHP < 5.3 */
 #include "parser.h"
 #include "emitter.h"
+#include "parallel.h"
+#include "push_parser.h"
+#include "fast_scanner.h"
+#include "lazy.h"
+#include "probes.h"
+
+#ifdef HAVE_YAML_USDT
+/* {{{ probe semaphores
+ * Raised by the tracers attached to each probe; see probes.h. */
+#define YAML_PROBE_SEMAPHORE_DEFINE(name) \
+  YAML_PROBE_SEMAPHORE (name) __attribute__ ((unused)) __attribute__ ((section (".probes")))
+YAML_PROBE_SEMAPHORE_DEFINE (parse__start);
+YAML_PROBE_SEMAPHORE_DEFINE (parse__end);
+YAML_PROBE_SEMAPHORE_DEFINE (emit__start);
+YAML_PROBE_SEMAPHORE_DEFINE (emit__end);
+YAML_PROBE_SEMAPHORE_DEFINE (document__start);
+YAML_PROBE_SEMAPHORE_DEFINE (callback);
+YAML_PROBE_SEMAPHORE_DEFINE (emitter__error);
+/* }}} */
+#endif
 
 /* {{{ cross-extension dependencies */
 #if ZEND_EXTENSION_API_NO >= 220050617
 static zend_module_dep yaml_deps[] = {
   ZEND_MOD_OPTIONAL ("date")
+  ZEND_MOD_REQUIRED ("spl")
   {NULL, NULL, NULL, 0}
 };
 #endif
@@ -61,6 +88,7 @@ ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE,
   ZEND_ARG_INFO (0, pos)
   ZEND_ARG_INFO (1, ndocs)
   ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
   ZEND_END_ARG_INFO ()
 
 ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_file, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
@@ -68,6 +96,7 @@ ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_file, ZEND_SEND_BY_VAL, ZEND_RETURN_V
   ZEND_ARG_INFO (0, pos)
   ZEND_ARG_INFO (1, ndocs)
   ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
   ZEND_END_ARG_INFO ()
 
 ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_url, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
@@ -75,6 +104,37 @@ ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_url, ZEND_SEND_BY_VAL, ZEND_RETURN_VA
   ZEND_ARG_INFO (0, pos)
   ZEND_ARG_INFO (1, ndocs)
   ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_files, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
+  ZEND_ARG_ARRAY_INFO (0, filenames, 0)
+  ZEND_ARG_INFO (0, pos)
+  ZEND_ARG_INFO (1, ndocs)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_file_from, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 2)
+  ZEND_ARG_INFO (0, filename)
+  ZEND_ARG_INFO (0, offset)
+  ZEND_ARG_INFO (1, next_offset)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_lazy, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
+  ZEND_ARG_INFO (0, input)
+  ZEND_ARG_INFO (0, pos)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_document, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
+  ZEND_ARG_INFO (0, input)
+  ZEND_ARG_INFO (0, pos)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
   ZEND_END_ARG_INFO ()
 #else
 static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
@@ -82,6 +142,7 @@ static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse, ZEND_SEND_BY_VAL, ZEND_RETURN
   ZEND_ARG_INFO (0, pos)
   ZEND_ARG_INFO (1, ndocs)
   ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
   ZEND_END_ARG_INFO ()
 
 static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_file, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
@@ -89,6 +150,7 @@ static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_file, ZEND_SEND_BY_VAL, ZEND_R
   ZEND_ARG_INFO (0, pos)
   ZEND_ARG_INFO (1, ndocs)
   ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
   ZEND_END_ARG_INFO ()
 
 static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_url, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
@@ -96,12 +158,47 @@ static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_url, ZEND_SEND_BY_VAL, ZEND_RE
   ZEND_ARG_INFO (0, pos)
   ZEND_ARG_INFO (1, ndocs)
   ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_files, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
+  ZEND_ARG_ARRAY_INFO (0, filenames, 0)
+  ZEND_ARG_INFO (0, pos)
+  ZEND_ARG_INFO (1, ndocs)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_file_from, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 2)
+  ZEND_ARG_INFO (0, filename)
+  ZEND_ARG_INFO (0, offset)
+  ZEND_ARG_INFO (1, next_offset)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_lazy, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
+  ZEND_ARG_INFO (0, input)
+  ZEND_ARG_INFO (0, pos)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
+  ZEND_END_ARG_INFO ()
+
+static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_document, ZEND_SEND_BY_VAL, ZEND_RETURN_VALUE, 1)
+  ZEND_ARG_INFO (0, input)
+  ZEND_ARG_INFO (0, pos)
+  ZEND_ARG_ARRAY_INFO (0, callbacks, 0)
+  ZEND_ARG_ARRAY_INFO (0, options, 0)
   ZEND_END_ARG_INFO ()
 #endif
 #else
 #define arginfo_yaml_parse third_arg_force_ref
 #define arginfo_yaml_parse_file third_arg_force_ref
 #define arginfo_yaml_parse_url third_arg_force_ref
+#define arginfo_yaml_parse_files third_arg_force_ref
+#define arginfo_yaml_parse_file_from third_arg_force_ref
+#define arginfo_yaml_parse_lazy NULL
+#define arginfo_yaml_parse_document NULL
 #endif
 /* }}} */
 
@@ -110,8 +207,13 @@ static ZEND_BEGIN_ARG_INFO_EX (arginfo_yaml_parse_url, ZEND_SEND_BY_VAL, ZEND_RE
   PHP_FE (yaml_parse,      arginfo_yaml_parse)
   PHP_FE (yaml_parse_file, arginfo_yaml_parse_file)
   PHP_FE (yaml_parse_url,  arginfo_yaml_parse_url)
+  PHP_FE (yaml_parse_files, arginfo_yaml_parse_files)
+  PHP_FE (yaml_parse_file_from, arginfo_yaml_parse_file_from)
+  PHP_FE (yaml_parse_lazy, arginfo_yaml_parse_lazy)
+  PHP_FE (yaml_parse_document, arginfo_yaml_parse_document)
   PHP_FE (yaml_emit,       NULL)
   PHP_FE (yaml_emit_file,  NULL)
+  PHP_FE (yaml_last_stats, NULL)
   { NULL, NULL, NULL }
 };
 /* }}} */
@@ -129,7 +231,7 @@ zend_module_entry yaml_module_entry = {
   yaml_functions,
   PHP_MINIT (yaml),
   PHP_MSHUTDOWN (yaml),
-  NULL,
+  PHP_RINIT (yaml),
   NULL,
   PHP_MINFO (yaml),
   PHP_YAML_VERSION,
@@ -165,6 +267,30 @@ STD_PHP_INI_ENTRY ("yaml.fill_column", "80", PHP_INI_ALL, OnUpdateLong,
                    fill_column, zend_yaml_globals, yaml_globals)
 STD_PHP_INI_BOOLEAN ("yaml.nomnom", "0", PHP_INI_ALL, OnUpdateBool,
                      nomnom, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_BOOLEAN ("yaml.collect_timings", "0", PHP_INI_ALL, OnUpdateBool,
+                     collect_timings, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_ENTRY ("yaml.parse_threads", "0", PHP_INI_ALL, OnUpdateLong,
+                   parse_threads, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_BOOLEAN ("yaml.parse_split_mapping", "0", PHP_INI_ALL, OnUpdateBool,
+                     parse_split_mapping, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_ENTRY ("yaml.emit_threads", "0", PHP_INI_ALL, OnUpdateLong,
+                   emit_threads, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_ENTRY ("yaml.stream_chunk_size", "8192", PHP_INI_ALL, OnUpdateLong,
+                   stream_chunk_size, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_BOOLEAN ("yaml.fast_scanner", "0", PHP_INI_ALL, OnUpdateBool,
+                     fast_scanner, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_BOOLEAN ("yaml.alias_references", "1", PHP_INI_ALL, OnUpdateBool,
+                     alias_references, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_ENTRY ("yaml.max_depth", "1024", PHP_INI_ALL, OnUpdateLong,
+                   max_depth, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_ENTRY ("yaml.max_nodes", "0", PHP_INI_ALL, OnUpdateLong,
+                   max_nodes, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_ENTRY ("yaml.max_scalar_bytes", "0", PHP_INI_ALL, OnUpdateLong,
+                   max_scalar_bytes, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_ENTRY ("yaml.max_aliases", "0", PHP_INI_ALL, OnUpdateLong,
+                   max_aliases, zend_yaml_globals, yaml_globals)
+STD_PHP_INI_ENTRY ("yaml.max_documents", "0", PHP_INI_ALL, OnUpdateLong,
+                   max_documents, zend_yaml_globals, yaml_globals)
 PHP_INI_END ()
 
 /* }}} */
@@ -185,6 +311,9 @@ PHP_MINIT_FUNCTION (yaml)
   REGISTER_LONG_CONSTANT ("YAML_LN_BREAK", YAML_LN_BREAK, CONST_CS | CONST_PERSISTENT);
   REGISTER_LONG_CONSTANT ("YAML_CRLN_BREAK", YAML_CRLN_BREAK, CONST_CS | CONST_PERSISTENT);
 
+  php_yaml_push_parser_register (TSRMLS_C);
+  php_yaml_lazy_register (TSRMLS_C);
+
   REGISTER_INI_ENTRIES ();
   return SUCCESS;
 }
@@ -198,6 +327,17 @@ PHP_MSHUTDOWN_FUNCTION (yaml)
 }
 /* }}} */
 
+/* {{{ PHP_RINIT_FUNCTION */
+PHP_RINIT_FUNCTION (yaml)
+{
+  memset (&YAML_G (stats), 0, sizeof (php_yaml_stats));
+  /* left over if the last request bailed out of a parse */
+  YAML_G (stats_depth) = 0;
+  YAML_G (resolved_callbacks) = NULL;
+  return SUCCESS;
+}
+/* }}} */
+
 /* {{{ PHP_MINFO_FUNCTION */
 PHP_MINFO_FUNCTION (yaml)
 {
@@ -219,12 +359,122 @@ PHP_GINIT_FUNCTION (yaml)
   yaml_globals->throw_exceptions = 1;
   yaml_globals->fill_column = 80;
   yaml_globals->nomnom = 0;
+  yaml_globals->collect_timings = 0;
+  yaml_globals->parse_threads = 0;
+  yaml_globals->parse_split_mapping = 0;
+  yaml_globals->emit_threads = 0;
+  yaml_globals->stream_chunk_size = 8192;
+  yaml_globals->fast_scanner = 0;
+  yaml_globals->alias_references = 1;
+  yaml_globals->max_depth = 1024;
+  yaml_globals->max_nodes = 0;
+  yaml_globals->max_scalar_bytes = 0;
+  yaml_globals->max_aliases = 0;
+  yaml_globals->max_documents = 0;
+  yaml_globals->resolved_callbacks = NULL;
+  memset (&yaml_globals->limits, 0, sizeof (php_yaml_limits));
+  memset (&yaml_globals->used, 0, sizeof (php_yaml_limits));
+  yaml_globals->stats_depth = 0;
+  memset (&yaml_globals->stats, 0, sizeof (php_yaml_stats));
 #ifdef IS_UNICODE
   yaml_globals->orig_runtime_encoding_conv = NULL;
 #endif
 }
 /* }}} */
 
+/* {{{ php_yaml_clock ()
+ * Monotonic wall clock in seconds, for the timings of yaml_last_stats (). */
+double
+php_yaml_clock (void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#else
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+#endif
+}
+/* }}} */
+
+/* {{{ php_yaml_stats_begin ()
+ * Resets the statistics at the start of a parse or emit call and fires
+ * the matching start probe. source is the file name or URL, if any;
+ * size is the input length or -1 if not known yet. The statistics of
+ * a call still going on, one a callback is called from, go to saved. */
+static void
+php_yaml_stats_begin (int operation, const char *function,
+                      const char *source, long size, php_yaml_stats *saved TSRMLS_DC)
+{
+  if (YAML_G (stats_depth)++ > 0)
+    *saved = YAML_G (stats);
+
+  memset (&YAML_G (stats), 0, sizeof (php_yaml_stats));
+  YAML_G (stats).operation = operation;
+  YAML_G (stats).function = function;
+  YAML_G (stats).memory = (long)zend_memory_usage (0 TSRMLS_CC);
+  YAML_G (stats).time_total = php_yaml_clock ();
+
+  if (operation == Y_STATS_PARSE)
+    YAML_PROBE3 (parse__start, function, source, size);
+  else
+    YAML_PROBE2 (emit__start, function, source);
+}
+/* }}} */
+
+/* {{{ php_yaml_stats_end ()
+ * Fires the end probe; a call made from a callback then gives the
+ * statistics back to the call it was made from. */
+static void
+php_yaml_stats_end (int ok, long ndocs, const php_yaml_stats *saved TSRMLS_DC)
+{
+  YAML_G (stats).memory = (long)zend_memory_usage (0 TSRMLS_CC) - YAML_G (stats).memory;
+  YAML_G (stats).time_total = php_yaml_clock () - YAML_G (stats).time_total;
+
+  if (YAML_G (stats).operation == Y_STATS_PARSE)
+    YAML_PROBE5 (parse__end, YAML_G (stats).function, ok, ndocs,
+                 YAML_G (stats).bytes, YAML_PROBE_NS (YAML_G (stats).time_total));
+  else
+    YAML_PROBE4 (emit__end, YAML_G (stats).function, ok,
+                 YAML_G (stats).bytes, YAML_PROBE_NS (YAML_G (stats).time_total));
+
+  if (--YAML_G (stats_depth) > 0)
+    YAML_G (stats) = *saved;
+}
+/* }}} */
+
+/* {{{ php_yaml_read_from_stream ()
+ * LibYAML read handler pulling from a php_stream as the parser needs
+ * input, so only LibYAML's own buffer of the input is in memory. */
+static int
+php_yaml_read_from_stream (void *data, unsigned char *buffer, size_t size,
+                           size_t *size_read)
+{
+  TSRMLS_FETCH ();
+
+  *size_read = php_stream_read ((php_stream *)data, (char *)buffer, size);
+  return 1;
+}
+/* }}} */
+
+/* {{{ php_yaml_set_input_stream ()
+ * Makes parser read from stream, which the stream layer fills in
+ * chunks of yaml.stream_chunk_size bytes. Works with any wrapper, no
+ * cast to a FILE * needed. */
+static void
+php_yaml_set_input_stream (yaml_parser_t *parser, php_stream *stream TSRMLS_DC)
+{
+  if (YAML_G (stream_chunk_size) > 0)
+    php_stream_set_chunk_size (stream, (size_t)YAML_G (stream_chunk_size));
+
+  yaml_parser_set_input (parser, &php_yaml_read_from_stream, (void *)stream);
+}
+/* }}} */
+
 /* {{{ php_yaml_write_to_buffer () */
 static int
 php_yaml_write_to_buffer (void *data, unsigned char *buffer, size_t size)
@@ -234,7 +484,7 @@ php_yaml_write_to_buffer (void *data, unsigned char *buffer, size_t size)
 }
 /* }}} */
 
-/* {{{ proto mixed yaml_parse (string input[, int pos[, int &ndocs[, array callbacks]]]) */
+/* {{{ proto mixed yaml_parse (string input[, int pos[, int &ndocs[, array callbacks[, array options]]]]) */
 PHP_FUNCTION (yaml_parse)
 {
   char *input = NULL;
@@ -242,10 +492,16 @@ PHP_FUNCTION (yaml_parse)
   long pos = 0;
   zval *zndocs = NULL;
   zval *zcallbacks = NULL;
+  zval *zoptions = NULL;
+  php_yaml_limits limits;
+  php_yaml_limits_saved saved_limits;
+  php_yaml_stats saved_stats;
   HashTable *callbacks = NULL;
   eval_scalar_func_t eval_func;
 
   yaml_parser_t parser = {0};
+  php_yaml_event_list events;
+  php_yaml_source source = {NULL, NULL, 0};
   zval *yaml = NULL;
   long ndocs = 0;
 
@@ -255,16 +511,16 @@ PHP_FUNCTION (yaml_parse)
   YAML_G (timestamp_decoder) = NULL;
 
 #ifdef IS_UNICODE
-  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s&|lza/",
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s&|lza/a",
                              &input, &input_len, UG (utf8_conv),
-                             &pos, &zndocs, &zcallbacks) == FAILURE)
+                             &pos, &zndocs, &zcallbacks, &zoptions) == FAILURE)
     {
       return;
     }
 #else
-  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s|lza/",
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s|lza/a",
                              &input, &input_len,
-                             &pos, &zndocs, &zcallbacks) == FAILURE)
+                             &pos, &zndocs, &zcallbacks, &zoptions) == FAILURE)
     {
       return;
     }
@@ -282,21 +538,51 @@ PHP_FUNCTION (yaml_parse)
     }
   else 
     eval_func = php_yaml_eval_scalar;
+
+  if (php_yaml_limits_read (zoptions != NULL ? Z_ARRVAL_P (zoptions) : NULL, &limits TSRMLS_CC) == FAILURE)
+    RETURN_FALSE;
   
 
 #ifdef IS_UNICODE
   UG (runtime_encoding_conv) = UG (utf8_conv);
 #endif
 
-  yaml_parser_initialize (&parser);
-  yaml_parser_set_input_string (&parser, (unsigned char *)input, (size_t)input_len);
+  php_yaml_callbacks_begin (callbacks TSRMLS_CC);
+  php_yaml_limits_begin (&limits, &saved_limits TSRMLS_CC);
+  php_yaml_stats_begin (Y_STATS_PARSE, "yaml_parse", NULL, input_len, &saved_stats TSRMLS_CC);
 
-  if (pos < 0)
-    yaml = php_yaml_read_all (&parser, &ndocs, eval_func, callbacks);
+  if (php_yaml_parallel_wanted (pos))
+    yaml = php_yaml_read_parallel ((unsigned char *)input, (size_t)input_len, pos, &ndocs,
+                                   (int)YAML_G (parse_threads), eval_func, callbacks TSRMLS_CC);
   else
-    yaml = php_yaml_read_partial (&parser, pos, &ndocs, eval_func, callbacks TSRMLS_CC);
-  
-  yaml_parser_delete (&parser);
+    {
+      /* the fast scanner goes over the whole input, so it is only
+         worth it if all of it is going to be parsed anyway */
+      memset (&events, 0, sizeof (php_yaml_event_list));
+      if (YAML_G (fast_scanner) && (pos < 0 || zndocs != NULL)
+          && php_yaml_fast_scan ((unsigned char *)input, (size_t)input_len, &events) == SUCCESS)
+        source.list = &events;
+      else
+        {
+          yaml_parser_initialize (&parser);
+          yaml_parser_set_input_string (&parser, (unsigned char *)input, (size_t)input_len);
+          source.parser = &parser;
+        }
+
+      if (pos < 0)
+        yaml = php_yaml_read_all (&source, &ndocs, eval_func, callbacks);
+      else
+        yaml = php_yaml_read_partial (&source, pos, zndocs != NULL ? &ndocs : NULL,
+                                      eval_func, callbacks TSRMLS_CC);
+
+      if (source.list != NULL)
+        php_yaml_event_list_free (&events);
+      else
+        yaml_parser_delete (&parser);
+    }
+  php_yaml_stats_end (yaml != NULL, ndocs, &saved_stats TSRMLS_CC);
+  php_yaml_limits_end (&saved_limits TSRMLS_CC);
+  php_yaml_callbacks_end (callbacks TSRMLS_CC);
 
 #ifdef IS_UNICODE
   UG (runtime_encoding_conv) = YAML_G (orig_runtime_encoding_conv);
@@ -317,7 +603,7 @@ PHP_FUNCTION (yaml_parse)
 }
 /* }}} yaml_parse */
 
-/* {{{ proto mixed yaml_parse_file (string filename[, int pos[, int &ndocs[, array callbacks]]]) */
+/* {{{ proto mixed yaml_parse_file (string filename[, int pos[, int &ndocs[, array callbacks[, array options]]]]) */
 PHP_FUNCTION (yaml_parse_file)
 {
   char *filename = NULL;
@@ -325,13 +611,20 @@ PHP_FUNCTION (yaml_parse_file)
   long pos = 0;
   zval *zndocs = NULL;
   zval *zcallbacks = NULL;
+  zval *zoptions = NULL;
+  php_yaml_limits limits;
+  php_yaml_limits_saved saved_limits;
+  php_yaml_stats saved_stats;
   HashTable *callbacks = NULL;
   eval_scalar_func_t eval_func;
 
   php_stream *stream = NULL;
-  FILE *fp = NULL;
+  int parallel = 0;
+  char *input = NULL;
+  size_t size = 0;
 
   yaml_parser_t parser = {0};
+  php_yaml_source source = {NULL, NULL, 0};
   zval *yaml = NULL;
   long ndocs = 0;
 
@@ -341,13 +634,13 @@ PHP_FUNCTION (yaml_parse_file)
   YAML_G (timestamp_decoder) = NULL;
 
 #ifdef IS_UNICODE
-  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s&|lza/",
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s&|lza/a",
                             &filename, &filename_len, ZEND_U_CONVERTER (UG (filesystem_encoding_conv)),
-                            &pos, &zndocs, &zcallbacks) == FAILURE)
+                            &pos, &zndocs, &zcallbacks, &zoptions) == FAILURE)
     return;
 #else
-  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s|lza/",
-                            &filename, &filename_len, &pos, &zndocs, &zcallbacks) == FAILURE)
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s|lza/a",
+                            &filename, &filename_len, &pos, &zndocs, &zcallbacks, &zoptions) == FAILURE)
     return;
 #endif
 
@@ -362,32 +655,62 @@ PHP_FUNCTION (yaml_parse_file)
   else 
     eval_func = php_yaml_eval_scalar;
 
+  if (php_yaml_limits_read (zoptions != NULL ? Z_ARRVAL_P (zoptions) : NULL, &limits TSRMLS_CC) == FAILURE)
+    RETURN_FALSE;
+
   if ((stream = php_stream_open_wrapper (filename, "rb",
-                                        IGNORE_URL | ENFORCE_SAFE_MODE | REPORT_ERRORS | STREAM_WILL_CAST, NULL)) == NULL)
+                                        IGNORE_URL | ENFORCE_SAFE_MODE | REPORT_ERRORS, NULL)) == NULL)
     {
       RETURN_FALSE;
     }
 
-  if (php_stream_cast (stream, PHP_STREAM_AS_STDIO, (void **)&fp, 1) == FAILURE)
+  /* the parallel parser splits the input, so it needs all of it; the
+     serial one reads the stream as it goes */
+  if ((parallel = php_yaml_parallel_wanted (pos)))
     {
-      php_stream_close (stream);
-      RETURN_FALSE;
+#ifdef IS_UNICODE
+      size = php_stream_copy_to_mem (stream, (void **)&input, PHP_STREAM_COPY_ALL, 0);
+#else
+      size = php_stream_copy_to_mem (stream, &input, PHP_STREAM_COPY_ALL, 0);
+#endif
     }
 
 #ifdef IS_UNICODE
   UG (runtime_encoding_conv) = UG (utf8_conv);
 #endif
 
-  yaml_parser_initialize (&parser);
-  yaml_parser_set_input_file (&parser, fp);
+  php_yaml_callbacks_begin (callbacks TSRMLS_CC);
+  php_yaml_limits_begin (&limits, &saved_limits TSRMLS_CC);
+  php_yaml_stats_begin (Y_STATS_PARSE, "yaml_parse_file", filename,
+                        parallel ? (long)size : -1, &saved_stats TSRMLS_CC);
 
-  if (pos < 0)
-    yaml = php_yaml_read_all (&parser, &ndocs, eval_func, callbacks);
+  if (parallel)
+    {
+      yaml = php_yaml_read_parallel (input != NULL ? (unsigned char *)input : (unsigned char *)"",
+                                     size, pos, &ndocs, (int)YAML_G (parse_threads),
+                                     eval_func, callbacks TSRMLS_CC);
+      if (input != NULL)
+        efree (input);
+    }
   else
-    yaml = php_yaml_read_partial (&parser, pos, &ndocs, eval_func, callbacks TSRMLS_CC);
+    {
+      yaml_parser_initialize (&parser);
+      php_yaml_set_input_stream (&parser, stream TSRMLS_CC);
+      source.parser = &parser;
+
+      if (pos < 0)
+        yaml = php_yaml_read_all (&source, &ndocs, eval_func, callbacks);
+      else
+        yaml = php_yaml_read_partial (&source, pos, zndocs != NULL ? &ndocs : NULL,
+                                      eval_func, callbacks TSRMLS_CC);
+
+      yaml_parser_delete (&parser);
+    }
 
-  yaml_parser_delete (&parser);
   php_stream_close (stream);
+  php_yaml_stats_end (yaml != NULL, ndocs, &saved_stats TSRMLS_CC);
+  php_yaml_limits_end (&saved_limits TSRMLS_CC);
+  php_yaml_callbacks_end (callbacks TSRMLS_CC);
 
 #ifdef IS_UNICODE
   UG (runtime_encoding_conv) = YAML_G (orig_runtime_encoding_conv);
@@ -408,7 +731,199 @@ PHP_FUNCTION (yaml_parse_file)
 }
 /* }}} yaml_parse_file */
 
-/* {{{ proto mixed yaml_parse_url (string url[, int pos[, int &ndocs[, array callbacks]]]) */
+/* {{{ proto array yaml_parse_file_from (string filename, int offset[, int &next_offset[, array callbacks[, array options]]])
+   Parses the complete documents of a file from byte offset on, for files
+   that are appended to; next_offset is where to go on next time */
+PHP_FUNCTION (yaml_parse_file_from)
+{
+  char *filename = NULL;
+  int filename_len = 0;
+  long offset = 0;
+  zval *znext = NULL;
+  zval *zcallbacks = NULL;
+  zval *zoptions = NULL;
+  php_yaml_limits limits;
+  php_yaml_limits_saved saved_limits;
+  php_yaml_stats saved_stats;
+
+  php_stream *stream = NULL;
+  php_yaml_push_state state;
+  char *buffer = NULL;
+  size_t chunk_size, length;
+
+#ifdef IS_UNICODE
+  YAML_G (orig_runtime_encoding_conv) = UG (runtime_encoding_conv);
+#endif
+  YAML_G (timestamp_decoder) = NULL;
+
+#ifdef IS_UNICODE
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s&l|za/a",
+                            &filename, &filename_len, ZEND_U_CONVERTER (UG (filesystem_encoding_conv)),
+                            &offset, &znext, &zcallbacks, &zoptions) == FAILURE)
+    return;
+#else
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "sl|za/a",
+                            &filename, &filename_len, &offset, &znext, &zcallbacks, &zoptions) == FAILURE)
+    return;
+#endif
+
+  if (offset < 0)
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "Offset must not be negative");
+      RETURN_FALSE;
+    }
+
+  if (zcallbacks != NULL
+      && php_yaml_check_callbacks (Z_ARRVAL_P (zcallbacks) TSRMLS_CC) == FAILURE)
+    RETURN_FALSE;
+  if (php_yaml_limits_read (zoptions != NULL ? Z_ARRVAL_P (zoptions) : NULL, &limits TSRMLS_CC) == FAILURE)
+    RETURN_FALSE;
+
+  if ((stream = php_stream_open_wrapper (filename, "rb",
+                                        IGNORE_URL | ENFORCE_SAFE_MODE | REPORT_ERRORS, NULL)) == NULL)
+    {
+      RETURN_FALSE;
+    }
+  if (offset > 0 && php_stream_seek (stream, offset, SEEK_SET) != 0)
+    {
+      php_error_docref (NULL TSRMLS_CC, E_WARNING, "Failed to seek to offset %ld", offset);
+      php_stream_close (stream);
+      RETURN_FALSE;
+    }
+
+#ifdef IS_UNICODE
+  UG (runtime_encoding_conv) = UG (utf8_conv);
+#endif
+
+  php_yaml_callbacks_begin (zcallbacks != NULL ? Z_ARRVAL_P (zcallbacks) : NULL TSRMLS_CC);
+  php_yaml_limits_begin (&limits, &saved_limits TSRMLS_CC);
+  php_yaml_stats_begin (Y_STATS_PARSE, "yaml_parse_file_from", filename, -1, &saved_stats TSRMLS_CC);
+
+  /* the documents are cut out of the input as in YamlPushParser::feed (),
+     a trailing document is only complete once the next one starts */
+  memset (&state, 0, sizeof (php_yaml_push_state));
+  state.offset = (size_t)offset;
+  if (zcallbacks != NULL)
+    {
+      Z_ADDREF_P (zcallbacks);
+      state.callbacks = zcallbacks;
+    }
+
+  chunk_size = YAML_G (stream_chunk_size) > 0 ? (size_t)YAML_G (stream_chunk_size) : 8192;
+  buffer = emalloc (chunk_size);
+  array_init (return_value);
+
+  while ((length = php_stream_read (stream, buffer, chunk_size)) > 0)
+    php_yaml_push_feed (&state, buffer, length, return_value TSRMLS_CC);
+
+  efree (buffer);
+  php_stream_close (stream);
+
+  YAML_G (stats).bytes = (long)(state.offset - (size_t)offset);
+  php_yaml_stats_end (1, zend_hash_num_elements (Z_ARRVAL_P (return_value)), &saved_stats TSRMLS_CC);
+  php_yaml_limits_end (&saved_limits TSRMLS_CC);
+  php_yaml_callbacks_end (zcallbacks != NULL ? Z_ARRVAL_P (zcallbacks) : NULL TSRMLS_CC);
+
+#ifdef IS_UNICODE
+  UG (runtime_encoding_conv) = YAML_G (orig_runtime_encoding_conv);
+#endif
+
+  if (znext != NULL)
+    {
+      zval_dtor (znext);
+      ZVAL_LONG (znext, (long)state.offset);
+    }
+
+  php_yaml_push_free (&state);
+}
+/* }}} yaml_parse_file_from */
+
+/* {{{ php_yaml_parse_lazy ()
+ * yaml_parse_lazy() and yaml_parse_document(), which differ in what
+ * read makes of the tree of the document.
+ */
+static void
+php_yaml_parse_lazy (INTERNAL_FUNCTION_PARAMETERS, const char *name,
+                     int (*read) (php_yaml_source *, long, zval *, zval * TSRMLS_DC))
+{
+  char *input = NULL;
+  int input_len = 0;
+  long pos = 0;
+  zval *zcallbacks = NULL;
+  zval *zoptions = NULL;
+  php_yaml_limits limits;
+  php_yaml_limits_saved saved_limits;
+  php_yaml_stats saved_stats;
+
+  yaml_parser_t parser = {0};
+  php_yaml_source source = {NULL, NULL, 0};
+  int ok;
+
+#ifdef IS_UNICODE
+  YAML_G (orig_runtime_encoding_conv) = UG (runtime_encoding_conv);
+#endif
+  YAML_G (timestamp_decoder) = NULL;
+
+#ifdef IS_UNICODE
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s&|la/a",
+                             &input, &input_len, UG (utf8_conv),
+                             &pos, &zcallbacks, &zoptions) == FAILURE)
+    return;
+#else
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s|la/a",
+                             &input, &input_len, &pos, &zcallbacks, &zoptions) == FAILURE)
+    return;
+#endif
+
+  if (zcallbacks != NULL
+      && php_yaml_check_callbacks (Z_ARRVAL_P (zcallbacks) TSRMLS_CC) == FAILURE)
+    RETURN_FALSE;
+  if (php_yaml_limits_read (zoptions != NULL ? Z_ARRVAL_P (zoptions) : NULL, &limits TSRMLS_CC) == FAILURE)
+    RETURN_FALSE;
+
+#ifdef IS_UNICODE
+  UG (runtime_encoding_conv) = UG (utf8_conv);
+#endif
+
+  php_yaml_callbacks_begin (zcallbacks != NULL ? Z_ARRVAL_P (zcallbacks) : NULL TSRMLS_CC);
+  php_yaml_limits_begin (&limits, &saved_limits TSRMLS_CC);
+  php_yaml_stats_begin (Y_STATS_PARSE, name, NULL, input_len, &saved_stats TSRMLS_CC);
+
+  yaml_parser_initialize (&parser);
+  yaml_parser_set_input_string (&parser, (unsigned char *)input, (size_t)input_len);
+  source.parser = &parser;
+
+  ok = read (&source, pos, zcallbacks, return_value TSRMLS_CC) == SUCCESS;
+
+  yaml_parser_delete (&parser);
+  php_yaml_stats_end (ok, 0, &saved_stats TSRMLS_CC);
+  php_yaml_limits_end (&saved_limits TSRMLS_CC);
+  php_yaml_callbacks_end (zcallbacks != NULL ? Z_ARRVAL_P (zcallbacks) : NULL TSRMLS_CC);
+
+#ifdef IS_UNICODE
+  UG (runtime_encoding_conv) = YAML_G (orig_runtime_encoding_conv);
+#endif
+
+  if (!ok)
+    RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto mixed yaml_parse_lazy (string input[, int pos[, array callbacks[, array options]]]) */
+PHP_FUNCTION (yaml_parse_lazy)
+{
+  php_yaml_parse_lazy (INTERNAL_FUNCTION_PARAM_PASSTHRU, "yaml_parse_lazy", php_yaml_lazy_read);
+}
+/* }}} yaml_parse_lazy */
+
+/* {{{ proto YamlDocument yaml_parse_document (string input[, int pos[, array callbacks[, array options]]]) */
+PHP_FUNCTION (yaml_parse_document)
+{
+  php_yaml_parse_lazy (INTERNAL_FUNCTION_PARAM_PASSTHRU, "yaml_parse_document", php_yaml_lazy_document);
+}
+/* }}} yaml_parse_document */
+
+/* {{{ proto mixed yaml_parse_url (string url[, int pos[, int &ndocs[, array callbacks[, array options]]]]) */
 PHP_FUNCTION (yaml_parse_url)
 {
   char *url = NULL;
@@ -416,14 +931,20 @@ PHP_FUNCTION (yaml_parse_url)
   long pos = 0;
   zval *zndocs = NULL;
   zval *zcallbacks = NULL;
+  zval *zoptions = NULL;
+  php_yaml_limits limits;
+  php_yaml_limits_saved saved_limits;
+  php_yaml_stats saved_stats;
   HashTable *callbacks = NULL;
   eval_scalar_func_t eval_func;
 
   php_stream *stream = NULL;
+  int parallel = 0;
   char *input = NULL;
   size_t size = 0;
 
   yaml_parser_t parser = {0};
+  php_yaml_source source = {NULL, NULL, 0};
   zval *yaml = NULL;
   long ndocs = 0;
 
@@ -432,8 +953,8 @@ PHP_FUNCTION (yaml_parse_url)
 #endif
   YAML_G (timestamp_decoder) = NULL;
 
-  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s|lza/",
-                            &url, &url_len, &pos, &zndocs, &zcallbacks) == FAILURE)
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "s|lza/a",
+                            &url, &url_len, &pos, &zndocs, &zcallbacks, &zoptions) == FAILURE)
     return;
 
   if (zcallbacks != NULL)
@@ -448,6 +969,9 @@ PHP_FUNCTION (yaml_parse_url)
   }
   else
     eval_func = php_yaml_eval_scalar;
+
+  if (php_yaml_limits_read (zoptions != NULL ? Z_ARRVAL_P (zoptions) : NULL, &limits TSRMLS_CC) == FAILURE)
+    RETURN_FALSE;
   
 
   if ( (stream = php_stream_open_wrapper (url, "rb",
@@ -455,27 +979,53 @@ PHP_FUNCTION (yaml_parse_url)
     {
       RETURN_FALSE;
     }
+
+  /* the parallel parser splits the input, so it needs all of it; the
+     serial one reads the stream as it goes */
+  if ((parallel = php_yaml_parallel_wanted (pos)))
+    {
 #ifdef IS_UNICODE
-  size = php_stream_copy_to_mem (stream, (void **)&input, PHP_STREAM_COPY_ALL, 0);
+      size = php_stream_copy_to_mem (stream, (void **)&input, PHP_STREAM_COPY_ALL, 0);
 #else
-  size = php_stream_copy_to_mem (stream, &input, PHP_STREAM_COPY_ALL, 0);
+      size = php_stream_copy_to_mem (stream, &input, PHP_STREAM_COPY_ALL, 0);
 #endif
+    }
 
 #ifdef IS_UNICODE
   UG (runtime_encoding_conv) = UG (utf8_conv);
 #endif
 
-  yaml_parser_initialize (&parser);
-  yaml_parser_set_input_string (&parser, (unsigned char *)input, size);
+  php_yaml_callbacks_begin (callbacks TSRMLS_CC);
+  php_yaml_limits_begin (&limits, &saved_limits TSRMLS_CC);
+  php_yaml_stats_begin (Y_STATS_PARSE, "yaml_parse_url", url,
+                        parallel ? (long)size : -1, &saved_stats TSRMLS_CC);
 
-  if (pos < 0)
-    yaml = php_yaml_read_all (&parser, &ndocs, eval_func, callbacks);
+  if (parallel)
+    {
+      yaml = php_yaml_read_parallel (input != NULL ? (unsigned char *)input : (unsigned char *)"",
+                                     size, pos, &ndocs, (int)YAML_G (parse_threads),
+                                     eval_func, callbacks TSRMLS_CC);
+      if (input != NULL)
+        efree (input);
+    }
   else
-    yaml = php_yaml_read_partial (&parser, pos, &ndocs, eval_func, callbacks TSRMLS_CC);
+    {
+      yaml_parser_initialize (&parser);
+      php_yaml_set_input_stream (&parser, stream TSRMLS_CC);
+      source.parser = &parser;
 
-  yaml_parser_delete (&parser);
+      if (pos < 0)
+        yaml = php_yaml_read_all (&source, &ndocs, eval_func, callbacks);
+      else
+        yaml = php_yaml_read_partial (&source, pos, zndocs != NULL ? &ndocs : NULL,
+                                      eval_func, callbacks TSRMLS_CC);
+
+      yaml_parser_delete (&parser);
+    }
   php_stream_close (stream);
-  efree (input);
+  php_yaml_stats_end (yaml != NULL, ndocs, &saved_stats TSRMLS_CC);
+  php_yaml_limits_end (&saved_limits TSRMLS_CC);
+  php_yaml_callbacks_end (callbacks TSRMLS_CC);
 
 #ifdef IS_UNICODE
   UG (runtime_encoding_conv) = YAML_G (orig_runtime_encoding_conv);
@@ -496,12 +1046,196 @@ PHP_FUNCTION (yaml_parse_url)
 }
 /* }}} yaml_parse_url */
 
+/* {{{ proto array yaml_parse_files (array filenames[, int pos[, array &ndocs[, array callbacks[, array options]]]])
+   Parses several files at once on worker threads; returns the results
+   keyed by file name, FALSE for files that failed */
+PHP_FUNCTION (yaml_parse_files)
+{
+  zval *zfilenames = NULL;
+  long pos = 0;
+  zval *zndocs = NULL;
+  zval *zcallbacks = NULL;
+  zval *zoptions = NULL;
+  php_yaml_limits limits;
+  php_yaml_limits_saved saved_limits;
+  php_yaml_stats saved_stats;
+  HashTable *callbacks = NULL;
+  eval_scalar_func_t eval_func;
+
+  HashPosition hpos;
+  zval **entry = NULL;
+  zval **names = NULL;
+  php_stream **streams = NULL;
+  char **inputs = NULL;
+  php_yaml_slice *files = NULL;
+  php_yaml_pool *pool = NULL;
+  size_t nfiles, i;
+  long total_docs = 0, total_bytes = 0;
+  int nthreads;
+
+#ifdef IS_UNICODE
+  YAML_G (orig_runtime_encoding_conv) = UG (runtime_encoding_conv);
+#endif
+  YAML_G (timestamp_decoder) = NULL;
+
+  if (zend_parse_parameters (ZEND_NUM_ARGS () TSRMLS_CC, "a|lza/a",
+                             &zfilenames, &pos, &zndocs, &zcallbacks, &zoptions) == FAILURE)
+    return;
+
+  if (zcallbacks != NULL)
+    {
+      callbacks = Z_ARRVAL_P (zcallbacks);
+      if (php_yaml_check_callbacks (callbacks TSRMLS_CC) == FAILURE)
+        RETURN_FALSE;
+
+      eval_func = php_yaml_eval_scalar_with_callbacks;
+    }
+  else
+    eval_func = php_yaml_eval_scalar;
+
+  if (php_yaml_limits_read (zoptions != NULL ? Z_ARRVAL_P (zoptions) : NULL, &limits TSRMLS_CC) == FAILURE)
+    RETURN_FALSE;
+
+  array_init (return_value);
+  if (zndocs != NULL)
+    {
+      zval_dtor (zndocs);
+      array_init (zndocs);
+    }
+
+  nfiles = zend_hash_num_elements (Z_ARRVAL_P (zfilenames));
+  if (nfiles == 0)
+    return;
+
+  names = ecalloc (nfiles, sizeof (zval *));
+  streams = ecalloc (nfiles, sizeof (php_stream *));
+  inputs = ecalloc (nfiles, sizeof (char *));
+  files = ecalloc (nfiles, sizeof (php_yaml_slice));
+
+  /* open on this thread, so that open_basedir, safe mode and stream
+     wrappers apply as for yaml_parse_file (); plain files are handed to
+     the workers as FILE *, anything else is read into memory here */
+  i = 0;
+  zend_hash_internal_pointer_reset_ex (Z_ARRVAL_P (zfilenames), &hpos);
+  while (zend_hash_get_current_data_ex (Z_ARRVAL_P (zfilenames), (void **)&entry, &hpos) == SUCCESS)
+    {
+      FILE *fp = NULL;
+
+      MAKE_STD_ZVAL (names[i]);
+      *names[i] = **entry;
+      zval_copy_ctor (names[i]);
+      INIT_PZVAL (names[i]);
+      convert_to_string (names[i]);
+
+      streams[i] = php_stream_open_wrapper (Z_STRVAL_P (names[i]), "rb",
+                                            IGNORE_URL | ENFORCE_SAFE_MODE | REPORT_ERRORS | STREAM_WILL_CAST, NULL);
+      if (streams[i] != NULL)
+        {
+          if (php_stream_cast (streams[i], PHP_STREAM_AS_STDIO, (void **)&fp, 0) == SUCCESS)
+            files[i].fp = fp;
+          else
+            {
+#ifdef IS_UNICODE
+              files[i].length = php_stream_copy_to_mem (streams[i], (void **)&inputs[i], PHP_STREAM_COPY_ALL, 0);
+#else
+              files[i].length = php_stream_copy_to_mem (streams[i], &inputs[i], PHP_STREAM_COPY_ALL, 0);
+#endif
+              files[i].input = inputs[i] != NULL ? (unsigned char *)inputs[i] : (unsigned char *)"";
+            }
+        }
+
+      zend_hash_move_forward_ex (Z_ARRVAL_P (zfilenames), &hpos);
+      i++;
+    }
+
+#ifdef IS_UNICODE
+  UG (runtime_encoding_conv) = UG (utf8_conv);
+#endif
+
+  php_yaml_callbacks_begin (callbacks TSRMLS_CC);
+  php_yaml_limits_begin (&limits, &saved_limits TSRMLS_CC);
+  php_yaml_stats_begin (Y_STATS_PARSE, "yaml_parse_files", NULL, -1, &saved_stats TSRMLS_CC);
+
+  nthreads = YAML_G (parse_threads) > 0 ? (int)YAML_G (parse_threads) : php_yaml_cpu_count ();
+  pool = php_yaml_pool_start (php_yaml_parse_slice, files, sizeof (php_yaml_slice),
+                              nfiles, nthreads > 1 ? nthreads : 0, 0);
+
+  for (i = 0; i < nfiles; i++)
+    {
+      zval *yaml = NULL;
+      long ndocs = 0;
+
+      if (pool != NULL)
+        php_yaml_pool_wait (pool, i);
+      else
+        php_yaml_parse_slice (&files[i]);
+
+      if (streams[i] != NULL)
+        {
+          /* the limits apply to each file, whatever the last one left */
+          memset (&YAML_G (used), 0, sizeof (php_yaml_limits));
+          yaml = php_yaml_read_slice (&files[i], pos, &ndocs, eval_func, callbacks TSRMLS_CC);
+          total_bytes += YAML_G (stats).bytes;
+          if (ndocs == -1)
+            php_error_docref (NULL TSRMLS_CC, E_WARNING,
+                              "Failed to parse '%s'", Z_STRVAL_P (names[i]));
+
+          /* the worker is done with the file */
+          php_stream_close (streams[i]);
+          streams[i] = NULL;
+        }
+      else
+        ndocs = -1;
+
+      if (pool != NULL)
+        php_yaml_pool_release (pool, i);
+
+      if (yaml != NULL)
+        add_assoc_zval_ex (return_value, Z_STRVAL_P (names[i]), Z_STRLEN_P (names[i]) + 1, yaml);
+      else
+        add_assoc_bool_ex (return_value, Z_STRVAL_P (names[i]), Z_STRLEN_P (names[i]) + 1, 0);
+
+      if (zndocs != NULL)
+        add_assoc_long_ex (zndocs, Z_STRVAL_P (names[i]), Z_STRLEN_P (names[i]) + 1, ndocs);
+      if (ndocs > 0)
+        total_docs += ndocs;
+    }
+
+  if (pool != NULL)
+    php_yaml_pool_finish (pool);
+
+  YAML_G (stats).bytes = total_bytes;
+  php_yaml_stats_end (1, total_docs, &saved_stats TSRMLS_CC);
+  php_yaml_limits_end (&saved_limits TSRMLS_CC);
+  php_yaml_callbacks_end (callbacks TSRMLS_CC);
+
+#ifdef IS_UNICODE
+  UG (runtime_encoding_conv) = YAML_G (orig_runtime_encoding_conv);
+#endif
+
+  for (i = 0; i < nfiles; i++)
+    {
+      php_yaml_event_list_free (&files[i].events);
+      if (streams[i] != NULL)
+        php_stream_close (streams[i]);
+      if (inputs[i] != NULL)
+        efree (inputs[i]);
+      zval_ptr_dtor (&names[i]);
+    }
+  efree (files);
+  efree (inputs);
+  efree (streams);
+  efree (names);
+}
+/* }}} yaml_parse_files */
+
 /* {{{ proto string yaml_emit (mixed data[, int encoding[, int linebreak]]) */
 PHP_FUNCTION (yaml_emit)
 {
   zval *data = NULL;
   long encoding = 0;
   long linebreak = 0;
+  php_yaml_stats saved_stats;
 
   yaml_emitter_t emitter = {0};
   smart_str str = {0};
@@ -512,6 +1246,8 @@ PHP_FUNCTION (yaml_emit)
       RETURN_NULL ();
     }
 
+  php_yaml_stats_begin (Y_STATS_EMIT, "yaml_emit", NULL, -1, &saved_stats TSRMLS_CC);
+
   yaml_emitter_initialize (&emitter);
   yaml_emitter_set_output (&emitter, &php_yaml_write_to_buffer, (void *)&str);
   yaml_emitter_set_unicode (&emitter, 1);
@@ -536,7 +1272,9 @@ PHP_FUNCTION (yaml_emit)
   }
  
   yaml_emitter_delete (&emitter);
+  YAML_G (stats).bytes = (long)str.len;
   smart_str_free (&str);
+  php_yaml_stats_end (Z_TYPE_P (return_value) != IS_BOOL, 0, &saved_stats TSRMLS_CC);
 }
 /* }}} yaml_emit */
 
@@ -550,6 +1288,7 @@ PHP_FUNCTION (yaml_emit_file)
   zval *data = NULL;
   long encoding = 0;
   long linebreak = 0;
+  php_yaml_stats saved_stats;
 
   yaml_emitter_t emitter = {0};
 
@@ -577,6 +1316,8 @@ PHP_FUNCTION (yaml_emit_file)
       RETURN_FALSE;
     }
 
+  php_yaml_stats_begin (Y_STATS_EMIT, "yaml_emit_file", filename, -1, &saved_stats TSRMLS_CC);
+
   yaml_emitter_initialize (&emitter);
   yaml_emitter_set_output_file (&emitter, fp);
   yaml_emitter_set_unicode (&emitter, 1);
@@ -592,10 +1333,68 @@ PHP_FUNCTION (yaml_emit_file)
   RETVAL_BOOL ((php_yaml_write_impl (&emitter, data, encoding TSRMLS_CC) == SUCCESS));
 
   yaml_emitter_delete (&emitter);
+  YAML_G (stats).bytes = ftell (fp);
   php_stream_close (stream);
+  php_yaml_stats_end (Z_BVAL_P (return_value), 0, &saved_stats TSRMLS_CC);
 }
 /* }}} yaml_emit_file */
 
+/* {{{ proto mixed yaml_last_stats ()
+   Statistics of the most recent parse or emit call, FALSE if none */
+PHP_FUNCTION (yaml_last_stats)
+{
+  static const char *event_names[] = {
+    "none", "stream_start", "stream_end", "document_start", "document_end",
+    "alias", "scalar", "sequence_start", "sequence_end",
+    "mapping_start", "mapping_end"
+  };
+  static const char *scalar_names[] = {
+    "null", "bool", "int", "float", "timestamp", "binary", "string"
+  };
+  php_yaml_stats *stats = &YAML_G (stats);
+  zval *events, *scalars, *time;
+  int i;
+
+  if (ZEND_NUM_ARGS () != 0)
+    {
+      WRONG_PARAM_COUNT;
+    }
+
+  if (stats->operation == Y_STATS_NONE)
+    {
+      RETURN_FALSE;
+    }
+
+  array_init (return_value);
+  add_assoc_string (return_value, "operation",
+                    stats->operation == Y_STATS_PARSE ? "parse" : "emit", 1);
+
+  MAKE_STD_ZVAL (events);
+  array_init (events);
+  for (i = YAML_STREAM_START_EVENT; i <= YAML_MAPPING_END_EVENT; i++)
+    add_assoc_long (events, (char *)event_names[i], stats->events[i]);
+  add_assoc_zval (return_value, "events", events);
+
+  MAKE_STD_ZVAL (scalars);
+  array_init (scalars);
+  for (i = 0; i < Y_STATS_SCALAR_TYPES; i++)
+    add_assoc_long (scalars, (char *)scalar_names[i], stats->scalars[i]);
+  add_assoc_zval (return_value, "scalars", scalars);
+
+  add_assoc_long (return_value, "bytes", stats->bytes);
+  add_assoc_long (return_value, "allocations", stats->allocations);
+  add_assoc_long (return_value, "memory", stats->memory);
+
+  MAKE_STD_ZVAL (time);
+  array_init (time);
+  add_assoc_double (time, "total", stats->time_total);
+  add_assoc_double (time, "libyaml", stats->time_libyaml);
+  add_assoc_double (time, "eval", stats->time_eval);
+  add_assoc_double (time, "callbacks", stats->time_callbacks);
+  add_assoc_zval (return_value, "time", time);
+}
+/* }}} yaml_last_stats */
+
 /*
  * Local variables:
  * tab-width: 2